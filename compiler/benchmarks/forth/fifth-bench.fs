@@ -0,0 +1,127 @@
+\ fifth-bench.fs - Engine benchmark harness
+\ Times the ports in this directory and two lib/ workloads with the
+\ engine's BENCH word, and prints JSON in the shape of ../results.json.
+\
+\ Usage: cd engine && make bench    (writes bench.json, compares it
+\        against compiler/benchmarks/fifth-baseline.json)
+
+require ~/fifth/lib/html.fs
+
+\ ============================================================
+\ Words the ports expect from gforth
+\ ============================================================
+
+\ ALLOCATE bumps through an arena; FREE is a no-op and the heap goes
+\ back to heap-mark between benchmarks.
+64 1024 * 1024 * arena-new constant bench-heap
+: allocate ( u -- addr ior ) bench-heap arena-alloc 0 ;
+: free ( addr -- ior ) drop 0 ;
+: 2- ( n -- n' ) 2 - ;
+: 2* ( n -- n' ) 1 lshift ;
+: 3dup ( a b c -- a b c a b c ) 2 pick 2 pick 2 pick ;
+: cmove ( a1 a2 u -- ) move ;
+
+include sieve.fth
+include fibonacci.fth
+include bubble_sort.fth
+include matrix.fth
+include coremark.fth
+
+\ ============================================================
+\ Kernels
+\ ============================================================
+
+: b-sieve ( -- ) 8190 sieve drop ;
+: b-fib ( -- ) 25 fib-rec drop ;
+
+1000 constant sort-len
+sort-len cells allocate throw constant sort-seed
+sort-len cells allocate throw constant sort-work
+sort-seed sort-len 42 init-array
+: b-sort ( -- )
+    sort-seed sort-work sort-len cells move
+    sort-work sort-len bubble-sort ;
+
+create-matrix constant mat-a
+create-matrix constant mat-b
+create-matrix constant mat-c
+mat-a 42 init-matrix-random
+mat-b 43 init-matrix-random
+: b-matrix ( -- ) mat-a mat-b mat-c matrix-mult-simple ;
+
+: b-coremark ( -- ) 100000 coremark-iteration drop ;
+
+\ HTML render: a 200-row table with escaped cells, captured in memory
+: render-row ( -- )
+    <tr>
+    s" 42" td.
+    s" Alice <alice@example.com>" td.
+    s" Fish & Chips, 5 > 3" td.
+    s" 2025-11-14 02:40:48" td.
+    </tr> ;
+: b-html ( -- )
+    html>stdout capture-begin
+    <!doctype> <html> <head> <title> s" Report & summary" text </title> </head>
+    <body> s" data" <table.>
+    200 0 do render-row loop
+    </table> </body> </html>
+    capture-end 2drop ;
+
+\ SQL row parse: 1000 rows as sql-row prints them, split on |
+create sql-rows 1000 64 * allot
+variable sql-len
+: add-row ( addr u -- )
+    tuck sql-rows sql-len @ + swap move sql-len +!
+    10 sql-rows sql-len @ + c!  1 sql-len +! ;
+: fill-rows ( -- )
+    1000 0 do s" 42|alice|alice@example.com|2025-11-14 02:40:48|active" add-row loop ;
+fill-rows
+
+bench-heap arena-mark constant heap-mark
+
+: next-line ( a u -- a len a' u' )
+    2dup 10 scan-char 2swap drop 2 pick over - 2swap
+    dup if 1 /string then ;
+: row-sum ( a len -- n )
+    s" |" split-row 0 swap 0 ?do i field@ nip + loop ;
+: b-sql ( -- )
+    0 sql-rows sql-len @
+    begin dup while next-line 2>r row-sum + 2r> repeat
+    2drop drop ;
+
+\ ============================================================
+\ Report
+\ ============================================================
+
+: q ( -- ) [char] " emit ;
+: key: ( addr u -- ) q type q ." : " ;
+variable first-bench
+: run ( xt n addr u -- )
+    first-bench @ if 0 first-bench ! else [char] , emit cr then
+    6 spaces key: bench
+    heap-mark bench-heap arena-reset ;
+
+: bench-all ( -- )
+    ." {" cr
+    2 spaces s" timestamp" key: q s" date '+%Y-%m-%d %H:%M:%S' | tr -d '\n'" system q ." ," cr
+    2 spaces s" platform" key: ." {" cr
+    4 spaces s" os" key: q s" uname -s | tr -d '\n'" system q ." ," cr
+    4 spaces s" machine" key: q s" uname -m | tr -d '\n'" system q ." ," cr
+    4 spaces s" engine" key: q ." fifth" q cr
+    2 spaces ." }," cr
+    2 spaces s" benchmarks" key: ." {" cr
+    4 spaces s" fifth" key: ." {" cr
+    true first-bench !
+    ['] b-sieve    100 s" sieve"         run
+    ['] b-fib       50 s" fibonacci_rec" run
+    ['] b-matrix    20 s" matrix"        run
+    ['] b-sort      20 s" bubble_sort"   run
+    ['] b-coremark  50 s" coremark"      run
+    ['] b-html     200 s" html_render"   run
+    ['] b-sql      200 s" sql_row_parse" run
+    cr 4 spaces ." }" cr
+    2 spaces ." }" cr
+    ." }" cr ;
+
+bench-all
+bye
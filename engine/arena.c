@@ -0,0 +1,203 @@
+/* arena.c - Arenas for transient data
+ *
+ * Interpret-mode S" and GETENV used to leave their strings at HERE, where
+ * the next string, or the next , or ALLOT, overwrote them. An arena is
+ * a scratch view above mem[] (region.c) with a bump pointer. Allocating
+ * is an add and a compare, and ARENA-RESET drops everything after a mark
+ * in O(1). Untouched pages are never committed.
+ *
+ * Every VM has two arenas of its own, made on first use, outside the
+ * dictionary so they never get in the way of HERE. String space holds
+ * what lasts as long as the program: interpret-mode S" text, which is
+ * part of the program like a compiled string, and the GETENV and ARGV
+ * values, copied once each. Images save it at the same address. The
+ * scratch arena holds per-request results such as RUN-CAPTURE output,
+ * and SCRATCH-RESET empties it: a request loop calls it once per
+ * request. Tasks get a copy of their parent's arenas, used part only,
+ * at the same addresses.
+ *
+ *   arena-new     ( u -- arena )
+ *   arena-alloc   ( u arena -- addr )        cell-aligned
+ *   arena-mark    ( arena -- mark )
+ *   arena-reset   ( mark arena -- )          0 empties the arena
+ *   arena-free    ( arena -- )
+ *   scratch       ( -- arena )
+ *   scratch-reset ( -- )
+ *
+ * The header sits in the first cells of the arena itself, so the
+ * handle is just its address.
+ */
+
+#include "fifth.h"
+
+#define ARENA_MAGIC  ((cell_t)0x41726e61)     /* "Arna" */
+
+typedef struct {
+    cell_t  magic;
+    cell_t  top;                     /* Next free offset from the arena */
+    cell_t  size;                    /* Usable bytes, header included */
+} arena_t;
+
+#define ARENA_HEADER  ((cell_t)sizeof(arena_t))
+
+static arena_t *arena_at(vm_t *vm, cell_t a) {
+    if (a < (cell_t)vm_mem_size || (size_t)a > vm_mem_size + VIEW_SPACE - sizeof(arena_t))
+        return NULL;
+    for (int i = 0; i < vm->view_count; i++) {
+        if (vm->views[i].addr == a) {
+            arena_t *h = (arena_t *)(vm->mem + a);
+            return vm->views[i].fd < 0 && h->magic == ARENA_MAGIC ? h : NULL;
+        }
+    }
+    return NULL;
+}
+
+static arena_t *arena_get(vm_t *vm, cell_t a, const char *word) {
+    arena_t *h = arena_at(vm, a);
+    if (!h) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s: not an arena", word);
+        vm_abort(vm, msg);
+    }
+    return h;
+}
+
+static cell_t arena_make(vm_t *vm, size_t size) {
+    if (size > VIEW_SPACE) return -1;
+    size += sizeof(arena_t);
+    cell_t a = vm_map_view(vm, -1, size);
+    if (a < 0) return -1;
+    *(arena_t *)(vm->mem + a) = (arena_t){ ARENA_MAGIC, ARENA_HEADER, (cell_t)size };
+    return a;
+}
+
+/* Bump-allocate n bytes; -1 when the arena is full */
+static cell_t arena_take(vm_t *vm, cell_t a, size_t n) {
+    arena_t *h = (arena_t *)(vm->mem + a);
+    cell_t at = h->top;
+    if (n > (size_t)(h->size - at)) return -1;
+    h->top = vm_align(at + (cell_t)n);
+    if (h->top > h->size) h->top = h->size;
+    return a + at;
+}
+
+size_t vm_arena_used(vm_t *vm, cell_t addr) {
+    arena_t *h = (arena_t *)(vm->mem + addr);
+    return h->magic == ARENA_MAGIC && h->top <= h->size ? (size_t)h->top : 0;
+}
+
+cell_t vm_scratch_alloc(vm_t *vm, size_t n) {
+    if (!vm->scratch && (vm->scratch = arena_make(vm, SCRATCH_SIZE)) < 0) {
+        vm->scratch = 0;
+        vm_abort(vm, "Scratch arena: no address space");
+        return -1;
+    }
+    cell_t at = arena_take(vm, vm->scratch, n);
+    if (at < 0) vm_abort(vm, "Scratch arena full (SCRATCH-RESET)");
+    return at;
+}
+
+cell_t vm_string_alloc(vm_t *vm, size_t n) {
+    if (!vm->strings && (vm->strings = arena_make(vm, STRINGS_SIZE)) < 0) {
+        vm->strings = 0;
+        vm_abort(vm, "String space: no address space");
+        return -1;
+    }
+    cell_t at = arena_take(vm, vm->strings, n);
+    if (at < 0) vm_abort(vm, "String space full");
+    return at;
+}
+
+int vm_strings_place(vm_t *vm, cell_t at) {
+    if (vm->strings || vm_map_view_at(vm, at, STRINGS_SIZE + sizeof(arena_t)) < 0) return -1;
+    vm->strings = at;
+    return 0;
+}
+
+cell_t vm_arena_alloc(vm_t *vm, cell_t a, size_t n) {
+    return arena_at(vm, a) ? arena_take(vm, a, n) : -1;
+}
+
+void vm_scratch_trim(vm_t *vm, cell_t at, size_t n) {
+    arena_t *h = (arena_t *)(vm->mem + vm->scratch);
+    if (vm->scratch && at > vm->scratch && vm_align(at - vm->scratch + (cell_t)n) == h->top)
+        h->top = at - vm->scratch;
+}
+
+/* ============================================================
+ * Primitives
+ * ============================================================ */
+
+/* ARENA-NEW ( u -- arena ) Reserve u bytes outside the data space */
+static void p_arena_new(vm_t *vm) {
+    cell_t u = pop(vm);
+    cell_t a = u >= 0 ? arena_make(vm, (size_t)u) : -1;
+    if (a < 0) {
+        vm_abort(vm, "ARENA-NEW: no address space (16 views per VM)");
+        return;
+    }
+    push(vm, a);
+}
+
+/* ARENA-ALLOC ( u arena -- addr ) */
+static void p_arena_alloc(vm_t *vm) {
+    cell_t a = pop(vm);
+    cell_t u = pop(vm);
+    if (!arena_get(vm, a, "ARENA-ALLOC")) return;
+    cell_t at = u >= 0 ? arena_take(vm, a, (size_t)u) : -1;
+    if (at < 0) {
+        vm_abort(vm, "ARENA-ALLOC: arena full");
+        return;
+    }
+    push(vm, at);
+}
+
+/* ARENA-MARK ( arena -- mark ) */
+static void p_arena_mark(vm_t *vm) {
+    cell_t a = pop(vm);
+    arena_t *h = arena_get(vm, a, "ARENA-MARK");
+    if (h) push(vm, a + h->top);
+}
+
+/* ARENA-RESET ( mark arena -- ) Free everything allocated after mark */
+static void p_arena_reset(vm_t *vm) {
+    cell_t a = pop(vm);
+    cell_t mark = pop(vm);
+    arena_t *h = arena_get(vm, a, "ARENA-RESET");
+    if (!h) return;
+    if (mark == 0) mark = a + ARENA_HEADER;
+    if (mark < a + ARENA_HEADER || mark > a + h->top) {
+        vm_abort(vm, "ARENA-RESET: mark not in use");
+        return;
+    }
+    h->top = mark - a;
+}
+
+/* ARENA-FREE ( arena -- ) */
+static void p_arena_free(vm_t *vm) {
+    cell_t a = pop(vm);
+    if (!arena_get(vm, a, "ARENA-FREE")) return;
+    if (a == vm->scratch) vm->scratch = 0;
+    vm_unmap_view(vm, a);
+}
+
+/* SCRATCH ( -- arena ) The VM's scratch arena */
+static void p_scratch(vm_t *vm) {
+    if (vm_scratch_alloc(vm, 0) >= 0) push(vm, vm->scratch);
+}
+
+/* SCRATCH-RESET ( -- ) Drop every per-request string */
+static void p_scratch_reset(vm_t *vm) {
+    if (vm->scratch) ((arena_t *)(vm->mem + vm->scratch))->top = ARENA_HEADER;
+    vm->run_out = vm->run_len = 0;
+}
+
+void arena_init(vm_t *vm) {
+    vm_add_prim(vm, "arena-new",     p_arena_new,     false);
+    vm_add_prim(vm, "arena-alloc",   p_arena_alloc,   false);
+    vm_add_prim(vm, "arena-mark",    p_arena_mark,    false);
+    vm_add_prim(vm, "arena-reset",   p_arena_reset,   false);
+    vm_add_prim(vm, "arena-free",    p_arena_free,    false);
+    vm_add_prim(vm, "scratch",       p_scratch,       false);
+    vm_add_prim(vm, "scratch-reset", p_scratch_reset, false);
+}
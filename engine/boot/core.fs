@@ -31,15 +31,7 @@
 
 \ str= ( addr1 u1 addr2 u2 -- flag )
 \ Compare two strings for equality
-: str=  ( a1 u1 a2 u2 -- flag )
-  rot over <> if 2drop 2drop false exit then
-  ( a1 a2 u2 )
-  0 ?do
-    over i + c@
-    over i + c@
-    <> if 2drop false unloop exit then
-  loop
-  2drop true ;
+: str=  ( a1 u1 a2 u2 -- flag )  compare 0= ;
 
 \ ============================================================
 \ Numeric Utilities
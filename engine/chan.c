@@ -0,0 +1,322 @@
+/* chan.c - Channels between tasks
+ *
+ * A channel is a bounded multi-producer multi-consumer ring of cells
+ * shared by every VM in the process, so tasks (spawn.c) can stream
+ * values to each other instead of returning a single TOS. The ring is
+ * lock-free (per-slot sequence numbers, after Vyukov): a send or
+ * receive that finds room or data never takes a lock.
+ *
+ * Only a blocked operation waits, on the channel's condition variable.
+ * Before sleeping it tells the pool (task_blocking), which starts
+ * another worker if queued tasks - possibly the peer being waited
+ * for - would otherwise have none. Sleeps are bounded, so a wakeup
+ * lost to the lock-free fast path costs at most a millisecond.
+ *
+ *   chan       ( capacity -- ch )
+ *   send       ( x ch -- )
+ *   recv       ( ch -- x true | 0 false )      false once closed and drained
+ *   try-recv   ( ch -- x true | 0 false )      false if nothing is waiting
+ *   send-cells ( addr n ch -- )
+ *   recv-cells ( addr n ch -- n2 )             n2 = 0 once closed and drained
+ *   close-chan ( ch -- )
+ *   free-chan  ( ch -- )
+ */
+
+#include "fifth.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define MAX_CHANNELS  1024
+#define MAX_CAPACITY  ((cell_t)1 << 24)  /* Slots per channel, 256 MB */
+#define WAIT_NS       1000000        /* Longest sleep between re-checks */
+
+typedef struct {
+    atomic_size_t seq;
+    cell_t        value;
+} chan_slot_t;
+
+typedef struct {
+    chan_slot_t    *slots;
+    size_t          mask;            /* Capacity - 1 (power of two) */
+    atomic_size_t   head;            /* Next slot to receive */
+    atomic_size_t   tail;            /* Next slot to send */
+    atomic_bool     closed;
+    atomic_int      waiters;         /* Threads asleep on cv */
+    pthread_mutex_t lock;
+    pthread_cond_t  cv;
+} chan_t;
+
+static _Atomic(chan_t *) channels[MAX_CHANNELS];
+static pthread_mutex_t channels_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* ============================================================
+ * Ring
+ * ============================================================ */
+
+static bool ring_put(chan_t *c, cell_t v) {
+    size_t pos = atomic_load_explicit(&c->tail, memory_order_relaxed);
+    for (;;) {
+        chan_slot_t *s = &c->slots[pos & c->mask];
+        size_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&c->tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                s->value = v;
+                atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;            /* Full */
+        } else {
+            pos = atomic_load_explicit(&c->tail, memory_order_relaxed);
+        }
+    }
+}
+
+static bool ring_get(chan_t *c, cell_t *v) {
+    size_t pos = atomic_load_explicit(&c->head, memory_order_relaxed);
+    for (;;) {
+        chan_slot_t *s = &c->slots[pos & c->mask];
+        size_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&c->head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                *v = s->value;
+                atomic_store_explicit(&s->seq, pos + c->mask + 1, memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;            /* Empty */
+        } else {
+            pos = atomic_load_explicit(&c->head, memory_order_relaxed);
+        }
+    }
+}
+
+/* ============================================================
+ * Blocking
+ * ============================================================ */
+
+/* Wake sleepers after progress; free when nobody sleeps */
+static void chan_notify(chan_t *c) {
+    if (atomic_load(&c->waiters) == 0) return;
+    pthread_mutex_lock(&c->lock);
+    pthread_cond_broadcast(&c->cv);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static bool chan_has_data(chan_t *c) {
+    size_t pos = atomic_load(&c->head);
+    return atomic_load(&c->slots[pos & c->mask].seq) == pos + 1;
+}
+
+static bool chan_has_room(chan_t *c) {
+    size_t pos = atomic_load(&c->tail);
+    return atomic_load(&c->slots[pos & c->mask].seq) == pos;
+}
+
+/* Called when a ring operation failed: sleep until ready() may have
+ * changed. The waiter count is raised before the re-check so a peer's
+ * chan_notify cannot slip between the two. */
+static void chan_wait(chan_t *c, bool (*ready)(chan_t *)) {
+    task_blocking();
+    pthread_mutex_lock(&c->lock);
+    atomic_fetch_add(&c->waiters, 1);
+    if (!ready(c) && !atomic_load(&c->closed)) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += WAIT_NS;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&c->cv, &c->lock, &ts);
+    }
+    atomic_fetch_sub(&c->waiters, 1);
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* Blocking receive; false once closed and drained */
+static bool chan_recv(chan_t *c, cell_t *v) {
+    for (;;) {
+        if (ring_get(c, v)) return true;
+        /* A send may land between the failed get and the closed check */
+        if (atomic_load(&c->closed)) return ring_get(c, v);
+        chan_wait(c, chan_has_data);
+    }
+}
+
+/* Blocking send; false if the channel is (or becomes) closed */
+static bool chan_send(chan_t *c, cell_t v) {
+    for (;;) {
+        if (atomic_load(&c->closed)) return false;
+        if (ring_put(c, v)) return true;
+        chan_wait(c, chan_has_room);
+    }
+}
+
+/* ============================================================
+ * Handles
+ * ============================================================ */
+
+static chan_t *chan_get(vm_t *vm, cell_t ch, const char *word) {
+    chan_t *c = (ch >= 0 && ch < MAX_CHANNELS) ? atomic_load(&channels[ch]) : NULL;
+    if (!c) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s: invalid channel", word);
+        vm_abort(vm, msg);
+    }
+    return c;
+}
+
+/* ============================================================
+ * Primitives
+ * ============================================================ */
+
+/* CHAN ( capacity -- ch ) Capacity is rounded up to a power of two */
+static void p_chan(vm_t *vm) {
+    cell_t want = pop(vm);
+    if (want > MAX_CAPACITY) {
+        vm_abort(vm, "CHAN: capacity too large");
+        return;
+    }
+    size_t cap = 2;
+    while ((cell_t)cap < want) cap <<= 1;
+
+    chan_t *c = calloc(1, sizeof(chan_t));
+    chan_slot_t *slots = c ? malloc(cap * sizeof(chan_slot_t)) : NULL;
+    if (!slots) {
+        free(c);
+        vm_abort(vm, "CHAN: out of memory");
+        return;
+    }
+    for (size_t i = 0; i < cap; i++) atomic_init(&slots[i].seq, i);
+    c->slots = slots;
+    c->mask = cap - 1;
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cv, NULL);
+
+    int ch = -1;
+    pthread_mutex_lock(&channels_mutex);
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        if (!atomic_load(&channels[i])) {
+            atomic_store(&channels[i], c);
+            ch = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&channels_mutex);
+    if (ch < 0) {
+        free(slots);
+        free(c);
+        vm_abort(vm, "CHAN: too many channels");
+        return;
+    }
+    push(vm, ch);
+}
+
+/* SEND ( x ch -- ) Block while full; abort if closed */
+static void p_send(vm_t *vm) {
+    chan_t *c = chan_get(vm, pop(vm), "SEND");
+    cell_t x = pop(vm);
+    if (!c) return;
+    if (!chan_send(c, x)) vm_abort(vm, "SEND: channel closed");
+    else chan_notify(c);
+}
+
+/* RECV ( ch -- x true | 0 false ) Block while empty */
+static void p_recv(vm_t *vm) {
+    chan_t *c = chan_get(vm, pop(vm), "RECV");
+    if (!c) return;
+    cell_t x = 0;
+    bool ok = chan_recv(c, &x);
+    if (ok) chan_notify(c);
+    push(vm, ok ? x : 0);
+    push(vm, ok ? -1 : 0);
+}
+
+/* TRY-RECV ( ch -- x true | 0 false ) Never blocks */
+static void p_try_recv(vm_t *vm) {
+    chan_t *c = chan_get(vm, pop(vm), "TRY-RECV");
+    if (!c) return;
+    cell_t x = 0;
+    bool ok = ring_get(c, &x);
+    if (ok) chan_notify(c);
+    push(vm, ok ? x : 0);
+    push(vm, ok ? -1 : 0);
+}
+
+/* SEND-CELLS ( addr n ch -- ) Send n cells, one wakeup for the batch */
+static void p_send_cells(vm_t *vm) {
+    chan_t *c = chan_get(vm, pop(vm), "SEND-CELLS");
+    cell_t n = pop(vm);
+    cell_t addr = pop(vm);
+    cell_t *src = c ? vm_cells(vm, addr, n, "SEND-CELLS") : NULL;
+    if (!src) return;
+    for (cell_t i = 0; i < n; i++) {
+        if (ring_put(c, src[i])) continue;
+        chan_notify(c);              /* Let receivers drain before we wait */
+        if (!chan_send(c, src[i])) {
+            vm_abort(vm, "SEND-CELLS: channel closed");
+            return;
+        }
+    }
+    chan_notify(c);
+}
+
+/* RECV-CELLS ( addr n ch -- n2 )
+ * Wait for at least one cell, then take up to n without waiting again.
+ */
+static void p_recv_cells(vm_t *vm) {
+    chan_t *c = chan_get(vm, pop(vm), "RECV-CELLS");
+    cell_t n = pop(vm);
+    cell_t addr = pop(vm);
+    cell_t *dst = c ? vm_cells(vm, addr, n, "RECV-CELLS") : NULL;
+    if (!dst) return;
+    cell_t got = 0;
+    if (n > 0 && chan_recv(c, &dst[0])) {
+        got = 1;
+        while (got < n && ring_get(c, &dst[got])) got++;
+        chan_notify(c);
+    }
+    push(vm, got);
+}
+
+/* CLOSE-CHAN ( ch -- ) Further sends abort; receivers drain what is left */
+static void p_close_chan(vm_t *vm) {
+    chan_t *c = chan_get(vm, pop(vm), "CLOSE-CHAN");
+    if (!c) return;
+    atomic_store(&c->closed, true);
+    pthread_mutex_lock(&c->lock);
+    pthread_cond_broadcast(&c->cv);
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* FREE-CHAN ( ch -- ) Release a channel no task is still using */
+static void p_free_chan(vm_t *vm) {
+    cell_t ch = pop(vm);
+    chan_t *c = chan_get(vm, ch, "FREE-CHAN");
+    if (!c) return;
+    pthread_mutex_lock(&channels_mutex);
+    atomic_store(&channels[ch], NULL);
+    pthread_mutex_unlock(&channels_mutex);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->cv);
+    free(c->slots);
+    free(c);
+}
+
+/* Initialize channel primitives */
+void chan_init(vm_t *vm) {
+    vm_add_prim(vm, "chan", p_chan, false);
+    vm_add_prim(vm, "send", p_send, false);
+    vm_add_prim(vm, "recv", p_recv, false);
+    vm_add_prim(vm, "try-recv", p_try_recv, false);
+    vm_add_prim(vm, "send-cells", p_send_cells, false);
+    vm_add_prim(vm, "recv-cells", p_recv_cells, false);
+    vm_add_prim(vm, "close-chan", p_close_chan, false);
+    vm_add_prim(vm, "free-chan", p_free_chan, false);
+}
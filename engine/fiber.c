@@ -0,0 +1,564 @@
+/* fiber.c - Green threads and an event loop inside one VM
+ *
+ * A fiber runs a word on the VM that started it, sharing its
+ * dictionary and data space; nothing is cloned. Each fiber has its own
+ * data and return stacks and its own C stack, so it can give way from
+ * anywhere, however deep in vm_execute or native code. A switch saves
+ * the used part of both Forth stacks, IP and the input state of the
+ * running context into its fiber_t, loads the next one's back into the
+ * VM, and swaps C contexts. The VM's own execution is a context like
+ * the others (sched.main); it just has no stack of its own to free.
+ *
+ * Nothing is preemptive. A context runs until it yields, sleeps, or
+ * waits on a socket that is not ready. Then the next ready fiber runs.
+ * When none is ready, one epoll (Linux) or kqueue wait covers every
+ * socket and timer that fibers wait on. A program without fibers pays
+ * nothing: its waits block in poll(2).
+ *
+ *   fiber       ( x xt -- )        Start xt ( x -- ) as a fiber
+ *   yield       ( -- )             Let the other ready fibers run
+ *   ms          ( n -- )           Sleep n milliseconds
+ *   event-loop  ( -- )             Run until every fiber has finished
+ *   tcp-listen  ( port -- fd )     0 = any free port; -1 on failure
+ *   tcp-connect ( addr u port -- fd )
+ *   sock-accept ( fd -- fd' )
+ *   sock-port   ( fd -- port )     Local port, for tcp-listen 0
+ *   sock-read   ( addr u fd -- n ) 0 at end of stream, -1 on error
+ *   sock-write  ( addr u fd -- n ) All of it, or -1
+ *   sock-close  ( fd -- )
+ */
+
+#ifdef __APPLE__
+#define _XOPEN_SOURCE 600            /* ucontext */
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#endif
+#include "fifth.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#endif
+
+#define FIBER_STACK  ((size_t)256 << 10) /* C stack per fiber, committed as touched */
+#define MAX_EVENTS   64              /* Readiness events taken per wait */
+
+typedef struct fiber {
+    ucontext_t    ctx;
+    void         *stack;             /* FIBER_STACK plus a guard page; NULL = sched.main */
+    struct fiber *next;              /* Ready queue or timer list */
+    struct fiber *prev_all, *next_all;  /* Every fiber, for release */
+    int64_t       wake;              /* Timer deadline (CLOCK_MONOTONIC ns) */
+    int           xt;
+    cell_t        arg;
+
+    /* The VM state this context had when it switched out */
+    cell_t        ds[DSTACK_SIZE];
+    cell_t        rs[RSTACK_SIZE];
+    int           dn, rn;            /* Cells used */
+    cell_t        ip, w;
+    const char   *tib;
+    int           tib_len, tib_pos;
+    bool          tib_file;
+    int           input_depth;
+    unsigned      aborts;            /* Native code compares it across calls */
+    vm_catch_t   *catch_top;         /* Catches on this context's C stack */
+} fiber_t;
+
+typedef struct {
+    vm_t         *vm;
+    fiber_t       main;              /* The VM's own context */
+    fiber_t      *current;
+    fiber_t      *ready, *ready_tail;
+    fiber_t      *timers;            /* Sorted by wake */
+    fiber_t      *all;
+    fiber_t      *dead;              /* Finished; its stack goes at the next switch */
+    fiber_t      *loop_waiter;       /* In EVENT-LOOP */
+    int           live;              /* Fibers started and not finished */
+    int           io_waiting;        /* Contexts parked on a socket */
+    int           poll_fd;           /* epoll or kqueue, -1 until needed */
+} sched_t;
+
+/* The scheduler a new fiber starts under (makecontext passes no pointer) */
+static _Thread_local sched_t *entering;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static sched_t *sched_get(vm_t *vm) {
+    sched_t *s = vm->fibers;
+    if (s) return s;
+    s = calloc(1, sizeof(sched_t));
+    if (!s) return NULL;
+    s->vm = vm;
+    s->current = &s->main;
+    s->poll_fd = -1;
+    vm->fibers = s;
+    return s;
+}
+
+static void make_ready(sched_t *s, fiber_t *f) {
+    f->next = NULL;
+    if (s->ready_tail) s->ready_tail->next = f;
+    else s->ready = f;
+    s->ready_tail = f;
+}
+
+/* ============================================================
+ * Switching
+ * ============================================================ */
+
+static void save(vm_t *vm, fiber_t *f) {
+    f->dn = depth(vm);
+    f->rn = rdepth(vm);
+    memcpy(f->ds, vm->sp, (size_t)f->dn * sizeof(cell_t));
+    memcpy(f->rs, vm->rsp, (size_t)f->rn * sizeof(cell_t));
+    f->ip = vm->ip;
+    f->w = vm->w;
+    f->tib = vm->tib;
+    f->tib_len = vm->tib_len;
+    f->tib_pos = vm->tib_pos;
+    f->tib_file = vm->tib_file;
+    f->input_depth = vm->input_depth;
+    f->aborts = vm->aborts;
+    f->catch_top = vm_catch_top;
+}
+
+/* Back to the same addresses, so pointers the context's C frames hold
+ * into dstack[] and rstack[] stay valid */
+static void restore(vm_t *vm, fiber_t *f) {
+    vm->sp = vm->dstack + DSTACK_SIZE - f->dn;
+    vm->rsp = vm->rstack + RSTACK_SIZE - f->rn;
+    memcpy(vm->sp, f->ds, (size_t)f->dn * sizeof(cell_t));
+    memcpy(vm->rsp, f->rs, (size_t)f->rn * sizeof(cell_t));
+    vm->ip = f->ip;
+    vm->w = f->w;
+    vm->tib = f->tib;
+    vm->tib_len = f->tib_len;
+    vm->tib_pos = f->tib_pos;
+    vm->tib_file = f->tib_file;
+    vm->input_depth = f->input_depth;
+    vm->aborts = f->aborts;
+    vm_catch_top = f->catch_top;
+}
+
+static void fiber_free(sched_t *s, fiber_t *f) {
+    if (f->prev_all) f->prev_all->next_all = f->next_all;
+    else s->all = f->next_all;
+    if (f->next_all) f->next_all->prev_all = f->prev_all;
+    munmap(f->stack, FIBER_STACK);
+    free(f);
+}
+
+static void reap(sched_t *s) {
+    if (s->dead && s->dead != s->current) {
+        fiber_free(s, s->dead);
+        s->dead = NULL;
+    }
+}
+
+static void switch_to(sched_t *s, fiber_t *to) {
+    fiber_t *from = s->current;
+    if (from == to) return;
+    save(s->vm, from);
+    restore(s->vm, to);
+    s->current = to;
+    entering = s;
+    swapcontext(&from->ctx, &to->ctx);
+    reap(s);
+}
+
+/* ============================================================
+ * Waiting
+ * ============================================================ */
+
+static bool poll_open(sched_t *s) {
+    if (s->poll_fd >= 0) return true;
+#ifdef __linux__
+    s->poll_fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+    s->poll_fd = kqueue();
+    if (s->poll_fd >= 0) fcntl(s->poll_fd, F_SETFD, FD_CLOEXEC);
+#endif
+    return s->poll_fd >= 0;
+}
+
+/* Wake f once when fd is readable (or writable) */
+static bool poll_add(sched_t *s, int fd, bool write, fiber_t *f) {
+    if (!poll_open(s)) return false;
+#ifdef __linux__
+    struct epoll_event ev = { .events = (write ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT, .data.ptr = f };
+    return epoll_ctl(s->poll_fd, EPOLL_CTL_MOD, fd, &ev) == 0 ||
+           epoll_ctl(s->poll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+#else
+    struct kevent ev;
+    EV_SET(&ev, fd, write ? EVFILT_WRITE : EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, f);
+    return kevent(s->poll_fd, &ev, 1, NULL, 0, NULL) == 0;
+#endif
+}
+
+/* Block the thread until a socket or timer wakes somebody; false if
+ * nobody is waiting on either */
+static bool wait_events(sched_t *s) {
+    if (!s->timers && !s->io_waiting) return false;
+    int timeout = -1;
+    if (s->timers) {
+        int64_t d = s->timers->wake - now_ns();
+        timeout = d <= 0 ? 0 : (int)((d + 999999) / 1000000);
+    }
+    if (s->io_waiting) {
+        task_blocking();
+#ifdef __linux__
+        struct epoll_event evs[MAX_EVENTS];
+        int n = epoll_wait(s->poll_fd, evs, MAX_EVENTS, timeout);
+        for (int i = 0; i < n; i++) {
+            s->io_waiting--;
+            make_ready(s, evs[i].data.ptr);
+        }
+#else
+        struct kevent evs[MAX_EVENTS];
+        struct timespec ts = { timeout / 1000, (long)(timeout % 1000) * 1000000 };
+        int n = kevent(s->poll_fd, NULL, 0, evs, MAX_EVENTS, timeout < 0 ? NULL : &ts);
+        for (int i = 0; i < n; i++) {
+            s->io_waiting--;
+            make_ready(s, evs[i].udata);
+        }
+#endif
+    } else if (timeout > 0) {
+        task_blocking();
+        poll(NULL, 0, timeout);
+    }
+    int64_t now = now_ns();
+    while (s->timers && s->timers->wake <= now) {
+        fiber_t *f = s->timers;
+        s->timers = f->next;
+        make_ready(s, f);
+    }
+    return true;
+}
+
+/* Run other contexts until this one is made ready again. Returns at
+ * once if nothing is ready and nothing is being waited for. */
+static void block(sched_t *s) {
+    for (;;) {
+        fiber_t *next = s->ready;
+        if (next) {
+            s->ready = next->next;
+            if (!s->ready) s->ready_tail = NULL;
+            switch_to(s, next);
+            return;
+        }
+        if (!wait_events(s)) return;
+    }
+}
+
+void vm_fiber_wait_fd(vm_t *vm, int fd, bool write) {
+    sched_t *s = vm->fibers;
+    if (!s || !poll_add(s, fd, write, s->current)) {
+        /* No poller: wait here, blocking the thread */
+        struct pollfd p = { fd, write ? POLLOUT : POLLIN, 0 };
+        task_blocking();
+        poll(&p, 1, -1);
+        return;
+    }
+    s->io_waiting++;
+    block(s);
+}
+
+/* ============================================================
+ * Fibers
+ * ============================================================ */
+
+static void fiber_entry(void) {
+    sched_t *s = entering;
+    reap(s);
+    fiber_t *f = s->current;
+    vm_t *vm = s->vm;
+    push(vm, f->arg);
+    vm_execute_caught(vm, f->xt);
+
+    s->live--;
+    if (s->loop_waiter && (s->live == 0 || !vm->running)) {
+        make_ready(s, s->loop_waiter);
+        s->loop_waiter = NULL;
+    }
+    s->dead = f;
+    block(s);
+    switch_to(s, &s->main);          /* Nothing else can run; nobody comes back here */
+}
+
+/* Apart from p_fiber: getcontext returns twice, which clobbers locals */
+static __attribute__((noinline)) void fiber_context(fiber_t *f, void *stack) {
+    getcontext(&f->ctx);
+    f->ctx.uc_stack.ss_sp = stack;
+    f->ctx.uc_stack.ss_size = FIBER_STACK;
+    f->ctx.uc_link = NULL;
+    makecontext(&f->ctx, fiber_entry, 0);
+    f->stack = stack;
+}
+
+/* FIBER ( x xt -- ) Start xt ( x -- ) as a fiber. It runs when the
+ * current context next yields or waits. */
+static void p_fiber(vm_t *vm) {
+    int xt = (int)pop(vm);
+    cell_t x = pop(vm);
+    if (xt < 0 || xt >= vm->dict_count) {
+        vm_abort(vm, "FIBER: invalid xt");
+        return;
+    }
+    sched_t *s = sched_get(vm);
+    fiber_t *f = s ? calloc(1, sizeof(fiber_t)) : NULL;
+    void *stack = f ? mmap(NULL, FIBER_STACK, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)
+                    : MAP_FAILED;
+    if (stack == MAP_FAILED) {
+        free(f);
+        vm_abort(vm, "FIBER: out of memory");
+        return;
+    }
+    mprotect(stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);  /* Overflow faults */
+    fiber_context(f, stack);
+    f->xt = xt;
+    f->arg = x;
+    f->tib = "";
+    f->aborts = vm->aborts;
+    f->next_all = s->all;
+    if (s->all) s->all->prev_all = f;
+    s->all = f;
+    s->live++;
+    make_ready(s, f);
+}
+
+/* YIELD ( -- ) */
+static void p_yield(vm_t *vm) {
+    sched_t *s = vm->fibers;
+    if (!s || !s->ready) return;
+    make_ready(s, s->current);
+    block(s);
+}
+
+/* MS ( n -- ) */
+static void p_ms(vm_t *vm) {
+    cell_t n = pop(vm);
+    if (n <= 0) return;
+    sched_t *s = vm->fibers;
+    if (!s) {
+        struct timespec ts = { (time_t)(n / 1000), (long)(n % 1000) * 1000000 };
+        task_blocking();
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+        return;
+    }
+    fiber_t *f = s->current;
+    f->wake = now_ns() + (int64_t)n * 1000000;
+    fiber_t **at = &s->timers;
+    while (*at && (*at)->wake <= f->wake) at = &(*at)->next;
+    f->next = *at;
+    *at = f;
+    block(s);
+}
+
+/* EVENT-LOOP ( -- ) Run fibers until none is left */
+static void p_event_loop(vm_t *vm) {
+    sched_t *s = vm->fibers;
+    if (!s) return;
+    if (s->current != &s->main) {
+        vm_abort(vm, "EVENT-LOOP: not inside a fiber");
+        return;
+    }
+    while (s->live > 0 && vm->running) {
+        if (!s->ready && !s->timers && !s->io_waiting) break;
+        s->loop_waiter = &s->main;
+        block(s);
+        s->loop_waiter = NULL;
+    }
+}
+
+void vm_fibers_release(vm_t *vm) {
+    sched_t *s = vm->fibers;
+    if (!s) return;
+    while (s->all) fiber_free(s, s->all);
+    if (s->poll_fd >= 0) close(s->poll_fd);
+    free(s);
+    vm->fibers = NULL;
+}
+
+/* ============================================================
+ * Sockets
+ *
+ * Sockets are plain descriptors, non-blocking. An operation that
+ * would block waits for readiness, which lets other fibers run.
+ * ============================================================ */
+
+static int set_nonblock(int fd) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static bool would_block(void) {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+/* TCP-LISTEN ( port -- fd ) */
+static void p_tcp_listen(vm_t *vm) {
+    cell_t port = pop(vm);
+    struct sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons((uint16_t)port);
+    a.sin_addr.s_addr = htonl(INADDR_ANY);
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+                    bind(fd, (struct sockaddr *)&a, sizeof(a)) != 0 ||
+                    listen(fd, SOMAXCONN) != 0)) {
+        close(fd);
+        fd = -1;
+    }
+    push(vm, fd < 0 ? -1 : set_nonblock(fd));
+}
+
+/* TCP-CONNECT ( addr u port -- fd ) Host name or address; -1 on failure */
+static void p_tcp_connect(vm_t *vm) {
+    cell_t port = pop(vm);
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    char host[256], service[16];
+    size_t n = len < 0 ? 0 : (size_t)len < sizeof(host) ? (size_t)len : sizeof(host) - 1;
+    memcpy(host, vm->mem + addr, n);
+    host[n] = '\0';
+    snprintf(service, sizeof(service), "%ld", (long)port);
+
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int fd = -1;
+    if (getaddrinfo(host, service, &hints, &res) == 0) {
+        for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) continue;
+            set_nonblock(fd);
+            int err = 0;
+            if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+                err = errno;
+                if (err == EINPROGRESS) {
+                    vm_fiber_wait_fd(vm, fd, true);
+                    socklen_t el = sizeof(err);
+                    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &el) != 0) err = errno;
+                }
+            }
+            if (err) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(res);
+    }
+    push(vm, fd);
+}
+
+/* SOCK-ACCEPT ( fd -- fd' ) -1 on failure */
+static void p_sock_accept(vm_t *vm) {
+    int fd = (int)pop(vm);
+    for (;;) {
+        int c = accept(fd, NULL, NULL);
+        if (c >= 0) {
+            push(vm, set_nonblock(c));
+            return;
+        }
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        if (!would_block()) break;
+        vm_fiber_wait_fd(vm, fd, false);
+    }
+    push(vm, -1);
+}
+
+/* SOCK-PORT ( fd -- port ) -1 if not bound */
+static void p_sock_port(vm_t *vm) {
+    int fd = (int)pop(vm);
+    struct sockaddr_storage a;
+    socklen_t len = sizeof(a);
+    cell_t port = -1;
+    if (getsockname(fd, (struct sockaddr *)&a, &len) == 0) {
+        if (a.ss_family == AF_INET) port = ntohs(((struct sockaddr_in *)&a)->sin_port);
+        else if (a.ss_family == AF_INET6) port = ntohs(((struct sockaddr_in6 *)&a)->sin6_port);
+    }
+    push(vm, port);
+}
+
+/* SOCK-READ ( addr u fd -- n ) What has arrived, up to u bytes */
+static void p_sock_read(vm_t *vm) {
+    int fd = (int)pop(vm);
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    if (len <= 0 || !vm_range_writable(vm, addr, len)) {
+        push(vm, len == 0 ? 0 : -1);
+        return;
+    }
+    for (;;) {
+        ssize_t n = read(fd, vm->mem + addr, (size_t)len);
+        if (n >= 0) {
+            push(vm, (cell_t)n);
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (!would_block()) break;
+        vm_fiber_wait_fd(vm, fd, false);
+    }
+    push(vm, -1);
+}
+
+/* SOCK-WRITE ( addr u fd -- n ) */
+static void p_sock_write(vm_t *vm) {
+    int fd = (int)pop(vm);
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    cell_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, vm->mem + addr + done, (size_t)(len - done));
+        if (n >= 0) {
+            done += n;
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (!would_block()) {
+            push(vm, -1);
+            return;
+        }
+        vm_fiber_wait_fd(vm, fd, true);
+    }
+    push(vm, done);
+}
+
+/* SOCK-CLOSE ( fd -- ) */
+static void p_sock_close(vm_t *vm) {
+    close((int)pop(vm));
+}
+
+void fiber_init(vm_t *vm) {
+    vm_add_prim(vm, "fiber",       p_fiber,       false);
+    vm_add_prim(vm, "yield",       p_yield,       false);
+    vm_add_prim(vm, "ms",          p_ms,          false);
+    vm_add_prim(vm, "event-loop",  p_event_loop,  false);
+    vm_add_prim(vm, "tcp-listen",  p_tcp_listen,  false);
+    vm_add_prim(vm, "tcp-connect", p_tcp_connect, false);
+    vm_add_prim(vm, "sock-accept", p_sock_accept, false);
+    vm_add_prim(vm, "sock-port",   p_sock_port,   false);
+    vm_add_prim(vm, "sock-read",   p_sock_read,   false);
+    vm_add_prim(vm, "sock-write",  p_sock_write,  false);
+    vm_add_prim(vm, "sock-close",  p_sock_close,  false);
+}
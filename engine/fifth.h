@@ -10,6 +10,10 @@
  * Threading: indirect via C function pointers. Each dictionary entry
  * has a code field (prim_fn). For colon definitions, code = docol.
  * For variables, code = dovar. For constants, code = docon.
+ *
+ * Compiled code cells hold XTs (dict indices) by default. Building with
+ * -DFIFTH_DIRECT_THREADED (make THREADING=direct) compiles code-field
+ * addresses instead and runs a register-resident inner interpreter.
  */
 
 #ifndef FIFTH_H
@@ -20,16 +24,35 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <signal.h>
+#include <setjmp.h>
 
 /* === Configuration === */
-#define DSTACK_SIZE   256
-#define RSTACK_SIZE   256
-#define MEM_SIZE      (1024 * 1024)   /* 1 MB dictionary/data space */
+#define DSTACK_SIZE   512             /* Cells; 4 KB, a page, on 64-bit */
+#define RSTACK_SIZE   512
 #define TIB_SIZE      1024
 #define PAD_SIZE      4096
 #define MAX_FILES     16
 #define NAME_MAX_LEN  31
-#define MAX_DICT      8192
+#define MAX_FUSIONS   8
+#define HASH_BUCKETS  4096            /* Power of two */
+#define BLOOM_BITS    65536           /* Negative-lookup filter over names */
+#define MAX_VIEWS     16              /* Mapped files per VM */
+#define OUT_BUF_SIZE  65536           /* Console output buffer (OUTPUT-BUFFER) */
+#define MAX_CAPTURES  8               /* Nested CAPTURE-BEGIN */
+#if UINTPTR_MAX > 0xffffffffu
+#define MEM_SIZE_DEFAULT  ((size_t)16 << 20)  /* Data space limit (--mem, FIFTH_MEM) */
+#define DICT_SIZE_DEFAULT 65536               /* Entry limit (--dict, FIFTH_DICT) */
+#define VIEW_SPACE    ((size_t)1 << 30)  /* Reserved above mem[] for file views */
+#define SCRATCH_SIZE  ((size_t)64 << 20) /* Per-VM scratch arena (arena.c) */
+#define STRINGS_SIZE  ((size_t)64 << 20) /* Per-VM string space (arena.c) */
+#else
+#define MEM_SIZE_DEFAULT  ((size_t)1 << 20)
+#define DICT_SIZE_DEFAULT 8192
+#define VIEW_SPACE    ((size_t)64 << 20)
+#define SCRATCH_SIZE  ((size_t)4 << 20)
+#define STRINGS_SIZE  ((size_t)4 << 20)
+#endif
 
 /* === Types === */
 typedef intptr_t  cell_t;
@@ -43,37 +66,124 @@ typedef void (*prim_fn)(vm_t *vm);
 #define F_HIDDEN     0x40
 #define F_LENMASK    0x3F
 
+/* === Compiler Attributes (dict_head_t.attrs) === */
+#define A_SINK       0x01            /* ( addr u -- ) writes the bytes in order: literal calls join */
+
 /* === Dictionary Entry ===
- * Stored in a C struct array (not in flat memory).
+ * Stored in C struct arrays indexed by XT (not in flat memory).
  * This simplifies the C code and is fine because Fifth
  * doesn't need FORGET or MARKER.
+ *
+ * An entry is split in two. dict[] holds what running a word reads,
+ * 32 bytes on 64-bit so two share a cache line; heads[] holds what
+ * only lookup, compilation and introspection read.
  */
 typedef struct {
-    int          link;               /* Index of previous entry (-1 = end) */
-    uint8_t      flags;              /* F_IMMEDIATE | F_HIDDEN | name length */
-    char         name[NAME_MAX_LEN + 1];
     prim_fn      code;               /* Handler: primitive, docol, dovar, docon, dodoes */
     cell_t       param;              /* Body: byte offset in mem[] or constant value */
     cell_t       does;               /* DOES> IP (byte offset), -1 if unused */
+    uint16_t     hits;               /* Colon calls counted for the JIT (jit.c) */
 } dict_entry_t;
 
+typedef struct {
+    int          link;               /* Index of previous entry (-1 = end) */
+    uint8_t      flags;              /* F_IMMEDIATE | F_HIDDEN | name length */
+    uint8_t      attrs;              /* A_SINK */
+    char         name[NAME_MAX_LEN + 1];
+} dict_head_t;
+
+/* === Superinstruction Rule ===
+ * A short sequence of words the colon compiler folds into one fused
+ * primitive as it is compiled (see vm_compile_xt in prims.c).
+ */
+typedef struct {
+    const char  *name;               /* Fused primitive, e.g. "(lit+)" */
+    int          seq[3];             /* XTs replaced, oldest first */
+    int          len;                /* Number of XTs in seq (2 or 3) */
+    int          fused;              /* XT of the fused primitive */
+    bool         operand;            /* seq[0] carries an inline operand */
+} fusion_rule_t;
+
+/* === Clone Snapshot ===
+ * Write tracking and snapshot file behind copy-on-write clones.
+ */
+typedef struct {
+    int          fd;                 /* Snapshot file, -1 = none */
+    size_t       dict_len, heads_len, mem_len;  /* Tracked spans, in this order in fd */
+    uint64_t    *written;            /* Bit per tracked page written since arm() */
+    volatile size_t written_pages;
+    volatile sig_atomic_t dirty;     /* Untracked: any page may have changed */
+} vm_snap_t;
+
+/* === File View ===
+ * A file mapped into the VM's address space above mem[] (region.c).
+ */
+typedef struct {
+    cell_t       addr;               /* Byte offset from mem, >= vm_mem_size */
+    size_t       len;                /* File size */
+    size_t       span;               /* Mapped bytes, page-rounded */
+    int          fd;                 /* Kept open so clones can map it too; -1 = scratch */
+} vm_view_t;
+
+/* === Source File ===
+ * A file being loaded: its whole text, shared through the source cache
+ * (vm.c), and the offset of the next line to parse.
+ */
+typedef struct {
+    const char  *text;               /* Not NUL-terminated */
+    size_t       len;
+    size_t       pos;                /* Start of the next line */
+} vm_source_t;
+
+/* === Output Buffer ===
+ * Console output collected before it reaches vm->out (io.c).
+ */
+typedef struct {
+    char        *buf;                /* Allocated on first write */
+    size_t       len, cap;           /* cap 0 = unbuffered */
+    bool         line;               /* Sink is a terminal: flush at newlines */
+    bool         memory;             /* Capture: grow, never flush */
+} vm_obuf_t;
+
 /* === Virtual Machine === */
 struct vm {
-    /* Dictionary */
-    dict_entry_t dict[MAX_DICT];
+    /* Dictionary (vm_dict_size entries reserved, own mappings) */
+    dict_entry_t *dict;
+    dict_head_t  *heads;             /* Names and flags, same index */
     int          dict_count;
     int          latest;             /* Index of most recent visible entry */
 
-    /* Data space (byte-addressable) */
-    uint8_t      mem[MEM_SIZE];
-    cell_t       here;               /* Next free byte offset */
+    /* Name index: case-folded hash chains, newest entry first */
+    int          hash_head[HASH_BUCKETS];
+    int         *hash_next;          /* vm_dict_size links, with the region */
+    uint64_t     name_bloom[BLOOM_BITS / 64];  /* Two bits per name; clear = no such word */
+    int          numeric_names;      /* Entries whose names look like numbers */
 
-    /* Data stack (grows downward) */
-    cell_t       dstack[DSTACK_SIZE];
+    /* Data space (byte-addressable, vm_mem_size bytes reserved, own mapping) */
+    uint8_t     *mem;
+    cell_t       here;               /* Next free byte offset */
+    int          region;             /* Slot of dict/heads/mem in region.c */
+
+    /* Copy-on-write snapshot shared with clones (region.c) */
+    vm_snap_t    snap;
+
+    /* Mapped files, sorted by addr (region.c) */
+    vm_view_t    views[MAX_VIEWS];
+    int          view_count;
+    cell_t       slurp_view;         /* View SLURP-FILE made last, 0 = none */
+    cell_t       scratch;            /* Scratch arena (arena.c), 0 = not made yet */
+    cell_t       strings;            /* String space arena (arena.c), 0 = not made yet */
+    cell_t       env_seen;           /* GETENV results in string space (io.c), 0 = none */
+    cell_t       arg_copies;         /* ARGV addr len pairs in string space (io.c), 0 = none */
+    cell_t       run_out, run_len;   /* Last RUN-CAPTURE output, given back by the next */
+
+    /* Data stack (grows downward), DSTACK_SIZE cells between guard
+     * pages (region.c) */
+    cell_t      *dstack;
     cell_t      *sp;
 
-    /* Return stack (grows downward) */
-    cell_t       rstack[RSTACK_SIZE];
+    /* Return stack (grows downward), RSTACK_SIZE cells, the same */
+    cell_t      *rstack;
     cell_t      *rsp;
 
     /* Interpreter */
@@ -82,17 +192,23 @@ struct vm {
     cell_t       state;              /* 0 = interpret, -1 = compile */
     cell_t       base;               /* Number base (default 10) */
 
-    /* Input */
-    char         tib[TIB_SIZE];
+    /* Input: the line being parsed. Points into tib_buf for the REPL,
+     * at the string for -e, and into the file itself while loading. */
+    const char  *tib;
     int          tib_len;
     int          tib_pos;
+    bool         tib_file;           /* tib is a line of input[input_depth] */
+    char         tib_buf[TIB_SIZE];
 
     /* Input source stack (for INCLUDE/REQUIRE) */
-    FILE        *input[MAX_FILES];
+    vm_source_t  input[MAX_FILES];
     int          input_depth;        /* 0 = stdin/tib */
 
     /* Output */
     FILE        *out;                /* Current output (stdout default) */
+    vm_obuf_t    obuf;               /* Pending output, or the capture */
+    vm_obuf_t    captures[MAX_CAPTURES];  /* Outer buffers while capturing */
+    int          capture_depth;
 
     /* File handles for Forth-level file ops */
     FILE        *files[MAX_FILES];
@@ -107,6 +223,7 @@ struct vm {
     /* State */
     bool         running;
     int          exit_code;
+    unsigned     aborts;             /* vm_abort count; native code unwinds on a change */
 
     /* Cached XTs for compiler internals */
     int          xt_lit;
@@ -119,10 +236,38 @@ struct vm {
     int          xt_loop;
     int          xt_ploop;
     int          xt_does;
+    int          xt_tailcall;        /* Jump to a colon body, for a call before ; */
+
+    /* Superinstruction fusion (peephole over the current definition) */
+    fusion_rule_t fusions[MAX_FUSIONS];
+    int          fusion_count;
+    int          fusion_hits[MAX_FUSIONS]; /* Per-definition, reset by : */
+    cell_t       peep_last;          /* Offset of last compiled instruction, -1 = none */
+    cell_t       peep_prev;          /* Offset of the one before it */
+    cell_t       tail_at;            /* Offset of the last XT compiled unfused */
+    cell_t       tail_refs[4];       /* THENs resolved to HERE since tail_at */
+    int          tail_nrefs;         /* -1 = another label is at HERE */
+    cell_t       join_at;            /* (s") of a literal just passed to a sink, -1 = none */
+    int          join_hits;          /* Literals joined, per definition */
+    bool         trace_fusions;      /* Report fusions at ; */
 
     /* Require tracking (prevent double-load) */
     char        *loaded_files[256];
     int          loaded_count;
+
+    /* Script arguments for ARGC and ARGV: the command line from the
+     * first file on, or a request's under --serve. Not owned. */
+    char       **args;
+    int          arg_count;
+
+    /* SQLite connections and statements (sql.c), NULL until used */
+    void        *sql;
+
+    /* Call counters while profiling (profile.c), NULL until used */
+    void        *prof;
+
+    /* Green threads (fiber.c), NULL until used */
+    void        *fibers;
 };
 
 /* === Inline Stack Operations === */
@@ -160,6 +305,31 @@ static inline void vm_compile_cell(vm_t *vm, cell_t val) {
     vm->here += sizeof(cell_t);
 }
 
+/* === Threaded Code Cells ===
+ * A compiled instruction is one cell. In the default build it is the XT.
+ * In the direct-threaded build it is the code-field address: the byte
+ * offset of the entry within dict[]. Like mem[] addresses it is an
+ * offset rather than a pointer, so compiled code stays valid in cloned
+ * VMs. Everything that compiles or inspects instructions goes through
+ * these helpers; literal operands are still plain cells.
+ */
+#ifdef FIFTH_DIRECT_THREADED
+static inline cell_t vm_xt_to_cell(int xt)   { return (cell_t)xt * (cell_t)sizeof(dict_entry_t); }
+static inline int    vm_cell_to_xt(cell_t c) { return (int)(c / (cell_t)sizeof(dict_entry_t)); }
+#else
+static inline cell_t vm_xt_to_cell(int xt)   { return (cell_t)xt; }
+static inline int    vm_cell_to_xt(cell_t c) { return (int)c; }
+#endif
+
+/* Forget the peephole history. Called wherever a branch target lands at
+ * HERE, so no fusion ever spans a label. */
+static inline void vm_peep_barrier(vm_t *vm) {
+    vm->peep_last = -1;
+    vm->peep_prev = -1;
+    vm->tail_nrefs = -1;
+    vm->join_at = -1;
+}
+
 static inline cell_t vm_align(cell_t n) {
     return (n + sizeof(cell_t) - 1) & ~(sizeof(cell_t) - 1);
 }
@@ -174,16 +344,26 @@ static inline cell_t vm_fetch_ip(vm_t *vm) {
 /* === API === */
 
 /* Lifecycle */
+vm_t *vm_alloc(void);                        /* Zeroed VM with data space, no words */
 vm_t *vm_create(void);
 void  vm_destroy(vm_t *vm);
+void  vm_reset(vm_t *vm);                    /* Wipe for reuse, keeping dict/mem mappings */
+vm_t *vm_clone(vm_t *parent, vm_t *reuse);  /* Copy-on-write child, refilling reuse (spawn.c) */
 
 /* Execution */
 void  vm_repl(vm_t *vm);
 int   vm_load_file(vm_t *vm, const char *path);
+int   vm_load_source(vm_t *vm, const char *text, size_t len);  /* Text as if it were a file */
+bool  vm_refill(vm_t *vm);                   /* Next line of the file being loaded */
 void  vm_interpret_line(vm_t *vm, const char *line);
 
+/* Compilation */
+void  vm_compile_xt(vm_t *vm, int xt);      /* Compile a word, fusing where possible */
+
 /* Dictionary */
 int   vm_find(vm_t *vm, const char *name, int len);
+void  vm_hash_insert(vm_t *vm, int idx);    /* Index a new entry (after its name is set) */
+void  vm_hash_rebuild(vm_t *vm);            /* Reindex dict[0..dict_count) */
 int   vm_add_prim(vm_t *vm, const char *name, prim_fn fn, bool immediate);
 void  vm_add_constant(vm_t *vm, const char *name, cell_t value);
 void  vm_add_variable(vm_t *vm, const char *name, cell_t initial);
@@ -199,12 +379,114 @@ int   vm_word(vm_t *vm, char *buf);          /* Parse next whitespace-delimited
 int   vm_parse(vm_t *vm, char delim, char *buf); /* Parse until delimiter */
 bool  vm_try_number(vm_t *vm, const char *s, int len, cell_t *result);
 void  vm_execute(vm_t *vm, int xt);          /* Execute a single XT */
+void  vm_execute_caught(vm_t *vm, int xt);   /* The same; a stack fault inside aborts */
 void  vm_run(vm_t *vm);                      /* Run from current IP until EXIT */
 void  vm_abort(vm_t *vm, const char *msg);   /* Abort with message */
 
+/* Byte-set scans (prims.c): SSE2/NEON for up to 8 bytes, a table otherwise */
+typedef struct {
+    uint8_t        in[256];          /* Membership */
+    const uint8_t *bytes;            /* The same set as a list */
+    int            n;
+} vm_byteset_t;
+void   vm_byteset_init(vm_byteset_t *s, const uint8_t *bytes, int n);
+size_t vm_byteset_scan(const vm_byteset_t *s, const uint8_t *p, size_t n);  /* First hit, or n */
+
+/* Output and files (io.c) */
+void  vm_expand_path(const char *in, char *out, int max);  /* Leading ~ */
+void  vm_write(vm_t *vm, const void *p, size_t n);  /* Buffered console output */
+void  vm_emit(vm_t *vm, int c);
+void  vm_flush(vm_t *vm);                   /* Before input, SYSTEM, exit */
+void  vm_out_reset(vm_t *vm);               /* Drop captures and flush (ABORT) */
+void  vm_out_release(vm_t *vm);             /* Flush and free the buffers */
+void  vm_set_args(vm_t *vm, int argc, char **argv);  /* What ARGC and ARGV see */
+bool  vm_require_mark(vm_t *vm, const char *path);  /* Record for REQUIRE; false if already loaded */
+
+/* Memory regions (region.c) */
+extern size_t vm_mem_size;                  /* Data space limit, bytes */
+extern int    vm_dict_size;                 /* Dictionary limit, entries */
+int   vm_set_limits(size_t mem, int dict);  /* Before the first VM; -1 if out of range */
+int   vm_region_alloc(vm_t *vm);            /* Reserve dict[] and mem[] */
+void  vm_region_free(vm_t *vm);
+int   vm_region_clone(vm_t *child, vm_t *parent);  /* Map parent's pages into child, COW */
+bool  vm_mem_writable(vm_t *vm, cell_t end);  /* Commit mem[0..end); false past the limit */
+bool  vm_range_valid(vm_t *vm, cell_t addr, cell_t len);  /* In mem[] or inside one view */
+bool  vm_range_writable(vm_t *vm, cell_t addr, cell_t len);  /* Same, and ready for a syscall to write */
+cell_t vm_map_view(vm_t *vm, int fd, size_t len);  /* Takes fd (-1 = scratch); -1 on failure */
+cell_t vm_map_view_at(vm_t *vm, cell_t at, size_t len);  /* Scratch at a given address; -1 if taken */
+int   vm_unmap_view(vm_t *vm, cell_t addr);
+
+/* Stack faults. The outer interpreter (a line at a time) and
+ * vm_execute_caught push one of these; a push or pop that reaches a
+ * guard page jumps back to the innermost one on the thread, with fault
+ * set. */
+#define FAULT_DSTACK_OVER   1
+#define FAULT_DSTACK_UNDER  2
+#define FAULT_RSTACK_OVER   3
+#define FAULT_RSTACK_UNDER  4
+typedef struct vm_catch {
+    sigjmp_buf        jb;
+    vm_t             *vm;
+    int               xt;            /* Word running under it, for the backtrace; -1 = none */
+    int               fault;
+    struct vm_catch  *prev;
+} vm_catch_t;
+extern _Thread_local vm_catch_t *vm_catch_top;  /* Per C stack: fibers swap it */
+
+/* Arenas (arena.c) */
+cell_t vm_scratch_alloc(vm_t *vm, size_t n);  /* Transient bytes; aborts and -1 when full */
+void  vm_scratch_trim(vm_t *vm, cell_t at, size_t n);  /* Give back the last allocation */
+cell_t vm_string_alloc(vm_t *vm, size_t n);  /* Bytes kept for the VM's life and by images; aborts and -1 when full */
+int   vm_strings_place(vm_t *vm, cell_t at);  /* Map empty string space at at, for an image; -1 if taken */
+cell_t vm_arena_alloc(vm_t *vm, cell_t arena, size_t n);  /* Cell-aligned; -1 if full or not an arena */
+void *vm_cells(vm_t *vm, cell_t addr, cell_t n, const char *word);  /* n cells at addr; NULL and an abort if out of range */
+size_t vm_arena_used(vm_t *vm, cell_t addr);  /* Bytes of a view clones copy, 0 = not an arena */
+
+/* Profiling (profile.c) */
+#define PROFILE_COUNT   1            /* --profile: calls and ticks per XT */
+#define PROFILE_SAMPLE  2            /* --profile-sample: SIGPROF stacks */
+extern int vm_profile_mode;                 /* 0 = off; vm_run checks it once per call */
+void  vm_profile_start(int mode, int hz, const char *folded);  /* After boot */
+void  vm_profile_report(vm_t *vm);          /* Stop, merge and print to stderr */
+void  vm_profile_release(vm_t *vm);         /* Merge a VM's counters */
+void  vm_run_profiled(vm_t *vm);
+void  vm_execute_profiled(vm_t *vm, int xt);
+
+/* JIT (jit.c) */
+extern int vm_jit_threshold;                /* --jit: calls before native code, 0 = off */
+bool  vm_jit_compile(vm_t *vm, int xt);     /* Replace docol; false leaves it threaded */
+bool  vm_jit_owns(prim_fn code);            /* Code field is native code */
+
+/* Count a colon call (docol) towards the threshold */
+static inline void vm_jit_hit(vm_t *vm, dict_entry_t *w) {
+    if (w->hits < vm_jit_threshold && ++w->hits == vm_jit_threshold)
+        vm_jit_compile(vm, (int)(w - vm->dict));
+}
+
+/* Server mode (serve.c) */
+int   vm_serve(vm_t *vm, const char *path, int workers);  /* --serve; returns only on failure */
+int   vm_serve_connect(const char *path, int argc, char **argv);  /* --connect; exit status */
+
+/* Images (image.c) */
+int   vm_save_image(vm_t *vm, const char *path);
+int   vm_load_image(vm_t *vm, const char *path);
+
 /* Registration */
 void  prims_init(vm_t *vm);
 void  io_init(vm_t *vm);
+void  sql_init(vm_t *vm);                   /* Called from io_init */
+void  sql_release(vm_t *vm);
 void  spawn_init(vm_t *vm);
+void  chan_init(vm_t *vm);
+void  arena_init(vm_t *vm);
+void  fiber_init(vm_t *vm);
+void  vec_init(vm_t *vm);
+void  hmap_init(vm_t *vm);
+void  sort_init(vm_t *vm);
+void  vm_fibers_release(vm_t *vm);
+void  vm_fiber_wait_fd(vm_t *vm, int fd, bool write);  /* Let other fibers run until fd is ready */
+void  task_blocking(void);                  /* About to block outside the task pool */
+int   vm_run_jobs(vm_t *vm, char **files, int n, int jobs);  /* --jobs; -1 if any failed */
+void  fusions_init(vm_t *vm);                /* Resolve superinstruction rules */
 
 #endif /* FIFTH_H */
@@ -0,0 +1,304 @@
+/* hmap.c - Hash maps in arena memory
+ *
+ * A map is an open-addressing hash table (linear probing, tombstones
+ * for deletes) kept entirely inside an arena (arena.c): header, slot
+ * array and a copy of every string key, all addressed by mem[] offsets.
+ * A task's clone gets a copy of the arena at the same addresses, so it
+ * can read the map, and change its own copy, with nothing to fix up.
+ * Resetting the arena to a mark taken before HMAP-NEW, or freeing it,
+ * frees the map with it.
+ *
+ *   hmap-new   ( arena -- map )
+ *   hmap-put   ( x addr u map -- )          String key; the key is copied
+ *   hmap-get   ( addr u map -- x true | 0 false )
+ *   hmap-del   ( addr u map -- flag )       True if it was there
+ *   hmap-put#  ( x n map -- )               Cell key
+ *   hmap-get#  ( n map -- x true | 0 false )
+ *   hmap-del#  ( n map -- flag )
+ *   hmap-count ( map -- n )
+ *   hmap-each  ( xt map -- )                xt ( addr u x -- ) per entry;
+ *                                           a cell key n comes as n -1
+ *
+ * The table doubles at 3/4 full, copying into a new slot array in the
+ * same arena; the old one is not reused. Putting new keys from inside
+ * HMAP-EACH aborts rather than skip or repeat entries.
+ */
+
+#include "fifth.h"
+
+#define HMAP_MAGIC  ((cell_t)0x484d6170)     /* "HMap" */
+#define HMAP_MIN    16                       /* Initial slots */
+
+/* Slot hash values: 0 free, 1 deleted, anything else in use */
+#define SLOT_FREE   0
+#define SLOT_DEAD   1
+#define LIVE(s)     ((s)->hash != SLOT_FREE && (s)->hash != SLOT_DEAD)
+
+typedef struct {
+    cell_t  magic;
+    cell_t  arena;                   /* Where slots and keys are allocated */
+    cell_t  slots;                   /* Offset of the slot array */
+    cell_t  cap;                     /* Slots, a power of two */
+    cell_t  count;                   /* Live entries */
+    cell_t  used;                    /* Live plus deleted */
+} hmap_t;
+
+typedef struct {
+    cell_t  hash;
+    cell_t  key;                     /* Offset of the key bytes, or the cell key */
+    cell_t  len;                     /* Key length, -1 = cell key */
+    cell_t  value;
+} slot_t;
+
+/* The map at m, which must lie in the used part of an arena */
+static hmap_t *hmap_get(vm_t *vm, cell_t m, const char *word) {
+    hmap_t *h = NULL;
+    for (int i = 0; i < vm->view_count && !h; i++) {
+        vm_view_t *v = &vm->views[i];
+        if (v->fd < 0 && m > v->addr && (m & (cell_t)(sizeof(cell_t) - 1)) == 0 &&
+            m - v->addr + sizeof(hmap_t) <= vm_arena_used(vm, v->addr))
+            h = (hmap_t *)(vm->mem + m);
+    }
+    if (!h || h->magic != HMAP_MAGIC) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s: not a hash map", word);
+        vm_abort(vm, msg);
+        return NULL;
+    }
+    return h;
+}
+
+/* False (and an abort) unless the u key bytes at addr are in mem[] or a view */
+static bool key_ok(vm_t *vm, cell_t addr, cell_t u, const char *word) {
+    if (vm_range_valid(vm, addr, u)) return true;
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%s: key out of range", word);
+    vm_abort(vm, msg);
+    return false;
+}
+
+static slot_t *slot_at(vm_t *vm, hmap_t *h, cell_t i) {
+    return (slot_t *)(vm->mem + h->slots) + i;
+}
+
+/* 64-bit multiply-xorshift over 8-byte words */
+static cell_t hash_bytes(const uint8_t *p, size_t n) {
+    const uint64_t K = 0x9E3779B97F4A7C15ull;
+    uint64_t h = n * K;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * K;
+        h ^= h >> 29;
+    }
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    h = (h ^ w) * K;
+    h ^= h >> 32;
+    return (cell_t)(h | 2);
+}
+
+static cell_t hash_cell(cell_t n) {
+    uint64_t h = (uint64_t)n;        /* splitmix64 finalizer */
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return (cell_t)(h | 2);
+}
+
+/* Slot array of cap slots in the map's arena, zeroed; -1 if full */
+static cell_t slots_new(vm_t *vm, hmap_t *h, cell_t cap) {
+    cell_t at = vm_arena_alloc(vm, h->arena, (size_t)cap * sizeof(slot_t));
+    if (at >= 0) memset(vm->mem + at, 0, (size_t)cap * sizeof(slot_t));
+    return at;
+}
+
+/* Index of key's slot, or of the slot to insert it in (-1 if absent and
+ * for a lookup only) */
+static cell_t probe(vm_t *vm, hmap_t *h, cell_t hash, cell_t key, cell_t len,
+                    const uint8_t *bytes, bool insert) {
+    cell_t mask = h->cap - 1, first_dead = -1;
+    for (cell_t i = hash & mask;; i = (i + 1) & mask) {
+        slot_t *s = slot_at(vm, h, i);
+        if (s->hash == SLOT_FREE) return insert ? (first_dead >= 0 ? first_dead : i) : -1;
+        if (s->hash == SLOT_DEAD) {
+            if (first_dead < 0) first_dead = i;
+        } else if (s->hash == hash && s->len == len &&
+                   (len < 0 ? s->key == key : memcmp(vm->mem + s->key, bytes, (size_t)len) == 0)) {
+            return i;
+        }
+    }
+}
+
+/* Room for one more entry: double (or just clear tombstones) at 3/4 */
+static bool reserve(vm_t *vm, hmap_t *h) {
+    if ((h->used + 1) * 4 <= h->cap * 3) return true;
+    cell_t cap = (h->count + 1) * 2 > h->cap ? h->cap * 2 : h->cap;
+    cell_t old = h->slots, old_cap = h->cap;
+    cell_t at = slots_new(vm, h, cap);
+    if (at < 0) return false;
+    h->slots = at;
+    h->cap = cap;
+    h->used = h->count;
+    for (cell_t i = 0; i < old_cap; i++) {
+        slot_t *s = (slot_t *)(vm->mem + old) + i;
+        if (!LIVE(s)) continue;
+        cell_t j = s->hash & (cap - 1);
+        while (slot_at(vm, h, j)->hash != SLOT_FREE) j = (j + 1) & (cap - 1);
+        *slot_at(vm, h, j) = *s;
+    }
+    return true;
+}
+
+static void put(vm_t *vm, hmap_t *h, cell_t hash, cell_t key, cell_t len, cell_t x) {
+    const uint8_t *bytes = vm->mem + (len >= 0 ? key : 0);
+    cell_t i = probe(vm, h, hash, key, len, bytes, false);
+    if (i >= 0) {
+        slot_at(vm, h, i)->value = x;
+        return;
+    }
+    if (!reserve(vm, h)) {
+        vm_abort(vm, "HMAP-PUT: arena full");
+        return;
+    }
+    if (len >= 0) {                  /* Keep our own copy of the key */
+        cell_t copy = vm_arena_alloc(vm, h->arena, (size_t)len);
+        if (copy < 0) {
+            vm_abort(vm, "HMAP-PUT: arena full");
+            return;
+        }
+        memcpy(vm->mem + copy, bytes, (size_t)len);
+        key = copy;
+    }
+    i = probe(vm, h, hash, key, len, vm->mem + (len >= 0 ? key : 0), true);
+    slot_t *s = slot_at(vm, h, i);
+    if (s->hash == SLOT_FREE) h->used++;
+    *s = (slot_t){ hash, key, len, x };
+    h->count++;
+}
+
+static void get(vm_t *vm, hmap_t *h, cell_t hash, cell_t key, cell_t len) {
+    cell_t i = probe(vm, h, hash, key, len, vm->mem + (len >= 0 ? key : 0), false);
+    push(vm, i >= 0 ? slot_at(vm, h, i)->value : 0);
+    push(vm, i >= 0 ? -1 : 0);
+}
+
+static void del(vm_t *vm, hmap_t *h, cell_t hash, cell_t key, cell_t len) {
+    cell_t i = probe(vm, h, hash, key, len, vm->mem + (len >= 0 ? key : 0), false);
+    if (i >= 0) {
+        slot_at(vm, h, i)->hash = SLOT_DEAD;
+        h->count--;
+    }
+    push(vm, i >= 0 ? -1 : 0);
+}
+
+/* ============================================================
+ * Primitives
+ * ============================================================ */
+
+/* HMAP-NEW ( arena -- map ) */
+static void p_hmap_new(vm_t *vm) {
+    cell_t a = pop(vm);
+    cell_t m = vm_arena_alloc(vm, a, sizeof(hmap_t));
+    if (m < 0) {
+        vm_abort(vm, "HMAP-NEW: not an arena, or full");
+        return;
+    }
+    hmap_t *h = (hmap_t *)(vm->mem + m);
+    *h = (hmap_t){ HMAP_MAGIC, a, 0, HMAP_MIN, 0, 0 };
+    if ((h->slots = slots_new(vm, h, HMAP_MIN)) < 0) {
+        h->magic = 0;
+        vm_abort(vm, "HMAP-NEW: arena full");
+        return;
+    }
+    push(vm, m);
+}
+
+/* HMAP-PUT ( x addr u map -- ) */
+static void p_hmap_put(vm_t *vm) {
+    cell_t m = pop(vm), u = pop(vm), addr = pop(vm), x = pop(vm);
+    hmap_t *h = hmap_get(vm, m, "HMAP-PUT");
+    if (h && key_ok(vm, addr, u, "HMAP-PUT")) put(vm, h, hash_bytes(vm->mem + addr, (size_t)u), addr, u, x);
+}
+
+/* HMAP-GET ( addr u map -- x true | 0 false ) */
+static void p_hmap_get(vm_t *vm) {
+    cell_t m = pop(vm), u = pop(vm), addr = pop(vm);
+    hmap_t *h = hmap_get(vm, m, "HMAP-GET");
+    if (h && key_ok(vm, addr, u, "HMAP-GET")) get(vm, h, hash_bytes(vm->mem + addr, (size_t)u), addr, u);
+}
+
+/* HMAP-DEL ( addr u map -- flag ) */
+static void p_hmap_del(vm_t *vm) {
+    cell_t m = pop(vm), u = pop(vm), addr = pop(vm);
+    hmap_t *h = hmap_get(vm, m, "HMAP-DEL");
+    if (h && key_ok(vm, addr, u, "HMAP-DEL")) del(vm, h, hash_bytes(vm->mem + addr, (size_t)u), addr, u);
+}
+
+/* HMAP-PUT# ( x n map -- ) */
+static void p_hmap_put_cell(vm_t *vm) {
+    cell_t m = pop(vm), n = pop(vm), x = pop(vm);
+    hmap_t *h = hmap_get(vm, m, "HMAP-PUT#");
+    if (h) put(vm, h, hash_cell(n), n, -1, x);
+}
+
+/* HMAP-GET# ( n map -- x true | 0 false ) */
+static void p_hmap_get_cell(vm_t *vm) {
+    cell_t m = pop(vm), n = pop(vm);
+    hmap_t *h = hmap_get(vm, m, "HMAP-GET#");
+    if (h) get(vm, h, hash_cell(n), n, -1);
+}
+
+/* HMAP-DEL# ( n map -- flag ) */
+static void p_hmap_del_cell(vm_t *vm) {
+    cell_t m = pop(vm), n = pop(vm);
+    hmap_t *h = hmap_get(vm, m, "HMAP-DEL#");
+    if (h) del(vm, h, hash_cell(n), n, -1);
+}
+
+/* HMAP-COUNT ( map -- n ) */
+static void p_hmap_count(vm_t *vm) {
+    hmap_t *h = hmap_get(vm, pop(vm), "HMAP-COUNT");
+    if (h) push(vm, h->count);
+}
+
+/* HMAP-EACH ( xt map -- ) In slot order */
+static void p_hmap_each(vm_t *vm) {
+    cell_t m = pop(vm);
+    int xt = (int)pop(vm);
+    hmap_t *h = hmap_get(vm, m, "HMAP-EACH");
+    if (!h) return;
+    if (xt < 0 || xt >= vm->dict_count) {
+        vm_abort(vm, "HMAP-EACH: invalid xt");
+        return;
+    }
+    cell_t slots = h->slots;
+    unsigned aborts = vm->aborts;
+    for (cell_t i = 0; i < h->cap; i++) {
+        slot_t s = *slot_at(vm, h, i);
+        if (!LIVE(&s)) continue;
+        push(vm, s.key);
+        push(vm, s.len);
+        push(vm, s.value);
+        vm_execute(vm, xt);
+        if (vm->aborts != aborts || !vm->running) return;
+        /* xt may have changed the map */
+        h = (hmap_t *)(vm->mem + m);
+        if (h->magic != HMAP_MAGIC || h->slots != slots) {
+            vm_abort(vm, "HMAP-EACH: map grew during iteration");
+            return;
+        }
+    }
+}
+
+void hmap_init(vm_t *vm) {
+    vm_add_prim(vm, "hmap-new",   p_hmap_new,      false);
+    vm_add_prim(vm, "hmap-put",   p_hmap_put,      false);
+    vm_add_prim(vm, "hmap-get",   p_hmap_get,      false);
+    vm_add_prim(vm, "hmap-del",   p_hmap_del,      false);
+    vm_add_prim(vm, "hmap-put#",  p_hmap_put_cell, false);
+    vm_add_prim(vm, "hmap-get#",  p_hmap_get_cell, false);
+    vm_add_prim(vm, "hmap-del#",  p_hmap_del_cell, false);
+    vm_add_prim(vm, "hmap-count", p_hmap_count,    false);
+    vm_add_prim(vm, "hmap-each",  p_hmap_each,     false);
+}
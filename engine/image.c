@@ -0,0 +1,276 @@
+/* image.c - Precompiled image snapshots
+ *
+ * fifth --save-image out.img   dump the VM after boot and any files
+ * fifth --image out.img        start from that state, no parsing
+ *
+ * An image holds the dictionary, mem[0..here), latest, the cached XTs,
+ * the require list and the used part of string space (arena.c), which
+ * goes back at the same address. Code fields are C pointers and differ between
+ * runs, so each entry's code is saved as a reference to the primitive
+ * registration it came from and relocated by name on load. mem[] holds
+ * only byte offsets (and, in the direct-threaded build, dict offsets),
+ * so it is mapped straight back in, copy-on-write.
+ *
+ * Layout (native byte order; images are tied to one build):
+ *   image_header_t
+ *   int32_t code_ref[dict_count]      handler tag or registration XT
+ *   dict_entry_t dict[dict_count]     code fields zeroed
+ *   dict_head_t heads[dict_count]
+ *   loaded_files, NUL-terminated
+ *   mem[0..here)                      at a MEM_ALIGN file offset
+ *   string space, used part           at the next MEM_ALIGN offset
+ */
+
+#include "fifth.h"
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define IMAGE_MAGIC    "FIFTHIMG"
+#define IMAGE_VERSION  3
+#define MEM_ALIGN      65536         /* Covers 4K and 16K page sizes */
+
+/* code_ref values below zero name the word handlers */
+#define REF_DOCOL   -1
+#define REF_DOVAR   -2
+#define REF_DOCON   -3
+#define REF_DODOES  -4
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t cell_size;
+    uint32_t entry_size;             /* dict_entry_t plus dict_head_t */
+    uint32_t direct;                 /* Built with FIFTH_DIRECT_THREADED */
+    int32_t  dict_count;
+    int32_t  latest;
+    int64_t  here;
+    int64_t  base;
+    int32_t  xt[10];                 /* xt_lit .. xt_does */
+    int32_t  loaded_count;
+    uint32_t loaded_bytes;
+    uint64_t mem_offset;
+    int64_t  strings;                /* String space address, 0 = none */
+    uint64_t strings_used;
+    uint64_t strings_offset;
+} image_header_t;
+
+#ifdef FIFTH_DIRECT_THREADED
+#define IMAGE_DIRECT 1
+#else
+#define IMAGE_DIRECT 0
+#endif
+
+static int32_t code_ref(vm_t *vm, int i) {
+    prim_fn code = vm->dict[i].code;
+    if (code == docol || vm_jit_owns(code)) return REF_DOCOL;
+    if (code == dovar)  return REF_DOVAR;
+    if (code == docon)  return REF_DOCON;
+    if (code == dodoes) return REF_DODOES;
+    /* First entry with this code is the primitive's registration */
+    for (int j = 0; j <= i; j++)
+        if (vm->dict[j].code == code) return j;
+    return i;
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void xts_get(vm_t *vm, int32_t *xt) {
+    xt[0] = vm->xt_lit;  xt[1] = vm->xt_branch; xt[2] = vm->xt_0branch;
+    xt[3] = vm->xt_exit; xt[4] = vm->xt_slit;   xt[5] = vm->xt_do;
+    xt[6] = vm->xt_qdo;  xt[7] = vm->xt_loop;   xt[8] = vm->xt_ploop;
+    xt[9] = vm->xt_does;
+}
+
+static void xts_set(vm_t *vm, const int32_t *xt) {
+    vm->xt_lit  = xt[0]; vm->xt_branch = xt[1]; vm->xt_0branch = xt[2];
+    vm->xt_exit = xt[3]; vm->xt_slit   = xt[4]; vm->xt_do      = xt[5];
+    vm->xt_qdo  = xt[6]; vm->xt_loop   = xt[7]; vm->xt_ploop   = xt[8];
+    vm->xt_does = xt[9];
+}
+
+int vm_save_image(vm_t *vm, const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create image: %s\n", path);
+        return -1;
+    }
+
+    image_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IMAGE_MAGIC, 8);
+    h.version = IMAGE_VERSION;
+    h.cell_size = sizeof(cell_t);
+    h.entry_size = sizeof(dict_entry_t) + sizeof(dict_head_t);
+    h.direct = IMAGE_DIRECT;
+    h.dict_count = vm->dict_count;
+    h.latest = vm->latest;
+    h.here = vm->here;
+    h.base = vm->base;
+    xts_get(vm, h.xt);
+    h.loaded_count = vm->loaded_count;
+    for (int i = 0; i < vm->loaded_count; i++)
+        h.loaded_bytes += strlen(vm->loaded_files[i]) + 1;
+
+    size_t meta = sizeof(h) + (size_t)vm->dict_count * (sizeof(int32_t) + h.entry_size)
+                + h.loaded_bytes;
+    h.mem_offset = (meta + MEM_ALIGN - 1) & ~(uint64_t)(MEM_ALIGN - 1);
+    h.strings = vm->strings;
+    h.strings_used = vm->strings ? vm_arena_used(vm, vm->strings) : 0;
+    h.strings_offset = (h.mem_offset + (uint64_t)vm->here + MEM_ALIGN - 1) & ~(uint64_t)(MEM_ALIGN - 1);
+
+    int32_t *refs = malloc((size_t)vm->dict_count * sizeof(int32_t) + 1);
+    dict_entry_t *ents = malloc((size_t)vm->dict_count * sizeof(dict_entry_t) + 1);
+    bool ok = refs && ents;
+    if (ok) {
+        for (int i = 0; i < vm->dict_count; i++) {
+            refs[i] = code_ref(vm, i);
+            ents[i] = vm->dict[i];
+            ents[i].code = NULL;
+            ents[i].hits = 0;
+        }
+        ok = write_all(fd, &h, sizeof(h))
+          && write_all(fd, refs, (size_t)vm->dict_count * sizeof(int32_t))
+          && write_all(fd, ents, (size_t)vm->dict_count * sizeof(dict_entry_t))
+          && write_all(fd, vm->heads, (size_t)vm->dict_count * sizeof(dict_head_t));
+        for (int i = 0; ok && i < vm->loaded_count; i++)
+            ok = write_all(fd, vm->loaded_files[i], strlen(vm->loaded_files[i]) + 1);
+        ok = ok && lseek(fd, (off_t)h.mem_offset, SEEK_SET) >= 0
+                && write_all(fd, vm->mem, (size_t)vm->here);
+        ok = ok && (!h.strings_used ||
+                    (lseek(fd, (off_t)h.strings_offset, SEEK_SET) >= 0 &&
+                     write_all(fd, vm->mem + vm->strings, (size_t)h.strings_used)));
+    }
+    free(refs);
+    free(ents);
+    close(fd);
+
+    if (!ok) {
+        fprintf(stderr, "Cannot write image: %s\n", path);
+        unlink(path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Code pointer of the primitive registered under name in a fresh VM */
+static prim_fn prim_by_name(vm_t *vm, int fresh_count, const char *name) {
+    int len = strlen(name);
+    for (int i = 0; i < fresh_count; i++) {
+        if ((vm->heads[i].flags & F_LENMASK) == len &&
+            strncasecmp(vm->heads[i].name, name, len) == 0)
+            return vm->dict[i].code;
+    }
+    return NULL;
+}
+
+/* Replace the state of a freshly created VM (primitives registered, no
+ * boot file loaded) with the image at path. */
+int vm_load_image(vm_t *vm, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open image: %s\n", path);
+        return -1;
+    }
+
+    image_header_t h;
+    const char *err = NULL;
+    if (read(fd, &h, sizeof(h)) != (ssize_t)sizeof(h) || memcmp(h.magic, IMAGE_MAGIC, 8) != 0)
+        err = "not a Fifth image";
+    else if (h.version != IMAGE_VERSION || h.cell_size != sizeof(cell_t) ||
+             h.entry_size != sizeof(dict_entry_t) + sizeof(dict_head_t) || h.direct != IMAGE_DIRECT)
+        err = "built by a different engine configuration";
+    else if (h.dict_count < 0 || h.here < 0 || h.loaded_count > 256 || h.strings < 0 ||
+             h.strings_used > STRINGS_SIZE + 3 * sizeof(cell_t))
+        err = "corrupt header";
+    else if (h.dict_count > vm_dict_size || !vm_mem_writable(vm, (cell_t)h.here))
+        err = "larger than --dict / --mem";
+    if (err) {
+        fprintf(stderr, "Cannot load image %s: %s\n", path, err);
+        close(fd);
+        return -1;
+    }
+
+    size_t n = (size_t)h.dict_count;
+    int32_t *refs = malloc(n * sizeof(int32_t) + 1);
+    dict_entry_t *ents = malloc(n * sizeof(dict_entry_t) + 1);
+    dict_head_t *heads = malloc(n * sizeof(dict_head_t) + 1);
+    char *names = malloc(h.loaded_bytes + 1);
+    if (!refs || !ents || !heads || !names ||
+        read(fd, refs, n * sizeof(int32_t)) != (ssize_t)(n * sizeof(int32_t)) ||
+        read(fd, ents, n * sizeof(dict_entry_t)) != (ssize_t)(n * sizeof(dict_entry_t)) ||
+        read(fd, heads, n * sizeof(dict_head_t)) != (ssize_t)(n * sizeof(dict_head_t)) ||
+        read(fd, names, h.loaded_bytes) != (ssize_t)h.loaded_bytes)
+        err = "truncated";
+
+    /* Relocate code fields against this binary's primitives */
+    for (size_t i = 0; !err && i < n; i++) {
+        switch (refs[i]) {
+            case REF_DOCOL:  ents[i].code = docol;  break;
+            case REF_DOVAR:  ents[i].code = dovar;  break;
+            case REF_DOCON:  ents[i].code = docon;  break;
+            case REF_DODOES: ents[i].code = dodoes; break;
+            default:
+                if (refs[i] < 0 || (size_t)refs[i] > i) { err = "corrupt code field"; break; }
+                ents[i].code = prim_by_name(vm, vm->dict_count, heads[refs[i]].name);
+                if (!ents[i].code) {
+                    fprintf(stderr, "Image needs primitive: %s\n", heads[refs[i]].name);
+                    err = "unknown primitive";
+                }
+        }
+    }
+
+    /* Map data space copy-on-write over the VM's own mapping */
+    if (!err && h.here > 0) {
+        void *m = mmap(vm->mem, (size_t)h.here, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_FIXED, fd, (off_t)h.mem_offset);
+        if (m == MAP_FAILED) err = "cannot map data space";
+    }
+
+    /* String space goes back where the saved addresses expect it */
+    if (!err && h.strings_used) {
+        if (vm_strings_place(vm, (cell_t)h.strings) != 0)
+            err = "string space address taken (different --mem?)";
+        else if (pread(fd, vm->mem + h.strings, h.strings_used, (off_t)h.strings_offset)
+                     != (ssize_t)h.strings_used ||
+                 vm_arena_used(vm, (cell_t)h.strings) != h.strings_used)
+            err = "truncated";
+    }
+
+    if (!err) {
+        memcpy(vm->dict, ents, n * sizeof(dict_entry_t));
+        memcpy(vm->heads, heads, n * sizeof(dict_head_t));
+        vm->dict_count = h.dict_count;
+        vm->latest = h.latest;
+        vm->here = h.here;
+        vm->base = h.base;
+        xts_set(vm, h.xt);
+        vm_hash_rebuild(vm);
+        fusions_init(vm);
+
+        const char *p = names;
+        for (int i = 0; i < h.loaded_count && p < names + h.loaded_bytes; i++) {
+            vm->loaded_files[vm->loaded_count++] = strdup(p);
+            p += strlen(p) + 1;
+        }
+    } else {
+        fprintf(stderr, "Cannot load image %s: %s\n", path, err);
+    }
+
+    free(refs);
+    free(ents);
+    free(heads);
+    free(names);
+    close(fd);
+    return err ? -1 : 0;
+}
@@ -7,6 +7,14 @@
 #include "fifth.h"
 #include <limits.h>
 #include <libgen.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef __APPLE__
@@ -14,29 +22,173 @@
 #include <CoreServices/CoreServices.h>
 #endif
 
+/* ============================================================
+ * Output Buffer
+ *
+ * Console output (TYPE, EMIT, ., and WRITE-FILE to STDOUT) collects in
+ * vm->obuf and reaches vm->out in large writes instead of one stdio
+ * call per word. A string that does not fit in what is left goes out
+ * in the same writev(2) as the buffered bytes, without being copied.
+ * On a terminal the buffer is flushed at each newline; it is also
+ * flushed before reading input, before SYSTEM, and when the VM ends.
+ *
+ * CAPTURE-BEGIN switches to a growable memory buffer, so output can be
+ * collected as a string without a temporary file.
+ * ============================================================ */
+
+static void write_iov(int fd, struct iovec *iov, int n) {
+    while (n > 0) {
+        ssize_t w = writev(fd, iov, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        while (n > 0 && (size_t)w >= iov->iov_len) {
+            w -= (ssize_t)iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (char *)iov->iov_base + w;
+            iov->iov_len -= (size_t)w;
+        }
+    }
+}
+
+/* Send the buffered bytes, then p[0..n), to the sink in one call */
+static void out_send(vm_t *vm, const void *p, size_t n) {
+    vm_obuf_t *o = &vm->obuf;
+    struct iovec iov[2] = { { o->buf, o->len }, { (void *)p, n } };
+    fflush(vm->out);                 /* Whatever stdio holds goes first */
+    if (o->len) write_iov(fileno(vm->out), iov, n ? 2 : 1);
+    else write_iov(fileno(vm->out), iov + 1, 1);
+    o->len = 0;
+}
+
+void vm_write(vm_t *vm, const void *p, size_t n) {
+    vm_obuf_t *o = &vm->obuf;
+    if (o->len + n > o->cap) {
+        if (!o->memory) {
+            out_send(vm, p, n);
+            return;
+        }
+        size_t cap = o->cap ? o->cap * 2 : 4096;
+        while (cap < o->len + n) cap *= 2;
+        char *buf = realloc(o->buf, cap);
+        if (!buf) {
+            vm_abort(vm, "CAPTURE: out of memory");
+            return;
+        }
+        o->buf = buf;
+        o->cap = cap;
+    }
+    if (!o->buf && !(o->buf = malloc(o->cap))) {
+        o->cap = 0;                  /* No memory for a buffer: unbuffered */
+        out_send(vm, p, n);
+        return;
+    }
+    memcpy(o->buf + o->len, p, n);
+    o->len += n;
+    if (o->line && memchr(p, '\n', n)) vm_flush(vm);
+}
+
+void vm_emit(vm_t *vm, int c) {
+    char ch = (char)c;
+    vm_write(vm, &ch, 1);
+}
+
+void vm_flush(vm_t *vm) {
+    if (!vm->obuf.memory && vm->obuf.len) out_send(vm, NULL, 0);
+}
+
+void vm_out_reset(vm_t *vm) {
+    while (vm->capture_depth > 0) {
+        free(vm->obuf.buf);
+        vm->obuf = vm->captures[--vm->capture_depth];
+    }
+    vm_flush(vm);
+}
+
+void vm_out_release(vm_t *vm) {
+    vm_out_reset(vm);
+    free(vm->obuf.buf);
+    vm->obuf.buf = NULL;
+}
+
+/* FLUSH ( -- ) Send buffered output now */
+static void p_flush(vm_t *vm) {
+    vm_flush(vm);
+}
+
+/* OUTPUT-BUFFER ( u -- ) Set the output buffer size; 0 = unbuffered */
+static void p_output_buffer(vm_t *vm) {
+    cell_t size = pop(vm);
+    if (vm->obuf.memory) {
+        vm_abort(vm, "OUTPUT-BUFFER: capturing");
+        return;
+    }
+    vm_flush(vm);
+    free(vm->obuf.buf);
+    vm->obuf.buf = NULL;
+    vm->obuf.cap = size > 0 ? (size_t)size : 0;
+}
+
+/* CAPTURE-BEGIN ( -- ) Collect output in memory until CAPTURE-END */
+static void p_capture_begin(vm_t *vm) {
+    if (vm->capture_depth == MAX_CAPTURES) {
+        vm_abort(vm, "CAPTURE-BEGIN: nested too deeply");
+        return;
+    }
+    vm->captures[vm->capture_depth++] = vm->obuf;
+    vm->obuf = (vm_obuf_t){ .memory = true };
+}
+
+/* CAPTURE-END ( -- addr u ) Stop capturing. The text is copied
+ * PAD_SIZE above HERE, clear of a buffer being built at HERE, and is
+ * temporary like SLURP-FILE's copy. */
+static void p_capture_end(vm_t *vm) {
+    if (vm->capture_depth == 0) {
+        vm_abort(vm, "CAPTURE-END: not capturing");
+        return;
+    }
+    vm_obuf_t cap = vm->obuf;
+    vm->obuf = vm->captures[--vm->capture_depth];
+    cell_t at = vm->here + PAD_SIZE;
+    bool fits = vm_mem_writable(vm, at + (cell_t)cap.len);
+    if (fits && cap.len) memcpy(vm->mem + at, cap.buf, cap.len);
+    free(cap.buf);
+    if (!fits) {
+        vm_abort(vm, "CAPTURE-END: data space full");
+        return;
+    }
+    push(vm, at);
+    push(vm, (cell_t)cap.len);
+}
+
 /* ============================================================
  * Console I/O
  * ============================================================ */
 
 /* EMIT ( c -- ) Output a character */
 static void p_emit(vm_t *vm) {
-    fputc((int)pop(vm), vm->out);
+    vm_emit(vm, (int)pop(vm));
 }
 
 /* TYPE ( addr u -- ) Output a string */
 static void p_type(vm_t *vm) {
     cell_t len = pop(vm);
     cell_t addr = pop(vm);
-    fwrite(vm->mem + addr, 1, len, vm->out);
+    if (len > 0) vm_write(vm, vm->mem + addr, (size_t)len);
 }
 
 /* CR ( -- ) Output newline */
 static void p_cr(vm_t *vm) {
-    fputc('\n', vm->out);
+    vm_emit(vm, '\n');
 }
 
 /* KEY ( -- c ) Read a character from stdin */
 static void p_key(vm_t *vm) {
+    vm_flush(vm);
     push(vm, fgetc(stdin));
 }
 
@@ -45,6 +197,7 @@ static void p_accept(vm_t *vm) {
     cell_t maxlen = pop(vm);
     cell_t addr = pop(vm);
     char *buf = (char *)(vm->mem + addr);
+    vm_flush(vm);
     if (fgets(buf, (int)maxlen, stdin)) {
         int len = strlen(buf);
         while (len > 0 && (buf[len-1] == '\n' || buf[len-1] == '\r'))
@@ -62,6 +215,8 @@ static void p_accept(vm_t *vm) {
  * Forth file operations return ( ior ) where 0 = success.
  * ============================================================ */
 
+#define FID_STDOUT  -2               /* What STDOUT pushes */
+
 /* Find a free file slot */
 static int file_alloc(vm_t *vm) {
     for (int i = 0; i < MAX_FILES; i++) {
@@ -79,7 +234,7 @@ static void forth_to_cstr(vm_t *vm, cell_t addr, cell_t len, char *out, int max)
 }
 
 /* Expand ~ in paths */
-static void expand_path(const char *in, char *out, int max) {
+void vm_expand_path(const char *in, char *out, int max) {
     if (in[0] == '~' && (in[1] == '/' || in[1] == '\0')) {
         const char *home = getenv("HOME");
         if (home) {
@@ -99,7 +254,7 @@ static void p_open_file(vm_t *vm) {
 
     char path_raw[PATH_MAX], path[PATH_MAX];
     forth_to_cstr(vm, addr, len, path_raw, sizeof(path_raw));
-    expand_path(path_raw, path, sizeof(path));
+    vm_expand_path(path_raw, path, sizeof(path));
 
     const char *fmode;
     switch (mode) {
@@ -136,7 +291,7 @@ static void p_create_file(vm_t *vm) {
 
     char path_raw[PATH_MAX], path[PATH_MAX];
     forth_to_cstr(vm, addr, len, path_raw, sizeof(path_raw));
-    expand_path(path_raw, path, sizeof(path));
+    vm_expand_path(path_raw, path, sizeof(path));
 
     int slot = file_alloc(vm);
     if (slot < 0) {
@@ -168,19 +323,85 @@ static void p_close_file(vm_t *vm) {
     }
 }
 
-/* WRITE-FILE ( addr u fid -- ior ) */
+/* Whether I/O on f should wait in the event loop (fiber.c) instead of
+ * blocking the thread: only with fibers running, and never for regular
+ * files, which are always ready */
+static bool fid_waits(vm_t *vm, FILE *f) {
+    struct stat st;
+    return vm->fibers && fstat(fileno(f), &st) == 0 && !S_ISREG(st.st_mode);
+}
+
+/* Write all of p to fd, letting other fibers run while it is full */
+static bool fd_write_waiting(vm_t *vm, int fd, const void *p, cell_t len) {
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    const char *c = p;
+    bool ok = true;
+    while (len > 0) {
+        ssize_t n = write(fd, c, (size_t)len);
+        if (n >= 0) {
+            c += n;
+            len -= n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            vm_fiber_wait_fd(vm, fd, true);
+        } else if (errno != EINTR) {
+            ok = false;
+            break;
+        }
+    }
+    fcntl(fd, F_SETFL, flags);
+    return ok;
+}
+
+/* WRITE-FILE ( addr u fid -- ior ) STDOUT goes through the output buffer */
 static void p_write_file(vm_t *vm) {
     cell_t fid = pop(vm);
     cell_t len = pop(vm);
     cell_t addr = pop(vm);
-    if (fid >= 0 && fid < MAX_FILES && vm->files[fid]) {
-        size_t written = fwrite(vm->mem + addr, 1, len, vm->files[fid]);
+    if (fid == FID_STDOUT) {
+        if (len > 0) vm_write(vm, vm->mem + addr, (size_t)len);
+        push(vm, 0);
+    } else if (fid >= 0 && fid < MAX_FILES && vm->files[fid]) {
+        FILE *f = vm->files[fid];
+        if (fid_waits(vm, f)) {
+            fflush(f);
+            push(vm, fd_write_waiting(vm, fileno(f), vm->mem + addr, len) ? 0 : -1);
+            return;
+        }
+        size_t written = fwrite(vm->mem + addr, 1, len, f);
         push(vm, (written == (size_t)len) ? 0 : -1);
     } else {
         push(vm, -1);
     }
 }
 
+/* READ-FILE ( addr u fid -- u2 ior ) Up to u bytes; u2 = 0 at end of
+ * file. A pipe or terminal read under fibers returns what has arrived,
+ * and bypasses the FILE buffer, so do not mix it with READ-LINE there. */
+static void p_read_file(vm_t *vm) {
+    cell_t fid = pop(vm);
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    if (fid < 0 || fid >= MAX_FILES || !vm->files[fid] || len < 0 ||
+        !vm_range_writable(vm, addr, len)) {
+        push(vm, 0);
+        push(vm, -1);
+        return;
+    }
+    FILE *f = vm->files[fid];
+    if (fid_waits(vm, f)) {
+        ssize_t n;
+        vm_fiber_wait_fd(vm, fileno(f), false);
+        while ((n = read(fileno(f), vm->mem + addr, (size_t)len)) < 0 && errno == EINTR) {}
+        push(vm, n < 0 ? 0 : (cell_t)n);
+        push(vm, n < 0 ? -1 : 0);
+        return;
+    }
+    size_t n = fread(vm->mem + addr, 1, (size_t)len, f);
+    push(vm, (cell_t)n);
+    push(vm, ferror(f) ? -1 : 0);
+}
+
 /* READ-LINE ( addr u fid -- u2 flag ior ) */
 static void p_read_line(vm_t *vm) {
     cell_t fid = pop(vm);
@@ -211,7 +432,10 @@ static void p_read_line(vm_t *vm) {
 static void p_emit_file(vm_t *vm) {
     cell_t fid = pop(vm);
     cell_t c = pop(vm);
-    if (fid >= 0 && fid < MAX_FILES && vm->files[fid]) {
+    if (fid == FID_STDOUT) {
+        vm_emit(vm, (int)c);
+        push(vm, 0);
+    } else if (fid >= 0 && fid < MAX_FILES && vm->files[fid]) {
         fputc((int)c, vm->files[fid]);
         push(vm, 0);
     } else {
@@ -222,7 +446,10 @@ static void p_emit_file(vm_t *vm) {
 /* FLUSH-FILE ( fid -- ior ) */
 static void p_flush_file(vm_t *vm) {
     cell_t fid = pop(vm);
-    if (fid >= 0 && fid < MAX_FILES && vm->files[fid]) {
+    if (fid == FID_STDOUT) {
+        vm_flush(vm);
+        push(vm, 0);
+    } else if (fid >= 0 && fid < MAX_FILES && vm->files[fid]) {
         fflush(vm->files[fid]);
         push(vm, 0);
     } else {
@@ -246,8 +473,116 @@ static void p_throw(vm_t *vm) {
 }
 
 /* STDOUT ( -- fid ) Push stdout file handle.
- * We use a special sentinel (-1) that output words recognize. */
-static void p_stdout(vm_t *vm) { push(vm, -2); /* special: stdout */ }
+ * A sentinel that WRITE-FILE, EMIT-FILE and FLUSH-FILE recognize. */
+static void p_stdout(vm_t *vm) { push(vm, FID_STDOUT); }
+
+/* ============================================================
+ * HTML Escaping
+ *
+ * lib/html.fs escaped a character at a time into the 4 KB str2 buffer,
+ * truncating longer text. These scan for the five special bytes with
+ * vm_byteset_scan and pass clean runs through whole, with no length
+ * limit.
+ * ============================================================ */
+
+static const vm_byteset_t html_special = {
+    .in = { ['<'] = 1, ['>'] = 1, ['&'] = 1, ['\''] = 1, ['"'] = 1 },
+    .bytes = (const uint8_t *)"<>&'\"",
+    .n = 5,
+};
+
+#define HTML_GROWTH 6                /* Worst case: every byte becomes &quot; */
+
+static const char *html_entity(uint8_t c, size_t *len) {
+    switch (c) {
+    case '<':  *len = 4; return "&lt;";
+    case '>':  *len = 4; return "&gt;";
+    case '&':  *len = 5; return "&amp;";
+    case '\'': *len = 5; return "&#39;";
+    default:   *len = 6; return "&quot;";
+    }
+}
+
+/* Escape p[0..n) into dst, which has room for HTML_GROWTH * n; returns
+ * the length written */
+static size_t html_escape_into(uint8_t *dst, const uint8_t *p, size_t n) {
+    uint8_t *d = dst;
+    while (n) {
+        size_t run = vm_byteset_scan(&html_special, p, n);
+        memcpy(d, p, run);
+        d += run; p += run; n -= run;
+        if (!n) break;
+        size_t elen;
+        const char *e = html_entity(*p++, &elen);
+        memcpy(d, e, elen);
+        d += elen; n--;
+    }
+    return (size_t)(d - dst);
+}
+
+/* HTML-ESCAPE ( addr u -- addr' u' ) Result is temporary, above HERE
+ * and past the source */
+static void p_html_escape(vm_t *vm) {
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    cell_t at = vm->here + PAD_SIZE;
+    if (addr + len > at && addr < (cell_t)vm_mem_size) at = vm_align(addr + len);
+    if (len <= 0) {
+        push(vm, at);
+        push(vm, 0);
+        return;
+    }
+    if (!vm_mem_writable(vm, at + HTML_GROWTH * len)) {
+        vm_abort(vm, "HTML-ESCAPE: data space full");
+        return;
+    }
+    size_t n = html_escape_into(vm->mem + at, vm->mem + addr, (size_t)len);
+    push(vm, at);
+    push(vm, (cell_t)n);
+}
+
+/* HTML-ESCAPE-TO ( addr u dest -- u' ) Into the caller's region, which
+ * needs room for 6*u bytes */
+static void p_html_escape_to(vm_t *vm) {
+    cell_t dest = pop(vm);
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    push(vm, len > 0 ? (cell_t)html_escape_into(vm->mem + dest, vm->mem + addr, (size_t)len) : 0);
+}
+
+/* HTML-ESCAPE-FILE ( addr u fid -- ior ) Straight to a file, or into the
+ * output buffer for stdout */
+static void p_html_escape_file(vm_t *vm) {
+    cell_t fid = pop(vm);
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    FILE *f = NULL;
+    if (fid != FID_STDOUT) {
+        if (fid < 0 || fid >= MAX_FILES || !vm->files[fid]) {
+            push(vm, -1);
+            return;
+        }
+        f = vm->files[fid];
+    }
+    const uint8_t *p = vm->mem + addr;
+    size_t n = len > 0 ? (size_t)len : 0;
+    bool ok = true;
+    while (n) {
+        size_t run = vm_byteset_scan(&html_special, p, n);
+        size_t elen = 0;
+        const char *e = run < n ? html_entity(p[run], &elen) : NULL;
+        if (f) {
+            ok &= fwrite(p, 1, run, f) == run;
+            if (e) ok &= fwrite(e, 1, elen, f) == elen;
+        } else {
+            vm_write(vm, p, run);
+            if (e) vm_write(vm, e, elen);
+        }
+        run += (e != NULL);
+        p += run; n -= run;
+    }
+    push(vm, ok ? 0 : -1);
+}
 
 /* ============================================================
  * System
@@ -261,9 +596,244 @@ static void p_system(vm_t *vm) {
     int n = (len >= (cell_t)sizeof(cmd)) ? (int)sizeof(cmd) - 1 : (int)len;
     memcpy(cmd, vm->mem + addr, n);
     cmd[n] = '\0';
+    vm_flush(vm);
     system(cmd);
 }
 
+/* The commands RUN-CAPTURE, RUN-ARGV and RUN-LINES start go straight
+ * to posix_spawnp, with no shell: stdout comes back through a pipe,
+ * stdin and stderr are the VM's own. Under fibers the read waits in the
+ * event loop (fiber.c). */
+extern char **environ;
+
+#define MAX_RUN_ARGS 256
+
+typedef struct {
+    pid_t  pid;
+    int    fd;                       /* Read end of the child's stdout */
+} run_t;
+
+/* Start argv[0] (searched in PATH); false if it could not be */
+static bool run_start(vm_t *vm, char **argv, run_t *r) {
+    int p[2];
+    if (pipe(p) != 0) return false;
+    fcntl(p[0], F_SETFD, FD_CLOEXEC);
+    fcntl(p[1], F_SETFD, FD_CLOEXEC);  /* The dup2 to 1 drops it */
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, p[1], 1);
+    vm_flush(vm);
+    fflush(stdout);
+    int err = posix_spawnp(&r->pid, argv[0], &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    close(p[1]);
+    if (err != 0) {
+        close(p[0]);
+        return false;
+    }
+    if (vm->fibers) fcntl(p[0], F_SETFL, fcntl(p[0], F_GETFL) | O_NONBLOCK);
+    r->fd = p[0];
+    return true;
+}
+
+/* Up to n bytes of the child's output; 0 at end, -1 on error */
+static ssize_t run_read(vm_t *vm, run_t *r, char *buf, size_t n) {
+    for (;;) {
+        ssize_t got = read(r->fd, buf, n);
+        if (got >= 0) return got;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) vm_fiber_wait_fd(vm, r->fd, false);
+        else if (errno != EINTR) return -1;
+    }
+}
+
+/* Close the pipe and reap the child: its exit status, 128 + signal if
+ * it was killed */
+static cell_t run_finish(run_t *r, bool kill_it) {
+    close(r->fd);
+    if (kill_it) kill(r->pid, SIGTERM);
+    int st;
+    task_blocking();
+    while (waitpid(r->pid, &st, 0) < 0)
+        if (errno != EINTR) return -1;
+    return WIFEXITED(st) ? WEXITSTATUS(st) : 128 + WTERMSIG(st);
+}
+
+/* Run argv with its output into the scratch arena: ( -- addr u status ).
+ * The previous output goes back first if nothing was allocated after
+ * it, so a loop of commands does not fill the arena. */
+static void run_capture(vm_t *vm, char **argv) {
+    run_t r;
+    if (!run_start(vm, argv, &r)) {
+        push(vm, 0);
+        push(vm, 0);
+        push(vm, -1);
+        return;
+    }
+    size_t cap = 65536, len = 0;
+    char *buf = malloc(cap);
+    ssize_t n = 1;
+    while (buf && n > 0) {
+        if (len == cap) {
+            char *b = realloc(buf, cap * 2);
+            if (!b) break;
+            buf = b;
+            cap *= 2;
+        }
+        n = run_read(vm, &r, buf + len, cap - len);
+        if (n > 0) len += (size_t)n;
+    }
+    cell_t status = run_finish(&r, n != 0);
+    if (vm->run_out) vm_scratch_trim(vm, vm->run_out, (size_t)vm->run_len);
+    cell_t dest = buf && len ? vm_scratch_alloc(vm, len) : 0;
+    if (dest > 0) memcpy(vm->mem + dest, buf, len);
+    free(buf);
+    if (dest < 0) return;
+    vm->run_out = dest;
+    vm->run_len = dest ? (cell_t)len : 0;
+    push(vm, dest);
+    push(vm, dest ? (cell_t)len : 0);
+    push(vm, status);
+}
+
+/* Split a command line into words, in place: blanks separate, '...'
+ * and "..." quote, \ escapes the next character outside '...'.
+ * Returns the word count. */
+static int split_command(char *s, char **argv, int max) {
+    int argc = 0;
+    char *out = s;
+    while (*s) {
+        while (*s == ' ' || *s == '\t' || *s == '\n') s++;
+        if (!*s) break;
+        if (argc == max - 1) break;
+        argv[argc++] = out;
+        char q = 0;
+        for (; *s && (q || (*s != ' ' && *s != '\t' && *s != '\n')); s++) {
+            if (q ? *s == q : (*s == '\'' || *s == '"')) q = q ? 0 : *s;
+            else if (*s == '\\' && q != '\'' && s[1]) *out++ = *++s;
+            else *out++ = *s;
+        }
+        if (*s) s++;
+        *out++ = '\0';
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+/* Copy addr u into a malloc'd command line and split it */
+static char *command_words(vm_t *vm, cell_t addr, cell_t len, char **argv) {
+    char *line = malloc((size_t)(len < 0 ? 0 : len) + 1);
+    if (!line) return NULL;
+    forth_to_cstr(vm, addr, len, line, (size_t)(len < 0 ? 0 : len) + 1);
+    if (split_command(line, argv, MAX_RUN_ARGS) == 0) {
+        free(line);
+        return NULL;
+    }
+    return line;
+}
+
+/* RUN-CAPTURE ( addr u -- addr2 u2 status ) Run a command line, no
+ * shell, and return its output (scratch arena) and exit status; -1 if
+ * it could not be started */
+static void p_run_capture(vm_t *vm) {
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    char *argv[MAX_RUN_ARGS];
+    char *line = command_words(vm, addr, len, argv);
+    if (!line) {
+        push(vm, 0);
+        push(vm, 0);
+        push(vm, -1);
+        return;
+    }
+    run_capture(vm, argv);
+    free(line);
+}
+
+/* RUN-ARGV ( addr1 u1 ... addrn un n -- addr2 u2 status ) The same with
+ * the argument strings given separately, taken as they are */
+static void p_run_argv(vm_t *vm) {
+    cell_t n = pop(vm);
+    if (n < 1 || n >= MAX_RUN_ARGS || depth(vm) < 2 * n) {
+        vm_abort(vm, "RUN-ARGV: bad argument count");
+        return;
+    }
+    char *argv[MAX_RUN_ARGS];
+    for (cell_t i = n - 1; i >= 0; i--) {
+        cell_t len = pop(vm);
+        cell_t addr = pop(vm);
+        size_t size = (size_t)(len < 0 ? 0 : len) + 1;
+        argv[i] = malloc(size);
+        if (argv[i]) forth_to_cstr(vm, addr, len, argv[i], size);
+    }
+    argv[n] = NULL;
+    bool ok = true;
+    for (cell_t i = 0; i < n; i++) ok = ok && argv[i];
+    if (ok) {
+        run_capture(vm, argv);
+    } else {
+        push(vm, 0);
+        push(vm, 0);
+        push(vm, -1);
+    }
+    for (cell_t i = 0; i < n; i++) free(argv[i]);
+}
+
+/* RUN-LINES ( addr u xt -- status ) Run a command line and call xt
+ * ( addr u -- ) on each line of its output as it arrives, without the
+ * newline. The line is good until xt returns. */
+static void p_run_lines(vm_t *vm) {
+    cell_t xt = pop(vm);
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    char *argv[MAX_RUN_ARGS];
+    if (xt < 0 || xt >= vm->dict_count) {
+        vm_abort(vm, "RUN-LINES: invalid xt");
+        return;
+    }
+    char *line = command_words(vm, addr, len, argv);
+    run_t r;
+    if (!line || !run_start(vm, argv, &r)) {
+        free(line);
+        push(vm, -1);
+        return;
+    }
+    free(line);
+
+    unsigned aborts = vm->aborts;
+    size_t cap = 65536, have = 0;
+    char *buf = malloc(cap);
+    ssize_t n = 1;
+    while (buf && vm->aborts == aborts) {
+        char *nl = have ? memchr(buf, '\n', have) : NULL;
+        if (!nl && n > 0) {
+            if (have == cap) {
+                char *b = realloc(buf, cap * 2);
+                if (!b) break;
+                buf = b;
+                cap *= 2;
+            }
+            n = run_read(vm, &r, buf + have, cap - have);
+            if (n > 0) have += (size_t)n;
+            continue;
+        }
+        if (!nl && have == 0) break;     /* End of output */
+        size_t ll = nl ? (size_t)(nl - buf) : have;  /* Last line may lack a newline */
+        cell_t at = vm_scratch_alloc(vm, ll);
+        if (at < 0) break;
+        memcpy(vm->mem + at, buf, ll);
+        size_t used = nl ? ll + 1 : ll;
+        memmove(buf, buf + used, have - used);
+        have -= used;
+        push(vm, at);
+        push(vm, (cell_t)ll);
+        vm_execute(vm, (int)xt);
+        vm_scratch_trim(vm, at, ll);
+    }
+    free(buf);
+    cell_t status = run_finish(&r, n != 0);
+    if (vm->aborts == aborts) push(vm, status);
+}
+
 /* OPEN-PATH ( addr u -- ) Open file/URL with native OS handler, no fork */
 static void p_open_path(vm_t *vm) {
     cell_t len = pop(vm);
@@ -313,26 +883,146 @@ static void p_bye(vm_t *vm) {
     vm->running = false;
 }
 
-/* GETENV ( addr u -- addr' u' ) Get environment variable, returns 0 0 if not found */
+/* GETENV ( addr u -- addr' u' ) Get environment variable, returns 0 0 if not found.
+ * Nothing here changes the environment, so each name is looked up
+ * once. The results are chained through string space (arena.c), each
+ * as: next, name length, value length (-1 = unset), name, value. */
 static void p_getenv(vm_t *vm) {
     cell_t len = pop(vm);
     cell_t addr = pop(vm);
     char name[256];
     forth_to_cstr(vm, addr, len, name, sizeof(name));
+    size_t nlen = strlen(name);
+
+    for (cell_t e = vm->env_seen; e; e = ((cell_t *)(vm->mem + e))[0]) {
+        cell_t *c = (cell_t *)(vm->mem + e);
+        if ((size_t)c[1] != nlen || memcmp(c + 3, name, nlen) != 0) continue;
+        push(vm, c[2] < 0 ? 0 : e + 3 * (cell_t)sizeof(cell_t) + (cell_t)nlen);
+        push(vm, c[2] < 0 ? 0 : c[2]);
+        return;
+    }
 
     const char *val = getenv(name);
-    if (val) {
-        size_t vlen = strlen(val);
-        /* Copy value to dictionary space */
-        cell_t dest = vm->here;
-        memcpy(vm->mem + dest, val, vlen);
-        vm->here += vlen;
-        push(vm, dest);
-        push(vm, (cell_t)vlen);
-    } else {
+    size_t vlen = val ? strlen(val) : 0;
+    cell_t e = vm_string_alloc(vm, 3 * sizeof(cell_t) + nlen + vlen);
+    if (e < 0) return;
+    cell_t *c = (cell_t *)(vm->mem + e);
+    c[0] = vm->env_seen;
+    c[1] = (cell_t)nlen;
+    c[2] = val ? (cell_t)vlen : -1;
+    memcpy(c + 3, name, nlen);
+    memcpy((uint8_t *)(c + 3) + nlen, val ? val : "", vlen);
+    vm->env_seen = e;
+    push(vm, val ? e + 3 * (cell_t)sizeof(cell_t) + (cell_t)nlen : 0);
+    push(vm, val ? (cell_t)vlen : 0);
+}
+
+/* ARGV ( u -- addr u ) Script argument u, 0 0 past the last. ARGC
+ * holds their count; argument 0 is the script. Each is copied into
+ * string space the first time, and arg_copies keeps its addr len. */
+static void p_argv(vm_t *vm) {
+    cell_t u = pop(vm);
+    if (u < 0 || u >= vm->arg_count) {
         push(vm, 0);
         push(vm, 0);
+        return;
+    }
+    if (!vm->arg_copies) {
+        cell_t t = vm_string_alloc(vm, 2 * sizeof(cell_t) * (size_t)vm->arg_count);
+        if (t < 0) return;
+        memset(vm->mem + t, 0, 2 * sizeof(cell_t) * (size_t)vm->arg_count);
+        vm->arg_copies = t;
+    }
+    cell_t *copy = (cell_t *)(vm->mem + vm->arg_copies) + 2 * u;
+    if (!copy[0]) {
+        size_t len = strlen(vm->args[u]);
+        cell_t dest = vm_string_alloc(vm, len);
+        if (dest < 0) return;
+        memcpy(vm->mem + dest, vm->args[u], len);
+        copy[0] = dest;
+        copy[1] = (cell_t)len;
+    }
+    push(vm, copy[0]);
+    push(vm, copy[1]);
+}
+
+void vm_set_args(vm_t *vm, int argc, char **argv) {
+    vm->args = argv;
+    vm->arg_count = argc;
+    vm->arg_copies = 0;
+    int xt = vm_find(vm, "argc", 4);
+    if (xt >= 0 && vm->dict[xt].code == dovar) mem_store(vm, vm->dict[xt].param, argc);
+}
+
+/* ============================================================
+ * Benchmarking
+ * ============================================================ */
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* UTIME ( -- ud ) Microseconds since the epoch, as in gforth */
+static void p_utime(vm_t *vm) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    push(vm, (cell_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+    push(vm, 0);
+}
+
+/* BENCH ( xt n -- ) Run xt n/10+1 times to warm up, then n times timed,
+ * and print {"status": ..., "min_ms": ..., "median_ms": ..., "p99_ms": ...}.
+ * Whatever xt leaves on the stack is dropped after each run. */
+static void p_bench(vm_t *vm) {
+    cell_t n = pop(vm);
+    cell_t xt = pop(vm);
+    if (xt < 0 || xt >= vm->dict_count || n <= 0) {
+        vm_abort(vm, "BENCH: bad xt or count");
+        return;
+    }
+    double *t = malloc((size_t)n * sizeof(double));
+    if (!t) {
+        vm_abort(vm, "BENCH: out of memory");
+        return;
+    }
+    cell_t *sp = vm->sp, *rsp = vm->rsp;
+    int input_depth = vm->input_depth;
+    bool ok = true;
+    cell_t done = 0;
+    for (cell_t i = -(n / 10 + 1); i < n && ok; i++) {
+        double t0 = now_ms();
+        vm_execute(vm, (int)xt);
+        double dt = now_ms() - t0;
+        ok = vm->running && vm->rsp == rsp && vm->input_depth == input_depth;
+        if (ok) vm->sp = sp;
+        if (ok && i >= 0) t[done++] = dt;
+    }
+
+    char buf[256];
+    int len;
+    if (!ok || done == 0) {
+        len = snprintf(buf, sizeof(buf), "{\"status\": \"error\", \"iterations\": %ld}",
+                       (long)done);
+    } else {
+        double sum = 0;
+        for (cell_t i = 0; i < done; i++) sum += t[i];
+        qsort(t, (size_t)done, sizeof(double), cmp_double);
+        double median = done % 2 ? t[done / 2] : (t[done / 2 - 1] + t[done / 2]) / 2;
+        cell_t p99 = (done * 99 + 99) / 100 - 1;
+        len = snprintf(buf, sizeof(buf),
+                       "{\"status\": \"success\", \"iterations\": %ld, \"min_ms\": %.4f, "
+                       "\"median_ms\": %.4f, \"p99_ms\": %.4f, \"avg_time_ms\": %.4f}",
+                       (long)done, t[0], median, t[p99], sum / (double)done);
     }
+    free(t);
+    vm_write(vm, buf, (size_t)len);
 }
 
 /* ============================================================
@@ -346,7 +1036,7 @@ static void p_include(vm_t *vm) {
     if (len == 0) { vm_abort(vm, "INCLUDE requires a filename"); return; }
 
     char path[PATH_MAX];
-    expand_path(name, path, sizeof(path));
+    vm_expand_path(name, path, sizeof(path));
     vm_load_file(vm, path);
 }
 
@@ -357,8 +1047,11 @@ static void p_require(vm_t *vm) {
     if (len == 0) { vm_abort(vm, "REQUIRE requires a filename"); return; }
 
     char path[PATH_MAX];
-    expand_path(name, path, sizeof(path));
+    vm_expand_path(name, path, sizeof(path));
+    if (vm_require_mark(vm, path)) vm_load_file(vm, path);
+}
 
+bool vm_require_mark(vm_t *vm, const char *path) {
     /* Resolve to absolute path for comparison */
     char resolved[PATH_MAX];
     if (realpath(path, resolved) == NULL) {
@@ -370,14 +1063,14 @@ static void p_require(vm_t *vm) {
     /* Check if already loaded */
     for (int i = 0; i < vm->loaded_count; i++) {
         if (strcmp(vm->loaded_files[i], resolved) == 0)
-            return; /* Already loaded */
+            return false;
     }
 
-    /* Record and load */
+    /* Record */
     if (vm->loaded_count < 256) {
         vm->loaded_files[vm->loaded_count++] = strdup(resolved);
     }
-    vm_load_file(vm, path);
+    return true;
 }
 
 /* INCLUDED ( addr u -- ) Load file by string on stack */
@@ -386,7 +1079,7 @@ static void p_included(vm_t *vm) {
     cell_t addr = pop(vm);
     char path_raw[PATH_MAX], path[PATH_MAX];
     forth_to_cstr(vm, addr, len, path_raw, sizeof(path_raw));
-    expand_path(path_raw, path, sizeof(path));
+    vm_expand_path(path_raw, path, sizeof(path));
     vm_load_file(vm, path);
 }
 
@@ -399,10 +1092,17 @@ static void p_backslash(vm_t *vm) {
     vm->tib_pos = vm->tib_len; /* skip to end */
 }
 
-/* ( ( -- ) Block comment: skip until ) (IMMEDIATE) */
+/* ( ( -- ) Block comment: skip until ), across lines in a file (IMMEDIATE) */
 static void p_paren(vm_t *vm) {
-    char buf[PAD_SIZE];
-    vm_parse(vm, ')', buf); /* discard */
+    do {
+        const char *rest = vm->tib + vm->tib_pos;
+        const char *end = memchr(rest, ')', (size_t)(vm->tib_len - vm->tib_pos));
+        if (end) {
+            vm->tib_pos = (int)(end - vm->tib) + 1;
+            return;
+        }
+        vm->tib_pos = vm->tib_len;
+    } while (vm_refill(vm));
 }
 
 /* ============================================================
@@ -425,37 +1125,75 @@ static void p_hex(vm_t *vm)     { vm->base = 16; }
  * Slurp (convenience for reading entire files)
  * ============================================================ */
 
-/* SLURP-FILE ( addr u -- addr2 u2 ) Read entire file into memory */
-static void p_slurp_file(vm_t *vm) {
+/* Open the file named by a Forth string; its size in *size, -1 if absent */
+static int open_sized(vm_t *vm, cell_t addr, cell_t len, off_t *size) {
+    char path_raw[PATH_MAX], path[PATH_MAX];
+    forth_to_cstr(vm, addr, len, path_raw, sizeof(path_raw));
+    vm_expand_path(path_raw, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd >= 0) *size = st.st_size;
+    return fd;
+}
+
+/* MAP-FILE ( addr u -- addr2 u2 ) Map a file above mem[], 0 0 on failure
+ * The view is private: writes to it never reach the file. */
+static void p_map_file(vm_t *vm) {
     cell_t len = pop(vm);
     cell_t addr = pop(vm);
+    off_t size = 0;
+    int fd = open_sized(vm, addr, len, &size);
+    cell_t at = -1;
+    if (fd >= 0 && size > 0) at = vm_map_view(vm, fd, (size_t)size);
+    else if (fd >= 0) close(fd);
+    push(vm, at < 0 ? 0 : at);
+    push(vm, at < 0 ? 0 : (cell_t)size);
+}
 
-    char path_raw[PATH_MAX], path[PATH_MAX];
-    forth_to_cstr(vm, addr, len, path_raw, sizeof(path_raw));
-    expand_path(path_raw, path, sizeof(path));
+/* UNMAP-FILE ( addr u -- ) Release a view made by MAP-FILE */
+static void p_unmap_file(vm_t *vm) {
+    pop(vm);
+    cell_t addr = pop(vm);
+    if (vm_unmap_view(vm, addr) != 0) vm_abort(vm, "UNMAP-FILE: not a mapped file");
+}
 
-    FILE *f = fopen(path, "r");
-    if (!f) {
+/* SLURP-FILE ( addr u -- addr2 u2 ) Read entire file into memory
+ * The copy at HERE is temporary (overwritten by the next slurp). A file
+ * too large for the space above HERE is mapped instead, replacing the
+ * previous such mapping. */
+static void p_slurp_file(vm_t *vm) {
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    off_t size = 0;
+    int fd = open_sized(vm, addr, len, &size);
+    if (fd < 0 || size <= 0) {
+        if (fd >= 0) close(fd);
         push(vm, 0);
         push(vm, 0);
         return;
     }
 
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    /* Store at HERE (temporary) */
     cell_t dest = vm->here;
-    if (size > 0 && dest + size < MEM_SIZE) {
-        size_t got = fread(vm->mem + dest, 1, size, f);
+    if (dest + size < (cell_t)vm_mem_size && vm_range_writable(vm, dest, size)) {
+        ssize_t got = 0, n;
+        while (got < size && (n = read(fd, vm->mem + dest + got, (size_t)(size - got))) > 0)
+            got += n;
+        close(fd);
         push(vm, dest);
         push(vm, (cell_t)got);
-    } else {
-        push(vm, 0);
-        push(vm, 0);
+        return;
     }
-    fclose(f);
+
+    if (vm->slurp_view) vm_unmap_view(vm, vm->slurp_view);
+    cell_t at = vm_map_view(vm, fd, (size_t)size);
+    vm->slurp_view = at < 0 ? 0 : at;
+    push(vm, at < 0 ? 0 : at);
+    push(vm, at < 0 ? 0 : (cell_t)size);
 }
 
 /* ============================================================
@@ -465,8 +1203,15 @@ static void p_slurp_file(vm_t *vm) {
 void io_init(vm_t *vm) {
     /* Console */
     vm_add_prim(vm, "emit",   p_emit,   false);
-    vm_add_prim(vm, "type",   p_type,   false);
+    vm->heads[vm_add_prim(vm, "type", p_type, false)].attrs |= A_SINK;
     vm_add_prim(vm, "cr",     p_cr,     false);
+    vm_add_prim(vm, "flush",  p_flush,  false);
+    vm_add_prim(vm, "output-buffer", p_output_buffer, false);
+    vm_add_prim(vm, "capture-begin", p_capture_begin, false);
+    vm_add_prim(vm, "capture-end",   p_capture_end,   false);
+    vm_add_prim(vm, "html-escape",      p_html_escape,      false);
+    vm_add_prim(vm, "html-escape-to",   p_html_escape_to,   false);
+    vm_add_prim(vm, "html-escape-file", p_html_escape_file, false);
     vm_add_prim(vm, "key",    p_key,    false);
     vm_add_prim(vm, "accept", p_accept, false);
 
@@ -475,6 +1220,7 @@ void io_init(vm_t *vm) {
     vm_add_prim(vm, "create-file", p_create_file,  false);
     vm_add_prim(vm, "close-file",  p_close_file,   false);
     vm_add_prim(vm, "write-file",  p_write_file,   false);
+    vm_add_prim(vm, "read-file",   p_read_file,    false);
     vm_add_prim(vm, "read-line",   p_read_line,    false);
     vm_add_prim(vm, "emit-file",   p_emit_file,    false);
     vm_add_prim(vm, "flush-file",  p_flush_file,   false);
@@ -484,12 +1230,21 @@ void io_init(vm_t *vm) {
     vm_add_prim(vm, "throw",       p_throw,        false);
     vm_add_prim(vm, "stdout",      p_stdout,       false);
     vm_add_prim(vm, "slurp-file",  p_slurp_file,   false);
+    vm_add_prim(vm, "map-file",    p_map_file,     false);
+    vm_add_prim(vm, "unmap-file",  p_unmap_file,   false);
 
     /* System */
     vm_add_prim(vm, "system",    p_system,    false);
+    vm_add_prim(vm, "run-capture", p_run_capture, false);
+    vm_add_prim(vm, "run-argv",    p_run_argv,    false);
+    vm_add_prim(vm, "run-lines",   p_run_lines,   false);
     vm_add_prim(vm, "open-path", p_open_path, false);
     vm_add_prim(vm, "bye",       p_bye,       false);
     vm_add_prim(vm, "getenv",    p_getenv,    false);
+    vm_add_variable(vm, "argc", 0);
+    vm_add_prim(vm, "argv",      p_argv,      false);
+    vm_add_prim(vm, "utime",     p_utime,     false);
+    vm_add_prim(vm, "bench",     p_bench,     false);
 
     /* File loading */
     vm_add_prim(vm, "include",  p_include,  false);
@@ -504,4 +1259,7 @@ void io_init(vm_t *vm) {
     vm_add_prim(vm, "base",    p_base,    false);
     vm_add_prim(vm, "decimal", p_decimal, false);
     vm_add_prim(vm, "hex",     p_hex,     false);
+
+    /* SQLite */
+    sql_init(vm);
 }
@@ -0,0 +1,1125 @@
+/* jit.c - Native code for hot colon definitions (--jit)
+ *
+ * A copy-and-patch compiler. Every primitive the JIT knows has a
+ * stencil: a few instructions of x86-64 or AArch64 code written
+ * against the fixed registers below, with holes for literals and
+ * branch offsets. Once docol has counted vm_jit_threshold calls to a
+ * colon definition, its threaded code is compiled by copying the
+ * stencil of each cell in order and patching the holes. (lit), the
+ * branches, (do), (?do), (loop), (+loop), constants and variables are
+ * inline. Any other cell is a call: to the primitive, to the word's
+ * native code, or through vm_execute for a colon word that is still
+ * threaded. The result takes docol's place in the code field, so both
+ * inner interpreters, EXECUTE and vm_execute run it like any primitive.
+ *
+ * A definition stays threaded when it uses DOES>, reaches into its
+ * caller's return stack (R> or R@ with nothing of its own there), ends
+ * with items of its own still on the return stack, or is longer than
+ * JIT_MAX_CELLS.
+ *
+ * Registers while native code runs:
+ *   x86-64   rbx vm, r12 data stack pointer, r13 vm->mem,
+ *            r14 return stack pointer, r15d vm->aborts on entry
+ *   AArch64  x19 vm, x20 data stack pointer, x21 vm->mem,
+ *            x22 return stack pointer, w23 vm->aborts on entry
+ * SP and RSP are written back before each call and reloaded after it,
+ * and the code returns at once if the call aborted or stopped the VM.
+ * Decoding and the return stack check are shared; each architecture
+ * has its own stencil table and emitter.
+ *
+ * The stencils are hand-assembled. Before first use each one is run
+ * beside the prims.c primitive it replaces (check_stencils, below);
+ * one that disagrees is called instead of inlined.
+ *
+ * Code is never writable and executable at once: each definition gets
+ * its own pages from one reserved range, written, then flipped to
+ * read+execute. On Apple arm64 the range is MAP_JIT and the flip is
+ * pthread_jit_write_protect_np, per thread, since the hardened runtime
+ * refuses mprotect to executable. AArch64 also flushes the instruction
+ * cache over new code. On any other architecture vm_jit_compile
+ * declines and every word stays threaded.
+ */
+
+#include "fifth.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int vm_jit_threshold;
+
+static uint8_t *pool, *pool_top;     /* Reserved code range, next free page */
+
+bool vm_jit_owns(prim_fn code) {
+    uint8_t *p = (uint8_t *)(uintptr_t)code;
+    return pool && p >= pool && p < pool_top;
+}
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+#define JIT_MAX_CELLS  4096
+#define JIT_POOL       ((size_t)64 << 20)
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ============================================================
+ * Stencils
+ * ============================================================ */
+
+enum {
+    OP_CALL,                         /* Not inline: call the word */
+    OP_STENCIL,                      /* Copy code[] */
+    OP_LIT, OP_LIT_PLUS, OP_SLIT,
+    OP_BRANCH, OP_0BRANCH, OP_DUP_0BRANCH, OP_0EQ_BRANCH,
+    OP_QDO, OP_LOOP, OP_PLOOP,
+    OP_EXIT, OP_TAILCALL,
+    OP_REFUSE                        /* Leave the definition threaded */
+};
+
+typedef struct {
+    const char    *name;             /* Primitive, looked up by its oldest entry */
+    int            op;
+    const uint8_t *code;             /* OP_STENCIL */
+    int            len;
+    int8_t         rneed;            /* Return stack cells it reads */
+    int8_t         rdelta;           /* Return stack cells it pushes */
+} stencil_t;
+
+#define NO_ST     NULL, 0
+
+#if defined(__x86_64__)
+
+#define JIT_INSN_MAX   96            /* Bytes of code per cell, at most */
+
+#define TOS_RAX   0x49,0x8B,0x04,0x24          /* mov rax,[r12] */
+#define NOS_RCX   0x49,0x8B,0x4C,0x24,0x08     /* mov rcx,[r12+8] */
+#define RAX_TOS   0x49,0x89,0x04,0x24          /* mov [r12],rax */
+#define RCX_TOS   0x49,0x89,0x0C,0x24          /* mov [r12],rcx */
+#define SP_UP     0x49,0x83,0xC4,0x08          /* add r12,8 */
+#define SP_UP2    0x49,0x83,0xC4,0x10          /* add r12,16 */
+#define PUSH_RAX  0x49,0x83,0xEC,0x08, RAX_TOS /* sub r12,8; mov [r12],rax */
+#define POP_RAX   TOS_RAX, SP_UP
+#define RTOS_RAX  0x49,0x8B,0x06               /* mov rax,[r14] */
+#define MEM_RAX   0x49,0x8B,0x44,0x05,0x00     /* mov rax,[r13+rax] */
+/* setcc al; movzx eax,al; neg rax; mov [r12],rax */
+#define FLAG(cc)  0x0F,(cc),0xC0, 0x0F,0xB6,0xC0, 0x48,0xF7,0xD8, RAX_TOS
+#define CMP2(cc)  POP_RAX, 0x49,0x39,0x04,0x24, FLAG(cc)        /* cmp [r12],rax */
+#define CMP0(cc)  0x49,0x83,0x3C,0x24,0x00, FLAG(cc)            /* cmp qword [r12],0 */
+
+#define ST(...)   (const uint8_t[]){ __VA_ARGS__ }, sizeof((const uint8_t[]){ __VA_ARGS__ })
+
+static const stencil_t stencils[] = {
+    /* Stack */
+    { "dup",    OP_STENCIL, ST(TOS_RAX, PUSH_RAX), 0, 0 },
+    { "drop",   OP_STENCIL, ST(SP_UP), 0, 0 },
+    { "swap",   OP_STENCIL, ST(TOS_RAX, NOS_RCX, RCX_TOS, 0x49,0x89,0x44,0x24,0x08), 0, 0 },
+    { "over",   OP_STENCIL, ST(0x49,0x8B,0x44,0x24,0x08, PUSH_RAX), 0, 0 },
+    { "nip",    OP_STENCIL, ST(POP_RAX, RAX_TOS), 0, 0 },
+    { "tuck",   OP_STENCIL, ST(TOS_RAX, NOS_RCX, 0x49,0x89,0x44,0x24,0x08, RCX_TOS, PUSH_RAX), 0, 0 },
+    { "rot",    OP_STENCIL, ST(TOS_RAX, NOS_RCX, 0x49,0x8B,0x54,0x24,0x10,
+                               0x49,0x89,0x14,0x24, 0x49,0x89,0x44,0x24,0x08,
+                               0x49,0x89,0x4C,0x24,0x10), 0, 0 },
+    { "-rot",   OP_STENCIL, ST(TOS_RAX, NOS_RCX, 0x49,0x8B,0x54,0x24,0x10,
+                               RCX_TOS, 0x49,0x89,0x54,0x24,0x08,
+                               0x49,0x89,0x44,0x24,0x10), 0, 0 },
+    { "2dup",   OP_STENCIL, ST(TOS_RAX, NOS_RCX, 0x49,0x83,0xEC,0x10,
+                               0x49,0x89,0x4C,0x24,0x08, RAX_TOS), 0, 0 },
+    { "2drop",  OP_STENCIL, ST(SP_UP2), 0, 0 },
+
+    /* Return stack */
+    { ">r",     OP_STENCIL, ST(POP_RAX, 0x49,0x83,0xEE,0x08, 0x49,0x89,0x06), 0, 1 },
+    { "r>",     OP_STENCIL, ST(RTOS_RAX, 0x49,0x83,0xC6,0x08, PUSH_RAX), 1, -1 },
+    { "r@",     OP_STENCIL, ST(RTOS_RAX, PUSH_RAX), 1, 0 },
+    { "i",      OP_STENCIL, ST(RTOS_RAX, PUSH_RAX), 0, 0 },
+    { "j",      OP_STENCIL, ST(0x49,0x8B,0x46,0x10, PUSH_RAX), 0, 0 },
+    { "k",      OP_STENCIL, ST(0x49,0x8B,0x46,0x20, PUSH_RAX), 0, 0 },
+    { "unloop", OP_STENCIL, ST(0x49,0x83,0xC6,0x10), 2, -2 },
+    { "2>r",    OP_CALL,    NO_ST, 0, 2 },
+    { "2r>",    OP_CALL,    NO_ST, 2, -2 },
+    { "2r@",    OP_CALL,    NO_ST, 2, 0 },
+
+    /* Arithmetic and logic */
+    { "+",      OP_STENCIL, ST(POP_RAX, 0x49,0x01,0x04,0x24), 0, 0 },
+    { "-",      OP_STENCIL, ST(POP_RAX, 0x49,0x29,0x04,0x24), 0, 0 },
+    { "*",      OP_STENCIL, ST(POP_RAX, 0x49,0x0F,0xAF,0x04,0x24, RAX_TOS), 0, 0 },
+    { "and",    OP_STENCIL, ST(POP_RAX, 0x49,0x21,0x04,0x24), 0, 0 },
+    { "or",     OP_STENCIL, ST(POP_RAX, 0x49,0x09,0x04,0x24), 0, 0 },
+    { "xor",    OP_STENCIL, ST(POP_RAX, 0x49,0x31,0x04,0x24), 0, 0 },
+    { "negate", OP_STENCIL, ST(0x49,0xF7,0x1C,0x24), 0, 0 },
+    { "invert", OP_STENCIL, ST(0x49,0xF7,0x14,0x24), 0, 0 },
+    { "abs",    OP_STENCIL, ST(TOS_RAX, 0x48,0x89,0xC1, 0x48,0xF7,0xD9,
+                               0x48,0x0F,0x48,0xC8, RCX_TOS), 0, 0 },
+    { "min",    OP_STENCIL, ST(POP_RAX, 0x49,0x8B,0x0C,0x24, 0x48,0x39,0xC8,
+                               0x48,0x0F,0x4C,0xC8, RCX_TOS), 0, 0 },
+    { "max",    OP_STENCIL, ST(POP_RAX, 0x49,0x8B,0x0C,0x24, 0x48,0x39,0xC8,
+                               0x48,0x0F,0x4F,0xC8, RCX_TOS), 0, 0 },
+    { "1+",     OP_STENCIL, ST(0x49,0x83,0x04,0x24,0x01), 0, 0 },
+    { "1-",     OP_STENCIL, ST(0x49,0x83,0x2C,0x24,0x01), 0, 0 },
+    { "cells",  OP_STENCIL, ST(0x49,0xC1,0x24,0x24,0x03), 0, 0 },
+    { "cell+",  OP_STENCIL, ST(0x49,0x83,0x04,0x24,0x08), 0, 0 },
+    { "lshift", OP_STENCIL, ST(0x49,0x8B,0x0C,0x24, SP_UP, 0x49,0xD3,0x24,0x24), 0, 0 },
+    { "rshift", OP_STENCIL, ST(0x49,0x8B,0x0C,0x24, SP_UP, 0x49,0xD3,0x2C,0x24), 0, 0 },
+
+    /* Comparison */
+    { "=",      OP_STENCIL, ST(CMP2(0x94)), 0, 0 },
+    { "<>",     OP_STENCIL, ST(CMP2(0x95)), 0, 0 },
+    { "<",      OP_STENCIL, ST(CMP2(0x9C)), 0, 0 },
+    { ">",      OP_STENCIL, ST(CMP2(0x9F)), 0, 0 },
+    { "u<",     OP_STENCIL, ST(CMP2(0x92)), 0, 0 },
+    { "0=",     OP_STENCIL, ST(CMP0(0x94)), 0, 0 },
+    { "0<",     OP_STENCIL, ST(CMP0(0x9C)), 0, 0 },
+    { "0>",     OP_STENCIL, ST(CMP0(0x9F)), 0, 0 },
+
+    /* Memory */
+    { "@",      OP_STENCIL, ST(TOS_RAX, MEM_RAX, RAX_TOS), 0, 0 },
+    { "!",      OP_STENCIL, ST(TOS_RAX, NOS_RCX, SP_UP2, 0x49,0x89,0x4C,0x05,0x00), 0, 0 },
+    { "c@",     OP_STENCIL, ST(TOS_RAX, 0x41,0x0F,0xB6,0x44,0x05,0x00, RAX_TOS), 0, 0 },
+    { "c!",     OP_STENCIL, ST(TOS_RAX, NOS_RCX, SP_UP2, 0x41,0x88,0x4C,0x05,0x00), 0, 0 },
+    { "+!",     OP_STENCIL, ST(TOS_RAX, NOS_RCX, SP_UP2, 0x49,0x01,0x4C,0x05,0x00), 0, 0 },
+
+    /* Superinstructions */
+    { "(over@)",   OP_STENCIL, ST(0x49,0x8B,0x44,0x24,0x08, MEM_RAX, PUSH_RAX), 0, 0 },
+    { "(r@+)",     OP_STENCIL, ST(RTOS_RAX, 0x49,0x01,0x04,0x24), 0, 0 },
+    { "(i-cell+)", OP_STENCIL, ST(RTOS_RAX, 0x48,0xC1,0xE0,0x03, 0x49,0x01,0x04,0x24), 0, 0 },
+    { "(lit+)",       OP_LIT_PLUS,     NO_ST, 0, 0 },
+    { "(dup0branch)", OP_DUP_0BRANCH,  NO_ST, 0, 0 },
+    { "(0=branch)",   OP_0EQ_BRANCH,   NO_ST, 0, 0 },
+
+    /* Runtime words the compiler emits */
+    { "(lit)",     OP_LIT,     NO_ST, 0, 0 },
+    { "(s\")",     OP_SLIT,    NO_ST, 0, 0 },
+    { "(branch)",  OP_BRANCH,  NO_ST, 0, 0 },
+    { "(0branch)", OP_0BRANCH, NO_ST, 0, 0 },
+    { "(do)",      OP_STENCIL, ST(TOS_RAX, NOS_RCX, SP_UP2, 0x49,0x83,0xEE,0x10,
+                                  0x49,0x89,0x06, 0x49,0x89,0x4E,0x08), 0, 2 },
+    { "(?do)",     OP_QDO,     NO_ST, 0, 2 },
+    { "(loop)",    OP_LOOP,    NO_ST, 2, -2 },
+    { "(+loop)",   OP_PLOOP,   NO_ST, 2, -2 },
+    { "(exit)",    OP_EXIT,    NO_ST, 0, 0 },
+    { "(does>)",   OP_REFUSE,  NO_ST, 0, 0 },
+};
+
+#else /* __aarch64__ */
+
+#define JIT_INSN_MAX   128           /* Bytes of code per cell, at most */
+
+/* Stencils are instruction words; x0 holds TOS, x1 NOS */
+#define TOS_X0    0xF9400280                   /* ldr x0,[x20] */
+#define TOS_X1    0xF9400281                   /* ldr x1,[x20] */
+#define NOS_X0    0xF9400680                   /* ldr x0,[x20,#8] */
+#define TOS2      0xA9400680                   /* ldp x0,x1,[x20] */
+#define X0_TOS    0xF9000280                   /* str x0,[x20] */
+#define X1_TOS    0xF9000281                   /* str x1,[x20] */
+#define SP_UP     0x91002294                   /* add x20,x20,#8 */
+#define SP_UP2    0x91004294                   /* add x20,x20,#16 */
+#define PUSH_X0   0xF81F8E80                   /* str x0,[x20,#-8]! */
+#define POP_X0    0xF8408680                   /* ldr x0,[x20],#8 */
+#define RTOS_X0   0xF94002C0                   /* ldr x0,[x22] */
+#define MEM_X0    0xF8606AA0                   /* ldr x0,[x21,x0] */
+#define UNARY(op) TOS_X0, (op), X0_TOS
+#define BINARY(op) POP_X0, TOS_X1, (op), X1_TOS /* op x1,x1,x0 */
+#define FLAG(cc)  (0xDA9F03E0 | ((cc) ^ 1) << 12), X0_TOS      /* csetm x0,cc */
+#define CMP2(cc)  POP_X0, TOS_X1, 0xEB00003F, FLAG(cc)         /* cmp x1,x0 */
+#define CMP0(cc)  TOS_X0, 0xF100001F, FLAG(cc)                 /* cmp x0,#0 */
+#define CC_EQ 0x0
+#define CC_NE 0x1
+#define CC_LO 0x3
+#define CC_MI 0x4
+#define CC_LT 0xB
+#define CC_GT 0xC
+
+#define ST(...)   (const uint8_t *)(const uint32_t[]){ __VA_ARGS__ }, \
+                  sizeof((const uint32_t[]){ __VA_ARGS__ })
+
+static const stencil_t stencils[] = {
+    /* Stack */
+    { "dup",    OP_STENCIL, ST(TOS_X0, PUSH_X0), 0, 0 },
+    { "drop",   OP_STENCIL, ST(SP_UP), 0, 0 },
+    { "swap",   OP_STENCIL, ST(TOS2, 0xA9000281), 0, 0 },                 /* stp x1,x0,[x20] */
+    { "over",   OP_STENCIL, ST(NOS_X0, PUSH_X0), 0, 0 },
+    { "nip",    OP_STENCIL, ST(POP_X0, X0_TOS), 0, 0 },
+    { "tuck",   OP_STENCIL, ST(TOS2, 0xF9000680, X1_TOS, PUSH_X0), 0, 0 },  /* str x0,[x20,#8] */
+    { "rot",    OP_STENCIL, ST(TOS2, 0xF9400A82,                           /* ldr x2,[x20,#16] */
+                               0xA9000282, 0xF9000A81), 0, 0 },          /* stp x2,x0,[x20]; str x1,[x20,#16] */
+    { "-rot",   OP_STENCIL, ST(TOS2, 0xF9400A82,
+                               0xA9000A81, 0xF9000A80), 0, 0 },          /* stp x1,x2,[x20]; str x0,[x20,#16] */
+    { "2dup",   OP_STENCIL, ST(TOS2, 0xA9BF0680), 0, 0 },                 /* stp x0,x1,[x20,#-16]! */
+    { "2drop",  OP_STENCIL, ST(SP_UP2), 0, 0 },
+
+    /* Return stack */
+    { ">r",     OP_STENCIL, ST(POP_X0, 0xF81F8EC0), 0, 1 },               /* str x0,[x22,#-8]! */
+    { "r>",     OP_STENCIL, ST(0xF84086C0, PUSH_X0), 1, -1 },             /* ldr x0,[x22],#8 */
+    { "r@",     OP_STENCIL, ST(RTOS_X0, PUSH_X0), 1, 0 },
+    { "i",      OP_STENCIL, ST(RTOS_X0, PUSH_X0), 0, 0 },
+    { "j",      OP_STENCIL, ST(0xF9400AC0, PUSH_X0), 0, 0 },              /* ldr x0,[x22,#16] */
+    { "k",      OP_STENCIL, ST(0xF94012C0, PUSH_X0), 0, 0 },              /* ldr x0,[x22,#32] */
+    { "unloop", OP_STENCIL, ST(0x910042D6), 2, -2 },                      /* add x22,x22,#16 */
+    { "2>r",    OP_CALL,    NO_ST, 0, 2 },
+    { "2r>",    OP_CALL,    NO_ST, 2, -2 },
+    { "2r@",    OP_CALL,    NO_ST, 2, 0 },
+
+    /* Arithmetic and logic */
+    { "+",      OP_STENCIL, ST(BINARY(0x8B000021)), 0, 0 },               /* add */
+    { "-",      OP_STENCIL, ST(BINARY(0xCB000021)), 0, 0 },               /* sub */
+    { "*",      OP_STENCIL, ST(BINARY(0x9B007C21)), 0, 0 },               /* mul */
+    { "and",    OP_STENCIL, ST(BINARY(0x8A000021)), 0, 0 },
+    { "or",     OP_STENCIL, ST(BINARY(0xAA000021)), 0, 0 },               /* orr */
+    { "xor",    OP_STENCIL, ST(BINARY(0xCA000021)), 0, 0 },               /* eor */
+    { "negate", OP_STENCIL, ST(UNARY(0xCB0003E0)), 0, 0 },                /* neg x0,x0 */
+    { "invert", OP_STENCIL, ST(UNARY(0xAA2003E0)), 0, 0 },                /* mvn x0,x0 */
+    { "abs",    OP_STENCIL, ST(TOS_X0, 0xF100001F, 0xDA80A400, X0_TOS), 0, 0 }, /* cneg x0,x0,lt */
+    { "min",    OP_STENCIL, ST(POP_X0, TOS_X1, 0xEB00003F, 0x9A80B021, X1_TOS), 0, 0 }, /* csel x1,x1,x0,lt */
+    { "max",    OP_STENCIL, ST(POP_X0, TOS_X1, 0xEB00003F, 0x9A80C021, X1_TOS), 0, 0 }, /* csel x1,x1,x0,gt */
+    { "1+",     OP_STENCIL, ST(UNARY(0x91000400)), 0, 0 },                /* add x0,x0,#1 */
+    { "1-",     OP_STENCIL, ST(UNARY(0xD1000400)), 0, 0 },                /* sub x0,x0,#1 */
+    { "cells",  OP_STENCIL, ST(UNARY(0xD37DF000)), 0, 0 },                /* lsl x0,x0,#3 */
+    { "cell+",  OP_STENCIL, ST(UNARY(0x91002000)), 0, 0 },                /* add x0,x0,#8 */
+    { "lshift", OP_STENCIL, ST(BINARY(0x9AC02021)), 0, 0 },               /* lsl */
+    { "rshift", OP_STENCIL, ST(BINARY(0x9AC02421)), 0, 0 },               /* lsr */
+
+    /* Comparison */
+    { "=",      OP_STENCIL, ST(CMP2(CC_EQ)), 0, 0 },
+    { "<>",     OP_STENCIL, ST(CMP2(CC_NE)), 0, 0 },
+    { "<",      OP_STENCIL, ST(CMP2(CC_LT)), 0, 0 },
+    { ">",      OP_STENCIL, ST(CMP2(CC_GT)), 0, 0 },
+    { "u<",     OP_STENCIL, ST(CMP2(CC_LO)), 0, 0 },
+    { "0=",     OP_STENCIL, ST(CMP0(CC_EQ)), 0, 0 },
+    { "0<",     OP_STENCIL, ST(CMP0(CC_LT)), 0, 0 },
+    { "0>",     OP_STENCIL, ST(CMP0(CC_GT)), 0, 0 },
+
+    /* Memory */
+    { "@",      OP_STENCIL, ST(TOS_X0, MEM_X0, X0_TOS), 0, 0 },
+    { "!",      OP_STENCIL, ST(TOS2, SP_UP2, 0xF8206AA1), 0, 0 },         /* str x1,[x21,x0] */
+    { "c@",     OP_STENCIL, ST(TOS_X0, 0x38606AA0, X0_TOS), 0, 0 },       /* ldrb w0,[x21,x0] */
+    { "c!",     OP_STENCIL, ST(TOS2, SP_UP2, 0x38206AA1), 0, 0 },         /* strb w1,[x21,x0] */
+    { "+!",     OP_STENCIL, ST(TOS2, SP_UP2, 0xF8606AA2,                  /* ldr x2,[x21,x0] */
+                               0x8B010042, 0xF8206AA2), 0, 0 },          /* add x2,x2,x1; str x2,[x21,x0] */
+
+    /* Superinstructions */
+    { "(over@)",   OP_STENCIL, ST(NOS_X0, MEM_X0, PUSH_X0), 0, 0 },
+    { "(r@+)",     OP_STENCIL, ST(RTOS_X0, TOS_X1, 0x8B000021, X1_TOS), 0, 0 },
+    { "(i-cell+)", OP_STENCIL, ST(RTOS_X0, TOS_X1, 0x8B000C21, X1_TOS), 0, 0 }, /* add x1,x1,x0,lsl #3 */
+    { "(lit+)",       OP_LIT_PLUS,     NO_ST, 0, 0 },
+    { "(dup0branch)", OP_DUP_0BRANCH,  NO_ST, 0, 0 },
+    { "(0=branch)",   OP_0EQ_BRANCH,   NO_ST, 0, 0 },
+
+    /* Runtime words the compiler emits */
+    { "(lit)",     OP_LIT,     NO_ST, 0, 0 },
+    { "(s\")",     OP_SLIT,    NO_ST, 0, 0 },
+    { "(branch)",  OP_BRANCH,  NO_ST, 0, 0 },
+    { "(0branch)", OP_0BRANCH, NO_ST, 0, 0 },
+    { "(do)",      OP_STENCIL, ST(TOS2, SP_UP2, 0xA9BF06C0), 0, 2 },      /* stp x0,x1,[x22,#-16]! */
+    { "(?do)",     OP_QDO,     NO_ST, 0, 2 },
+    { "(loop)",    OP_LOOP,    NO_ST, 2, -2 },
+    { "(+loop)",   OP_PLOOP,   NO_ST, 2, -2 },
+    { "(exit)",    OP_EXIT,    NO_ST, 0, 0 },
+    { "(does>)",   OP_REFUSE,  NO_ST, 0, 0 },
+};
+
+#endif
+
+#define NSTENCILS ((int)(sizeof(stencils) / sizeof(stencils[0])))
+
+static prim_fn stencil_fn[NSTENCILS];    /* Resolved once; primitives are per process */
+static bool stencil_off[NSTENCILS];      /* Disagrees with its primitive: called instead */
+static bool stencils_ready;
+static pthread_mutex_t stencil_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Oldest entry with this name: the primitive, not a later redefinition */
+static prim_fn prim_code(vm_t *vm, const char *name) {
+    int len = strlen(name);
+    for (int i = 0; i < vm->dict_count; i++)
+        if ((vm->heads[i].flags & F_LENMASK) == len &&
+            strncasecmp(vm->heads[i].name, name, len) == 0)
+            return vm->dict[i].code;
+    return NULL;
+}
+
+/* ============================================================
+ * Decoding
+ * ============================================================ */
+
+typedef struct {
+    cell_t  at;                      /* Offset of the cell in mem[] */
+    int     xt;
+    int     op;
+    int     st;                      /* stencils[] index, -1 = plain call */
+    cell_t  arg;                     /* Literal, string length or branch target */
+    int     target;                  /* Index of the branch target */
+    int     depth;                   /* Own return stack cells, -1 = unreached */
+} insn_t;
+
+static int classify(vm_t *vm, int xt, int *st) {
+    prim_fn code = vm->dict[xt].code;
+    *st = -1;
+    if (xt == vm->xt_tailcall) return OP_TAILCALL;   /* Shares (branch)'s handler */
+    if (code == docon || code == dovar) return OP_LIT;
+    for (int i = 0; i < NSTENCILS; i++) {
+        if (stencil_fn[i] == code) {
+            *st = i;
+            return stencil_off[i] ? OP_CALL : stencils[i].op;
+        }
+    }
+    return OP_CALL;
+}
+
+static int insn_at(const insn_t *in, int n, cell_t at) {
+    int lo = 0, hi = n - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (in[mid].at == at) return mid;
+        if (in[mid].at < at) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+/* Decode a body up to the last cell reachable from its start: past an
+ * unconditional exit or jump with no branch target beyond it. */
+static int decode(vm_t *vm, cell_t start, insn_t *in) {
+    const cell_t C = (cell_t)sizeof(cell_t);
+    cell_t ip = start, reach = start;
+    int n = 0;
+    for (;;) {
+        if (n == JIT_MAX_CELLS || ip < 0 || ip + 2 * C > (cell_t)vm_mem_size) return -1;
+        insn_t *x = &in[n++];
+        x->at = ip;
+        x->xt = vm_cell_to_xt(*(cell_t *)(vm->mem + ip));
+        x->depth = -1;
+        x->target = -1;
+        if (x->xt < 0 || x->xt >= vm->dict_count) return -1;
+        x->op = classify(vm, x->xt, &x->st);
+        ip += C;
+        switch (x->op) {
+        case OP_LIT:
+            x->arg = x->st < 0 ? vm->dict[x->xt].param : *(cell_t *)(vm->mem + ip);
+            if (x->st >= 0) ip += C;
+            break;
+        case OP_LIT_PLUS:
+            x->arg = *(cell_t *)(vm->mem + ip);
+            ip += C;
+            break;
+        case OP_SLIT:
+            x->arg = *(cell_t *)(vm->mem + ip);
+            if (x->arg < 0 || x->arg > (cell_t)vm_mem_size) return -1;
+            ip += C + vm_align(x->arg);
+            break;
+        case OP_BRANCH: case OP_0BRANCH: case OP_DUP_0BRANCH: case OP_0EQ_BRANCH:
+        case OP_QDO: case OP_LOOP: case OP_PLOOP: case OP_TAILCALL:
+            x->arg = *(cell_t *)(vm->mem + ip);
+            ip += C;
+            if (x->op != OP_TAILCALL && x->arg > reach) reach = x->arg;
+            break;
+        case OP_REFUSE:
+            return -1;
+        }
+        if ((x->op == OP_EXIT || x->op == OP_BRANCH || x->op == OP_TAILCALL) && ip > reach)
+            return n;
+    }
+}
+
+/* Follow the return stack depth along every path. Each cell must see
+ * one depth, never read below it, and return with it at zero. */
+static bool check_rstack(insn_t *in, int n) {
+    for (int i = 0; i < n; i++) {
+        if (in[i].op >= OP_BRANCH && in[i].op <= OP_PLOOP) {
+            in[i].target = insn_at(in, n, in[i].arg);
+            if (in[i].target < 0) return false;
+        }
+    }
+    in[0].depth = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < n; i++) {
+            int d = in[i].depth;
+            if (d < 0) continue;
+            int need = in[i].st >= 0 ? stencils[in[i].st].rneed : 0;
+            int delta = in[i].st >= 0 ? stencils[in[i].st].rdelta : 0;
+            if (d < need) return false;
+            int next[2] = { -1, -1 }, nd[2] = { d + delta, d };
+            switch (in[i].op) {
+            case OP_EXIT: case OP_TAILCALL:
+                if (d != 0) return false;
+                break;
+            case OP_BRANCH:
+                next[1] = in[i].target;
+                break;
+            case OP_LOOP: case OP_PLOOP:
+                next[0] = i + 1;
+                next[1] = in[i].target;              /* Back to the body */
+                break;
+            case OP_0BRANCH: case OP_DUP_0BRANCH: case OP_0EQ_BRANCH: case OP_QDO:
+                next[1] = in[i].target;              /* Taken: (?do) skips the loop */
+                /* fall through */
+            default:
+                next[0] = i + 1;
+                break;
+            }
+            for (int k = 0; k < 2; k++) {
+                int t = next[k];
+                if (t < 0) continue;
+                if (t >= n) return false;
+                if (in[t].depth < 0) { in[t].depth = nd[k]; changed = true; }
+                else if (in[t].depth != nd[k]) return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* ============================================================
+ * Emitting
+ * ============================================================ */
+
+enum { TO_START = -1, TO_BODY = -2, TO_EXIT = -3, TO_BAIL = -4 };
+
+typedef struct {
+    uint8_t *buf;
+    size_t   len;
+    struct { size_t at; int to; } *fix;
+    int      nfix;
+    size_t  *native;                 /* Code offset of each insn */
+    size_t   body, exit, bail;
+} jit_t;
+
+static void put(jit_t *j, const uint8_t *p, int n) {
+    memcpy(j->buf + j->len, p, (size_t)n);
+    j->len += (size_t)n;
+}
+#define PUT(j, ...) put((j), ST(__VA_ARGS__))
+
+static void put32(jit_t *j, uint32_t v) { memcpy(j->buf + j->len, &v, 4); j->len += 4; }
+
+/* Colon words still threaded are entered through the C API */
+static void jit_enter(vm_t *vm, int xt) { vm_execute(vm, xt); }
+
+/* Colon word whose body starts at body: the XT to tail-call, -1 = none */
+static int body_owner(vm_t *vm, cell_t body) {
+    for (int i = vm->dict_count - 1; i >= 0; i--) {
+        prim_fn code = vm->dict[i].code;
+        if (vm->dict[i].param == body && (code == docol || vm_jit_owns(code))) return i;
+    }
+    return -1;
+}
+
+#if defined(__x86_64__)
+
+static void put64(jit_t *j, uint64_t v) { memcpy(j->buf + j->len, &v, 8); j->len += 8; }
+
+/* rel32 hole, patched once every label is known */
+static void put_rel(jit_t *j, int to) {
+    j->fix[j->nfix].at = j->len;
+    j->fix[j->nfix++].to = to;
+    put32(j, 0);
+}
+
+/* op [rbx+field] with a 32-bit displacement */
+static void put_vm(jit_t *j, const uint8_t *op, int n, size_t field) {
+    put(j, op, n);
+    put32(j, (uint32_t)field);
+}
+#define PUT_VM(j, field, ...) put_vm((j), ST(__VA_ARGS__), offsetof(vm_t, field))
+
+static void put_rax(jit_t *j, cell_t v) {
+    if (v >= INT32_MIN && v <= INT32_MAX) { PUT(j, 0x48,0xC7,0xC0); put32(j, (uint32_t)v); }
+    else { PUT(j, 0x48,0xB8); put64(j, (uint64_t)v); }
+}
+
+static void put_writeback(jit_t *j) {
+    PUT_VM(j, sp,  0x4C,0x89,0xA3);                  /* mov [rbx+sp],r12 */
+    PUT_VM(j, rsp, 0x4C,0x89,0xB3);                  /* mov [rbx+rsp],r14 */
+}
+
+static void put_reload(jit_t *j) {
+    PUT_VM(j, sp,  0x4C,0x8B,0xA3);                  /* mov r12,[rbx+sp] */
+    PUT_VM(j, rsp, 0x4C,0x8B,0xB3);                  /* mov r14,[rbx+rsp] */
+}
+
+static void put_pops(jit_t *j) {
+    PUT(j, 0x41,0x5F, 0x41,0x5E, 0x41,0x5D, 0x41,0x5C, 0x5B);
+}
+
+static void put_return(jit_t *j) {
+    put_pops(j);
+    PUT(j, 0xC3);
+}
+
+/* call or jmp to a C function or native word, vm in rdi */
+static void put_far(jit_t *j, const void *fn_addr, bool jump) {
+    PUT(j, 0x48,0xB8);
+    put64(j, (uint64_t)(uintptr_t)fn_addr);
+    if (jump) PUT(j, 0xFF,0xE0);
+    else PUT(j, 0xFF,0xD0);
+}
+
+/* A call from the cell at. A native callee gets the return frame
+ * docol would push, so its depth counts against the return stack and
+ * a runaway recursion hits the guard page as threaded code does. */
+static void put_call(jit_t *j, vm_t *vm, int xt, int self, cell_t at) {
+    prim_fn code = vm->dict[xt].code;
+    bool native = xt == self || vm_jit_owns(code);
+    if (native) {
+        put_rax(j, at + (cell_t)sizeof(cell_t));
+        PUT(j, 0x49,0x83,0xEE,0x08, 0x49,0x89,0x06);  /* sub r14,8; mov [r14],rax */
+    }
+    put_writeback(j);
+    PUT(j, 0x48,0x89,0xDF);                          /* mov rdi,rbx */
+    if (xt == self) {
+        PUT(j, 0xE8);
+        put_rel(j, TO_START);
+    } else if (vm_jit_owns(code)) {
+        put_far(j, (const void *)(uintptr_t)code, false);
+    } else if (code == docol || code == dodoes) {
+        PUT(j, 0xBE); put32(j, (uint32_t)xt);          /* mov esi,xt */
+        put_far(j, (const void *)(uintptr_t)jit_enter, false);
+    } else {
+        PUT_VM(j, w, 0x48,0xC7,0x83); put32(j, (uint32_t)xt);  /* mov qword [rbx+w],xt */
+        put_far(j, (const void *)(uintptr_t)code, false);
+    }
+    put_reload(j);
+    if (native) PUT(j, 0x49,0x83,0xC6,0x08);         /* add r14,8 */
+    PUT_VM(j, running, 0x80,0xBB); PUT(j, 0x00);    /* cmp byte [rbx+running],0 */
+    PUT(j, 0x0F,0x84); put_rel(j, TO_BAIL);
+    PUT_VM(j, aborts, 0x44,0x3B,0xBB);              /* cmp r15d,[rbx+aborts] */
+    PUT(j, 0x0F,0x85); put_rel(j, TO_BAIL);
+}
+
+static bool put_tailcall(jit_t *j, vm_t *vm, cell_t body, int self) {
+    if (body == vm->dict[self].param) {
+        PUT(j, 0xE9);
+        put_rel(j, TO_BODY);
+        return true;
+    }
+    int xt = body_owner(vm, body);
+    if (xt < 0) return false;
+    prim_fn code = vm->dict[xt].code;
+    put_writeback(j);
+    PUT(j, 0x48,0x89,0xDF);                          /* mov rdi,rbx */
+    if (!vm_jit_owns(code)) { PUT(j, 0xBE); put32(j, (uint32_t)xt); }
+    put_pops(j);
+    put_far(j, vm_jit_owns(code) ? (const void *)(uintptr_t)code
+                                 : (const void *)(uintptr_t)jit_enter, true);
+    return true;
+}
+
+/* push rbx, r12-r15; mov rbx,rdi; load the cached registers */
+static void put_entry(jit_t *j) {
+    PUT(j, 0x53, 0x41,0x54, 0x41,0x55, 0x41,0x56, 0x41,0x57, 0x48,0x89,0xFB);
+    PUT_VM(j, sp,     0x4C,0x8B,0xA3);
+    PUT_VM(j, mem,    0x4C,0x8B,0xAB);
+    PUT_VM(j, rsp,    0x4C,0x8B,0xB3);
+    PUT_VM(j, aborts, 0x44,0x8B,0xBB);
+}
+
+static bool emit(jit_t *j, vm_t *vm, const insn_t *in, int n, int self) {
+    put_entry(j);
+    j->body = j->len;
+
+    for (int i = 0; i < n; i++) {
+        const insn_t *x = &in[i];
+        j->native[i] = j->len;
+        switch (x->op) {
+        case OP_STENCIL:
+            put(j, stencils[x->st].code, stencils[x->st].len);
+            break;
+        case OP_CALL:
+            put_call(j, vm, x->xt, self, x->at);
+            break;
+        case OP_LIT:
+            put_rax(j, x->arg);
+            PUT(j, PUSH_RAX);
+            break;
+        case OP_LIT_PLUS:
+            put_rax(j, x->arg);
+            PUT(j, 0x49,0x01,0x04,0x24);             /* add [r12],rax */
+            break;
+        case OP_SLIT:
+            put_rax(j, x->at + 2 * (cell_t)sizeof(cell_t));
+            PUT(j, PUSH_RAX);
+            put_rax(j, x->arg);
+            PUT(j, PUSH_RAX);
+            break;
+        case OP_BRANCH:
+            PUT(j, 0xE9);
+            put_rel(j, x->target);
+            break;
+        case OP_0BRANCH:
+            PUT(j, POP_RAX, 0x48,0x85,0xC0, 0x0F,0x84);  /* test rax,rax; jz */
+            put_rel(j, x->target);
+            break;
+        case OP_DUP_0BRANCH:
+            PUT(j, 0x49,0x83,0x3C,0x24,0x00, 0x0F,0x84);  /* cmp qword [r12],0; jz */
+            put_rel(j, x->target);
+            break;
+        case OP_0EQ_BRANCH:
+            PUT(j, POP_RAX, 0x48,0x85,0xC0, 0x0F,0x85);  /* test rax,rax; jnz */
+            put_rel(j, x->target);
+            break;
+        case OP_QDO:
+            /* Index rax, limit rcx; equal skips the loop */
+            PUT(j, TOS_RAX, NOS_RCX, SP_UP2, 0x48,0x39,0xC8, 0x0F,0x84);
+            put_rel(j, x->target);
+            PUT(j, 0x49,0x83,0xEE,0x10, 0x49,0x89,0x06, 0x49,0x89,0x4E,0x08);
+            break;
+        case OP_LOOP:
+            /* mov rax,[r14]; add rax,1; mov [r14],rax; cmp rax,[r14+8]; jne body */
+            PUT(j, RTOS_RAX, 0x48,0x83,0xC0,0x01, 0x49,0x89,0x06, 0x49,0x3B,0x46,0x08, 0x0F,0x85);
+            put_rel(j, x->target);
+            PUT(j, 0x49,0x83,0xC6,0x10);             /* add r14,16 */
+            break;
+        case OP_PLOOP:
+            /* rcx step, rdx index-limit before, rsi after: done when the
+             * index crosses the limit or lands on it, as in (+loop) */
+            PUT(j, 0x49,0x8B,0x0C,0x24, SP_UP,       /* mov rcx,[r12]; add r12,8 */
+                   RTOS_RAX, 0x48,0x89,0xC2,         /* mov rdx,rax */
+                   0x49,0x2B,0x56,0x08,              /* sub rdx,[r14+8] */
+                   0x48,0x01,0xC8, 0x49,0x89,0x06,   /* add rax,rcx; mov [r14],rax */
+                   0x48,0x89,0xD6, 0x48,0x01,0xCE,   /* mov rsi,rdx; add rsi,rcx */
+                   0x48,0x89,0xD7, 0x48,0x31,0xF7,   /* mov rdi,rdx; xor rdi,rsi */
+                   0x48,0x31,0xCA, 0x48,0x21,0xFA,   /* xor rdx,rcx; and rdx,rdi */
+                   0x78,0x09,                        /* js done */
+                   0x48,0x85,0xF6, 0x0F,0x85);       /* test rsi,rsi; jnz body */
+            put_rel(j, x->target);
+            PUT(j, 0x49,0x83,0xC6,0x10);             /* done: add r14,16 */
+            break;
+        case OP_EXIT:
+            PUT(j, 0xE9);
+            put_rel(j, TO_EXIT);
+            break;
+        case OP_TAILCALL:
+            if (!put_tailcall(j, vm, x->arg, self)) return false;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    j->exit = j->len;
+    put_writeback(j);
+    j->bail = j->len;
+    put_return(j);
+
+    for (int f = 0; f < j->nfix; f++) {
+        int to = j->fix[f].to;
+        size_t dest = to == TO_START ? 0 : to == TO_BODY ? j->body
+                    : to == TO_EXIT ? j->exit : to == TO_BAIL ? j->bail : j->native[to];
+        int32_t rel = (int32_t)((int64_t)dest - (int64_t)(j->fix[f].at + 4));
+        memcpy(j->buf + j->fix[f].at, &rel, 4);
+    }
+    return true;
+}
+
+#else /* __aarch64__ */
+
+#define A64_B       0x14000000u     /* b: imm26 */
+#define A64_BL      0x94000000u     /* bl: imm26 */
+#define A64_BCC     0x54000000u     /* b.cond: imm19, cond in bits 0-3 */
+#define A64_CBZ_X0  0xB4000000u     /* cbz x0: imm19 */
+#define A64_CBNZ_X0 0xB5000000u     /* cbnz x0: imm19 */
+#define A64_CBZ_W0  0x34000000u     /* cbz w0: imm19 */
+#define A64_LDR_X   0xF9400000u     /* ldr xt,[xn,#imm12*8] */
+#define A64_STR_X   0xF9000000u     /* str xt,[xn,#imm12*8] */
+#define A64_LDR_W   0xB9400000u     /* ldr wt,[xn,#imm12*4] */
+#define A64_LDRB    0x39400000u     /* ldrb wt,[xn,#imm12] */
+#define A64_BLR_X16 0xD63F0200u
+#define A64_BR_X16  0xD61F0200u
+#define A64_MOV_X0_X19 0xAA1303E0u  /* mov x0,x19 */
+
+/* Branch hole, patched once every label is known */
+static void put_rel(jit_t *j, uint32_t insn, int to) {
+    j->fix[j->nfix].at = j->len;
+    j->fix[j->nfix++].to = to;
+    put32(j, insn);
+}
+
+/* x rd = v: movz or movn, then movk for each remaining 16-bit half */
+static void put_imm(jit_t *j, int rd, cell_t v) {
+    uint64_t u = (uint64_t)v;
+    int ones = 0, zeros = 0;
+    for (int hw = 0; hw < 4; hw++) {
+        uint32_t h = (uint32_t)(u >> (16 * hw)) & 0xFFFF;
+        ones += h == 0xFFFF;
+        zeros += h == 0;
+    }
+    bool inv = ones > zeros;
+    bool first = true;
+    for (int hw = 0; hw < 4; hw++) {
+        uint32_t h = (uint32_t)(u >> (16 * hw)) & 0xFFFF;
+        if (h == (inv ? 0xFFFFu : 0)) continue;
+        if (first) put32(j, (inv ? 0x92800000u : 0xD2800000u) | (uint32_t)hw << 21 |
+                            (inv ? ~h & 0xFFFF : h) << 5 | (uint32_t)rd);
+        else put32(j, 0xF2800000u | (uint32_t)hw << 21 | h << 5 | (uint32_t)rd);
+        first = false;
+    }
+    if (first) put32(j, (inv ? 0x92800000u : 0xD2800000u) | (uint32_t)rd);
+}
+
+/* Load or store a vm_t field 1 << scale bytes wide, rt against [x19].
+ * Past the scaled 12-bit offset it goes through x16 as [x19,x16]. */
+static void put_vm(jit_t *j, uint32_t op, int scale, int rt, size_t field) {
+    if ((field & ((1u << scale) - 1)) == 0 && (field >> scale) < 4096) {
+        put32(j, op | (uint32_t)(field >> scale) << 10 | 19u << 5 | (uint32_t)rt);
+    } else {
+        put_imm(j, 16, (cell_t)field);
+        put32(j, (op & ~0x01000000u) | 0x00206800u | 16u << 16 | 19u << 5 | (uint32_t)rt);
+    }
+}
+#define PUT_VM(j, op, scale, rt, field) put_vm((j), (op), (scale), (rt), offsetof(vm_t, field))
+
+static void put_writeback(jit_t *j) {
+    PUT_VM(j, A64_STR_X, 3, 20, sp);                 /* str x20,[x19,sp] */
+    PUT_VM(j, A64_STR_X, 3, 22, rsp);                /* str x22,[x19,rsp] */
+}
+
+static void put_reload(jit_t *j) {
+    PUT_VM(j, A64_LDR_X, 3, 20, sp);
+    PUT_VM(j, A64_LDR_X, 3, 22, rsp);
+}
+
+/* ldr x23; ldp x21,x22; ldp x19,x20; ldp x29,x30 */
+static void put_pops(jit_t *j) {
+    PUT(j, 0xF9401BF7, 0xA9425BF5, 0xA94153F3, 0xA8C47BFD);
+}
+
+static void put_return(jit_t *j) {
+    put_pops(j);
+    PUT(j, 0xD65F03C0);                              /* ret */
+}
+
+/* blr or br to a C function or native word through x16, vm in x0 */
+static void put_far(jit_t *j, const void *fn_addr, bool jump) {
+    put_imm(j, 16, (cell_t)(uintptr_t)fn_addr);
+    put32(j, jump ? A64_BR_X16 : A64_BLR_X16);
+}
+
+/* A call from the cell at, with the return frame docol would push for
+ * a native callee, as on x86-64 */
+static void put_call(jit_t *j, vm_t *vm, int xt, int self, cell_t at) {
+    prim_fn code = vm->dict[xt].code;
+    bool native = xt == self || vm_jit_owns(code);
+    if (native) {
+        put_imm(j, 0, at + (cell_t)sizeof(cell_t));
+        PUT(j, 0xF81F8EC0);                          /* str x0,[x22,#-8]! */
+    }
+    put_writeback(j);
+    PUT(j, A64_MOV_X0_X19);
+    if (xt == self) {
+        put_rel(j, A64_BL, TO_START);
+    } else if (vm_jit_owns(code)) {
+        put_far(j, (const void *)(uintptr_t)code, false);
+    } else if (code == docol || code == dodoes) {
+        put_imm(j, 1, xt);
+        put_far(j, (const void *)(uintptr_t)jit_enter, false);
+    } else {
+        put_imm(j, 1, xt);
+        PUT_VM(j, A64_STR_X, 3, 1, w);               /* str x1,[x19,w] */
+        put_far(j, (const void *)(uintptr_t)code, false);
+    }
+    put_reload(j);
+    if (native) PUT(j, 0x910022D6);                  /* add x22,x22,#8 */
+    PUT_VM(j, A64_LDRB, 0, 0, running);               /* ldrb w0,[x19,running] */
+    put_rel(j, A64_CBZ_W0, TO_BAIL);
+    PUT_VM(j, A64_LDR_W, 2, 0, aborts);              /* ldr w0,[x19,aborts] */
+    PUT(j, 0x6B17001F);                              /* cmp w0,w23 */
+    put_rel(j, A64_BCC | CC_NE, TO_BAIL);
+}
+
+static bool put_tailcall(jit_t *j, vm_t *vm, cell_t body, int self) {
+    if (body == vm->dict[self].param) {
+        put_rel(j, A64_B, TO_BODY);
+        return true;
+    }
+    int xt = body_owner(vm, body);
+    if (xt < 0) return false;
+    prim_fn code = vm->dict[xt].code;
+    put_writeback(j);
+    PUT(j, A64_MOV_X0_X19);
+    if (!vm_jit_owns(code)) put_imm(j, 1, xt);
+    put_pops(j);
+    put_far(j, vm_jit_owns(code) ? (const void *)(uintptr_t)code
+                                 : (const void *)(uintptr_t)jit_enter, true);
+    return true;
+}
+
+/* Frame for x29, x30 and x19-x23; mov x19,x0; load the cached registers */
+static void put_entry(jit_t *j) {
+    PUT(j, 0xA9BC7BFD, 0x910003FD,                   /* stp x29,x30,[sp,#-64]!; mov x29,sp */
+           0xA90153F3, 0xA9025BF5, 0xF9001BF7,       /* stp x19,x20; stp x21,x22; str x23 */
+           0xAA0003F3);                              /* mov x19,x0 */
+    PUT_VM(j, A64_LDR_X, 3, 20, sp);
+    PUT_VM(j, A64_LDR_X, 3, 21, mem);
+    PUT_VM(j, A64_LDR_X, 3, 22, rsp);
+    PUT_VM(j, A64_LDR_W, 2, 23, aborts);
+}
+
+static bool emit(jit_t *j, vm_t *vm, const insn_t *in, int n, int self) {
+    put_entry(j);
+    j->body = j->len;
+
+    for (int i = 0; i < n; i++) {
+        const insn_t *x = &in[i];
+        j->native[i] = j->len;
+        switch (x->op) {
+        case OP_STENCIL:
+            put(j, stencils[x->st].code, stencils[x->st].len);
+            break;
+        case OP_CALL:
+            put_call(j, vm, x->xt, self, x->at);
+            break;
+        case OP_LIT:
+            put_imm(j, 0, x->arg);
+            PUT(j, PUSH_X0);
+            break;
+        case OP_LIT_PLUS:
+            put_imm(j, 0, x->arg);
+            PUT(j, TOS_X1, 0x8B000021, X1_TOS);      /* add x1,x1,x0 */
+            break;
+        case OP_SLIT:
+            put_imm(j, 0, x->at + 2 * (cell_t)sizeof(cell_t));
+            PUT(j, PUSH_X0);
+            put_imm(j, 0, x->arg);
+            PUT(j, PUSH_X0);
+            break;
+        case OP_BRANCH:
+            put_rel(j, A64_B, x->target);
+            break;
+        case OP_0BRANCH:
+            PUT(j, POP_X0);
+            put_rel(j, A64_CBZ_X0, x->target);
+            break;
+        case OP_DUP_0BRANCH:
+            PUT(j, TOS_X0);
+            put_rel(j, A64_CBZ_X0, x->target);
+            break;
+        case OP_0EQ_BRANCH:
+            PUT(j, POP_X0);
+            put_rel(j, A64_CBNZ_X0, x->target);
+            break;
+        case OP_QDO:
+            /* Index x0, limit x1; equal skips the loop */
+            PUT(j, TOS2, SP_UP2, 0xEB01001F);        /* cmp x0,x1 */
+            put_rel(j, A64_BCC | CC_EQ, x->target);
+            PUT(j, 0xA9BF06C0);                      /* stp x0,x1,[x22,#-16]! */
+            break;
+        case OP_LOOP:
+            /* ldr x0,[x22]; add x0,x0,#1; str x0,[x22]; ldr x1,[x22,#8]; cmp x0,x1; b.ne body */
+            PUT(j, RTOS_X0, 0x91000400, 0xF90002C0, 0xF94006C1, 0xEB01001F);
+            put_rel(j, A64_BCC | CC_NE, x->target);
+            PUT(j, 0x910042D6);                      /* add x22,x22,#16 */
+            break;
+        case OP_PLOOP:
+            /* x1 step, x2 index-limit before, x3 after: done when the
+             * index crosses the limit or lands on it, as in (+loop) */
+            PUT(j, 0xF8408681, RTOS_X0,              /* ldr x1,[x20],#8; ldr x0,[x22] */
+                   0xF94006C2, 0xCB020002,           /* ldr x2,[x22,#8]; sub x2,x0,x2 */
+                   0x8B010000, 0xF90002C0,           /* add x0,x0,x1; str x0,[x22] */
+                   0x8B010043, 0xCA030044,           /* add x3,x2,x1; eor x4,x2,x3 */
+                   0xCA010042, 0xEA04005F,           /* eor x2,x2,x1; tst x2,x4 */
+                   A64_BCC | 2 << 5 | CC_MI);        /* b.mi done */
+            put_rel(j, A64_CBNZ_X0 | 3, x->target);  /* cbnz x3,body */
+            PUT(j, 0x910042D6);                      /* done: add x22,x22,#16 */
+            break;
+        case OP_EXIT:
+            put_rel(j, A64_B, TO_EXIT);
+            break;
+        case OP_TAILCALL:
+            if (!put_tailcall(j, vm, x->arg, self)) return false;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    j->exit = j->len;
+    put_writeback(j);
+    j->bail = j->len;
+    put_return(j);
+
+    /* Offsets count instructions: b and bl hold 26 bits, the rest 19
+     * at bit 5, which reaches 1 MB, far more than JIT_MAX_CELLS needs */
+    for (int f = 0; f < j->nfix; f++) {
+        int to = j->fix[f].to;
+        size_t dest = to == TO_START ? 0 : to == TO_BODY ? j->body
+                    : to == TO_EXIT ? j->exit : to == TO_BAIL ? j->bail : j->native[to];
+        uint32_t insn, rel = (uint32_t)(((int64_t)dest - (int64_t)j->fix[f].at) / 4);
+        memcpy(&insn, j->buf + j->fix[f].at, 4);
+        if ((insn & 0x7C000000u) == A64_B) insn |= rel & 0x03FFFFFF;
+        else insn |= (rel & 0x7FFFF) << 5;
+        memcpy(j->buf + j->fix[f].at, &insn, 4);
+    }
+    return true;
+}
+
+#endif
+
+#if defined(__APPLE__) && defined(__aarch64__)
+#define JIT_MAP_JIT  1               /* Pool is MAP_JIT, toggled per thread */
+#endif
+
+/* Copy code into fresh pages of the pool and make them executable */
+static void *install(const uint8_t *code, size_t len) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t span = (len + page - 1) & ~(page - 1);
+    pthread_mutex_lock(&pool_lock);
+    if (!pool) {
+#ifdef JIT_MAP_JIT
+        void *p = mmap(NULL, JIT_POOL, PROT_READ | PROT_WRITE | PROT_EXEC,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_JIT, -1, 0);
+#else
+        void *p = mmap(NULL, JIT_POOL, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#endif
+        if (p != MAP_FAILED) pool_top = pool = p;
+    }
+    uint8_t *at = NULL;
+    if (pool && pool_top + span <= pool + JIT_POOL) {
+        at = pool_top;
+        pool_top += span;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    if (!at) return NULL;
+
+#ifdef JIT_MAP_JIT
+    pthread_jit_write_protect_np(0);                 /* Writable, not executable, for this thread */
+    memcpy(at, code, len);
+    pthread_jit_write_protect_np(1);
+#else
+    if (mprotect(at, span, PROT_READ | PROT_WRITE) != 0) return NULL;
+    memcpy(at, code, len);
+    if (mprotect(at, span, PROT_READ | PROT_EXEC) != 0) return NULL;
+#endif
+#if defined(__aarch64__)
+    __builtin___clear_cache((char *)at, (char *)at + len);  /* sys_icache_invalidate on Darwin */
+#endif
+    return at;
+}
+
+/* ============================================================
+ * Checking stencils against prims.c
+ * ============================================================ */
+
+/* Each inline stencil runs beside its primitive from these stacks, TOS
+ * first, on a scratch VM; words that take addresses get offsets into
+ * its mem[] instead. Any difference in either stack or in mem[] turns
+ * the stencil off, so a primitive changed without its stencil costs
+ * speed, not correctness. */
+#define CHECK_DEPTH  4
+#define CHECK_MEM    64
+
+static const cell_t check_values[][CHECK_DEPTH] = {
+    { 3, 5, 2, 7 }, { -9, 4, -1, 6 }, { 6, 6, 0, -2 },
+};
+static const cell_t check_addrs[][CHECK_DEPTH] = {
+    { 16, 40, 8, 24 }, { 8, 8, 48, 0 },
+};
+static const char *const addr_words[] = { "@", "!", "c@", "c!", "+!", "(over@)" };
+
+typedef struct {
+    cell_t   ds[16], rs[16];
+    uint8_t  mem[CHECK_MEM];
+    long     sp, rsp;                /* Stack pointers after, as indices */
+} check_t;
+
+static void check_run(vm_t *t, check_t *c, const cell_t *in, prim_fn fn) {
+    memset(c, 0, sizeof(*c));
+    for (int k = 0; k < 16; k++) {
+        c->ds[k] = 0x5a00 + k;
+        c->rs[k] = 11 * (k + 1);
+    }
+    for (int k = 0; k < CHECK_DEPTH; k++) c->ds[8 + k] = in[k];
+    for (int k = 0; k < CHECK_MEM; k++) c->mem[k] = (uint8_t)(k * 37);
+    t->sp = c->ds + 8;
+    t->rsp = c->rs + 8;
+    t->mem = c->mem;
+    fn(t);
+    c->sp = (long)(t->sp - c->ds);
+    c->rsp = (long)(t->rsp - c->rs);
+}
+
+static bool takes_addr(const char *name) {
+    for (size_t k = 0; k < sizeof(addr_words) / sizeof(addr_words[0]); k++)
+        if (strcmp(name, addr_words[k]) == 0) return true;
+    return false;
+}
+
+/* Run every OP_STENCIL entry as a function of its own and compare */
+static void check_stencils(void) {
+    vm_t *t = calloc(1, sizeof(vm_t));
+    size_t *off = malloc(NSTENCILS * sizeof(size_t));
+    jit_t j = { .buf = malloc((size_t)NSTENCILS * (JIT_INSN_MAX + 128)) };
+    uint8_t *code = NULL;
+    if (t && off && j.buf) {
+        for (int i = 0; i < NSTENCILS; i++) {
+            off[i] = j.len;
+            if (stencils[i].op != OP_STENCIL) continue;
+            put_entry(&j);
+            put(&j, stencils[i].code, stencils[i].len);
+            put_writeback(&j);
+            put_return(&j);
+        }
+        code = install(j.buf, j.len);
+    }
+    for (int i = 0; code && i < NSTENCILS; i++) {
+        if (stencils[i].op != OP_STENCIL || !stencil_fn[i]) continue;
+        bool addr = takes_addr(stencils[i].name);
+        const cell_t (*in)[CHECK_DEPTH] = addr ? check_addrs : check_values;
+        int n = addr ? (int)(sizeof(check_addrs) / sizeof(check_addrs[0]))
+                     : (int)(sizeof(check_values) / sizeof(check_values[0]));
+        for (int k = 0; k < n && !stencil_off[i]; k++) {
+            check_t want, got;
+            check_run(t, &want, in[k], stencil_fn[i]);
+            check_run(t, &got, in[k], (prim_fn)(uintptr_t)(code + off[i]));
+            if (memcmp(&want, &got, sizeof(want)) != 0) {
+                fprintf(stderr, "JIT: stencil for %s disagrees with prims.c; calling it instead\n",
+                        stencils[i].name);
+                stencil_off[i] = true;
+            }
+        }
+    }
+    free(j.buf);
+    free(off);
+    free(t);
+}
+
+bool vm_jit_compile(vm_t *vm, int xt) {
+    if (vm->dict[xt].code != docol) return false;
+    pthread_mutex_lock(&stencil_lock);
+    if (!stencils_ready) {
+        for (int i = 0; i < NSTENCILS; i++) stencil_fn[i] = prim_code(vm, stencils[i].name);
+        check_stencils();
+        stencils_ready = true;
+    }
+    pthread_mutex_unlock(&stencil_lock);
+
+    bool ok = false;
+    insn_t *in = malloc(JIT_MAX_CELLS * sizeof(insn_t));
+    jit_t j = { 0 };
+    int n = in ? decode(vm, vm->dict[xt].param, in) : -1;
+    if (n > 0 && check_rstack(in, n)) {
+        j.buf = malloc((size_t)n * JIT_INSN_MAX + 256);
+        j.fix = malloc((size_t)n * 4 * sizeof(*j.fix));
+        j.native = malloc((size_t)n * sizeof(size_t));
+        if (j.buf && j.fix && j.native && emit(&j, vm, in, n, xt)) {
+            void *code = install(j.buf, j.len);
+            if (code) {
+                vm->dict[xt].code = (prim_fn)(uintptr_t)code;
+                ok = true;
+            }
+        }
+    }
+    free(j.buf);
+    free(j.fix);
+    free(j.native);
+    free(in);
+    return ok;
+}
+
+#else
+
+bool vm_jit_compile(vm_t *vm, int xt) {
+    (void)vm; (void)xt;
+    return false;
+}
+
+#endif /* __x86_64__ || __aarch64__ */
@@ -4,7 +4,17 @@
  *   fifth                      Interactive REPL
  *   fifth file.fs              Load and execute file
  *   fifth file.fs -e "code"    Load file, then execute code
+ *   fifth page.fs -- a b       Load page.fs; a and b are its arguments
  *   fifth -e "code"            Execute code
+ *   fifth lib.fs --save-image app.img   Snapshot the VM after loading
+ *   fifth --image app.img page.fs       Start from a snapshot (no boot)
+ *   fifth --mem 256M --dict 200000 big.fs   Raise the VM limits
+ *   fifth --profile app.fs              Per-word calls and time at exit
+ *   fifth --profile-sample app.fs       Sampled stacks, folded to fifth.folded
+ *   fifth --jit app.fs                  Native code for hot colon definitions
+ *   fifth lib.fs --jobs 8 a.fs b.fs ... Run pages in parallel, output in order
+ *   fifth lib.fs --serve /tmp/fifth.sock    Answer requests from warm workers
+ *   fifth --connect /tmp/fifth.sock page.fs [--] args   Run page.fs on the server
  */
 
 #include "fifth.h"
@@ -50,26 +60,177 @@ static void load_boot(vm_t *vm, const char *argv0) {
     fprintf(stderr, "Note: boot/core.fs not found (standalone mode)\n");
 }
 
+/* Parse a size like 65536, 512K, 64M or 2G; 0 if malformed */
+static size_t parse_size(const char *s) {
+    char *end;
+    unsigned long long n = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': n <<= 10; end++; break;
+        case 'm': case 'M': n <<= 20; end++; break;
+        case 'g': case 'G': n <<= 30; end++; break;
+    }
+    return (end == s || *end) ? 0 : (size_t)n;
+}
+
+/* Data space and dictionary limits: FIFTH_MEM / FIFTH_DICT, then
+ * --mem / --dict. They must be fixed before the first VM exists. */
+static bool set_limits(int argc, char **argv) {
+    const char *mem = getenv("FIFTH_MEM");
+    const char *dict = getenv("FIFTH_DICT");
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--mem") == 0) mem = argv[++i];
+        else if (strcmp(argv[i], "--dict") == 0) dict = argv[++i];
+        else if (strcmp(argv[i], "-e") == 0) i++;
+    }
+    size_t m = mem ? parse_size(mem) : vm_mem_size;
+    size_t d = dict ? parse_size(dict) : (size_t)vm_dict_size;
+    if (d > INT_MAX || vm_set_limits(m, (int)d) != 0) {
+        fprintf(stderr, "Invalid limits: --mem %s --dict %s\n",
+                mem ? mem : "(default)", dict ? dict : "(default)");
+        return false;
+    }
+    return true;
+}
+
+/* --profile, --profile-sample[=hz] and --profile-out path; started
+ * after boot so the report covers the program, not boot/core.fs */
+static void set_profile(int argc, char **argv) {
+    int mode = 0, hz = 0;
+    const char *out = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0) mode |= PROFILE_COUNT;
+        else if (strncmp(argv[i], "--profile-sample", 16) == 0 &&
+                 (argv[i][16] == '\0' || argv[i][16] == '=')) {
+            mode |= PROFILE_SAMPLE;
+            if (argv[i][16] == '=') hz = atoi(argv[i] + 17);
+        } else if (strcmp(argv[i], "--profile-out") == 0 && i + 1 < argc) out = argv[++i];
+        else if (strcmp(argv[i], "-e") == 0) i++;
+    }
+    if (mode) vm_profile_start(mode, hz, out);
+}
+
+/* --jit[=calls]: compile a colon definition after this many calls.
+ * Off while profiling, whose inner interpreter would not see it. */
+static void set_jit(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--jit", 5) == 0 && (argv[i][5] == '\0' || argv[i][5] == '=')) {
+            int calls = argv[i][5] == '=' ? atoi(argv[i] + 6) : 10;
+            if (calls < 1) calls = 1;
+            if (calls > UINT16_MAX) calls = UINT16_MAX;
+            vm_jit_threshold = vm_profile_mode ? 0 : calls;
+        } else if (strcmp(argv[i], "-e") == 0) i++;
+    }
+}
+
+/* Index of the -- that ends the engine's arguments, argc if none.
+ * What follows it goes to the script as ARGV and is never loaded. */
+static int options_end(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--") == 0) return i;
+        if (strcmp(argv[i], "-e") == 0) i++;
+    }
+    return argc;
+}
+
+static bool is_profile_flag(const char *arg) {
+    return strcmp(arg, "--profile") == 0 ||
+           (strncmp(arg, "--profile-sample", 16) == 0 && (arg[16] == '\0' || arg[16] == '=')) ||
+           (strncmp(arg, "--jit", 5) == 0 && (arg[5] == '\0' || arg[5] == '='));
+}
+
 int main(int argc, char **argv) {
+    /* The client needs no VM */
+    if (argc > 2 && strcmp(argv[1], "--connect") == 0) {
+        if (argc > 4 && strcmp(argv[4], "--") == 0) {
+            argv[4] = argv[3];       /* page.fs -- args: drop the -- */
+            return vm_serve_connect(argv[2], argc - 4, argv + 4);
+        }
+        return vm_serve_connect(argv[2], argc - 3, argv + 3);
+    }
+
+    /* argv[end] is the --, if any; it becomes ARGV 0 for each script */
+    int end = options_end(argc, argv);
+    if (!set_limits(end, argv)) return 1;
     vm_t *vm = vm_create();
+    if (end < argc) {
+        argv[end] = argv[0];         /* Until a script is named */
+        vm_set_args(vm, argc - end, argv + end);
+    } else {
+        vm_set_args(vm, 1, argv);
+    }
 
-    /* Load bootstrap */
-    load_boot(vm, argv[0]);
+    /* Load bootstrap, or a saved image in its place */
+    const char *image = NULL;
+    for (int i = 1; i + 1 < end; i++) {
+        if (strcmp(argv[i], "--image") == 0) { image = argv[i + 1]; break; }
+        if (strcmp(argv[i], "-e") == 0) i++;
+    }
+    if (image) {
+        if (vm_load_image(vm, image) != 0) {
+            vm_destroy(vm);
+            return 1;
+        }
+    } else {
+        load_boot(vm, argv[0]);
+    }
+    set_profile(end, argv);
+    set_jit(end, argv);
 
     /* Process arguments */
     bool interactive = true;
-    for (int i = 1; i < argc && vm->running; i++) {
-        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+    const char *serve = NULL;
+    int workers = 0;
+    for (int i = 1; i < end && vm->running; i++) {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < end) {
             i++;
             vm_interpret_line(vm, argv[i]);
             interactive = false;
+        } else if ((strcmp(argv[i], "--image") == 0 || strcmp(argv[i], "--mem") == 0 ||
+                    strcmp(argv[i], "--dict") == 0 || strcmp(argv[i], "--profile-out") == 0) &&
+                   i + 1 < end) {
+            i++; /* already applied */
+        } else if (is_profile_flag(argv[i])) {
+            /* already applied */
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < end) {
+            serve = argv[++i];
+            interactive = false;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < end) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < end) {
+            /* Every remaining argument is a job */
+            if (vm_run_jobs(vm, argv + i + 2, end - i - 2, atoi(argv[i + 1])) != 0)
+                vm->exit_code = 1;
+            interactive = false;
+            break;
+        } else if (strcmp(argv[i], "--save-image") == 0 && i + 1 < end) {
+            i++;
+            if (vm_save_image(vm, argv[i]) != 0) vm->exit_code = 1;
+            interactive = false;
         } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             printf("Fifth - A minimal Forth engine\n");
-            printf("Usage: fifth [file.fs ...] [-e \"code\"]\n");
+            printf("Usage: fifth [--mem size] [--dict n] [--image img] [--profile] [--jit] [file.fs ...] [-e \"code\"] [--save-image img] [--jobs n job.fs ...] [--serve socket] [-- args ...]\n");
+            printf("       fifth --connect socket script.fs [--] [args ...]\n");
             printf("\n");
-            printf("  file.fs    Load and execute Forth source file(s)\n");
-            printf("  -e code    Execute Forth code from command line\n");
-            printf("  -h         Show this help\n");
+            printf("  file.fs            Load and execute Forth source file(s)\n");
+            printf("  -- args ...        Arguments for the script, not loaded: ARGV is the file\n");
+            printf("                     being loaded, then args. Without --, ARGV is the first\n");
+            printf("                     file and every word after it, all of them loaded\n");
+            printf("  -e code            Execute Forth code from command line\n");
+            printf("  --image img        Start from a saved image instead of boot/core.fs\n");
+            printf("  --save-image img   Save the VM as loaded so far to img\n");
+            printf("  --mem size         Data space limit, e.g. 256M (FIFTH_MEM; default %zuM)\n",
+                   (size_t)MEM_SIZE_DEFAULT >> 20);
+            printf("  --dict n           Dictionary entry limit (FIFTH_DICT; default %d)\n",
+                   DICT_SIZE_DEFAULT);
+            printf("  --profile          Report calls and time per word on stderr at exit\n");
+            printf("  --profile-sample[=hz]  Sample stacks (default 997 Hz); report and folded stacks\n");
+            printf("  --profile-out path Folded stacks file (default fifth.folded)\n");
+            printf("  --jit[=calls]      Native code for colon words called this often (default 10)\n");
+            printf("  --jobs n job.fs ...  Run each job on a clone, n at once, output in order\n");
+            printf("  --serve socket     Then run scripts sent to this Unix socket, on warm clones\n");
+            printf("  --workers n        Requests served at once (default: processors)\n");
+            printf("  --connect socket   Send script.fs and its arguments to a server, print its output\n");
+            printf("  -h                 Show this help\n");
             printf("\n");
             printf("With no arguments, starts interactive REPL.\n");
             vm->running = false;
@@ -87,11 +248,20 @@ int main(int argc, char **argv) {
                 strncpy(path, argv[i], sizeof(path) - 1);
             }
             path[sizeof(path) - 1] = '\0';
+            if (end < argc) {            /* This file, then what follows -- */
+                argv[end] = argv[i];
+                vm_set_args(vm, argc - end, argv + end);
+            } else if (interactive) {    /* The first script and what follows */
+                vm_set_args(vm, argc - i, argv + i);
+            }
+            vm_require_mark(vm, path);   /* REQUIRE of it later is a no-op */
             vm_load_file(vm, path);
             interactive = false;
         }
     }
 
+    if (serve && vm->running && vm_serve(vm, serve, workers) != 0) vm->exit_code = 1;
+
     /* Interactive REPL if no files were loaded */
     if (interactive && vm->running) {
         printf("Fifth Engine v0.1.0\n");
@@ -99,6 +269,7 @@ int main(int argc, char **argv) {
         vm_repl(vm);
     }
 
+    vm_profile_report(vm);
     int code = vm->exit_code;
     vm_destroy(vm);
     return code;
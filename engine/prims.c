@@ -6,6 +6,12 @@
 
 #include "fifth.h"
 #include <ctype.h>
+#include <strings.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 /* ============================================================
  * Stack Operations
@@ -93,7 +99,15 @@ static void p_pstore(vm_t *vm) { cell_t addr = pop(vm); cell_t val = pop(vm);
                                  mem_store(vm, addr, mem_fetch(vm, addr) + val); }
 
 static void p_here(vm_t *vm)  { push(vm, vm->here); }
-static void p_allot(vm_t *vm) { vm->here += pop(vm); }
+/* ALLOT ( n -- ) Pages are committed as they are touched (region.c) */
+static void p_allot(vm_t *vm) {
+    cell_t n = pop(vm);
+    if (n > 0 && (ucell_t)(vm->here + n) > vm_mem_size) {
+        vm_abort(vm, "ALLOT: data space full");
+        return;
+    }
+    vm->here += n;
+}
 static void p_cells(vm_t *vm) { *vm->sp *= sizeof(cell_t); }
 static void p_cell_plus(vm_t *vm) { *vm->sp += sizeof(cell_t); }
 
@@ -145,30 +159,79 @@ static void p_colon(vm_t *vm) {
     char name[NAME_MAX_LEN + 1];
     int len = vm_word(vm, name);
     if (len == 0) { vm_abort(vm, ": requires a name"); return; }
+    if (vm->dict_count >= vm_dict_size) { vm_abort(vm, "Dictionary full"); return; }
 
     int idx = vm->dict_count++;
-    vm->dict[idx].link = vm->latest;
-    vm->dict[idx].flags = (uint8_t)len | F_HIDDEN;
-    memcpy(vm->dict[idx].name, name, len);
-    vm->dict[idx].name[len] = '\0';
+    vm->heads[idx].link = vm->latest;
+    vm->heads[idx].flags = (uint8_t)len | F_HIDDEN;
+    vm->heads[idx].attrs = 0;
+    memcpy(vm->heads[idx].name, name, len);
+    vm->heads[idx].name[len] = '\0';
     vm->dict[idx].code = docol;
     vm->here = vm_align(vm->here);
     vm->dict[idx].param = vm->here;
     vm->dict[idx].does = -1;
     vm->latest = idx;
+    vm_hash_insert(vm, idx);
     vm->state = -1; /* compile mode */
+    vm_peep_barrier(vm);
+    memset(vm->fusion_hits, 0, sizeof(vm->fusion_hits));
+    vm->join_hits = 0;
+}
+
+/* Report the fusions that fired in the definition just finished */
+static void report_fusions(vm_t *vm) {
+    bool any = false;
+    for (int r = 0; r < vm->fusion_count; r++) {
+        if (!vm->fusion_hits[r]) continue;
+        if (!any) fprintf(stderr, "fused %s:", vm->heads[vm->latest].name);
+        fprintf(stderr, " %s", vm->fusions[r].name);
+        if (vm->fusion_hits[r] > 1) fprintf(stderr, " x%d", vm->fusion_hits[r]);
+        any = true;
+    }
+    if (vm->join_hits) {
+        if (!any) fprintf(stderr, "fused %s:", vm->heads[vm->latest].name);
+        fprintf(stderr, " (s\")-join");
+        if (vm->join_hits > 1) fprintf(stderr, " x%d", vm->join_hits);
+        any = true;
+    }
+    if (any) fputc('\n', stderr);
+}
+
+/* Tail calls. When a definition ends in a call to a colon definition,
+ * ; and EXIT turn that call into (tailcall) with the callee's body
+ * inline: a jump, so the callee returns straight to our caller and tail
+ * recursion runs in constant return stack. THENs that landed after the
+ * call are moved onto an (exit) compiled behind it; any other label
+ * there keeps the plain call. */
+static bool compile_tailcall(vm_t *vm) {
+    cell_t at = vm->tail_at;
+    if (vm->tail_nrefs < 0 || at <= 0 || at + (cell_t)sizeof(cell_t) != vm->here) return false;
+    int xt = vm_cell_to_xt(mem_fetch(vm, at));
+    if (xt < 0 || xt >= vm->dict_count || vm->dict[xt].code != docol) return false;
+    int nrefs = vm->tail_nrefs;
+    mem_store(vm, at, vm_xt_to_cell(vm->xt_tailcall));
+    vm_compile_cell(vm, vm->dict[xt].param);
+    vm_peep_barrier(vm);
+    if (nrefs > 0) {
+        for (int i = 0; i < nrefs; i++) mem_store(vm, vm->tail_refs[i], vm->here);
+        vm_compile_xt(vm, vm->xt_exit);
+    }
+    return true;
 }
 
 /* ; ( -- ) End colon definition (IMMEDIATE) */
 static void p_semicolon(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_exit);
-    vm->dict[vm->latest].flags &= ~F_HIDDEN;
+    if (!compile_tailcall(vm)) vm_compile_xt(vm, vm->xt_exit);
+    vm->heads[vm->latest].flags &= ~F_HIDDEN;
     vm->state = 0;
+    vm_peep_barrier(vm);
+    if (vm->trace_fusions) report_fusions(vm);
 }
 
 /* IMMEDIATE ( -- ) Mark latest word as immediate */
 static void p_immediate(vm_t *vm) {
-    vm->dict[vm->latest].flags |= F_IMMEDIATE;
+    vm->heads[vm->latest].flags |= F_IMMEDIATE;
 }
 
 /* [ ( -- ) Switch to interpret mode (IMMEDIATE) */
@@ -208,7 +271,7 @@ static void p_bracket_tick(vm_t *vm) {
         vm_abort(vm, "['] cannot find word");
         return;
     }
-    vm_compile_cell(vm, vm->xt_lit);
+    vm_compile_xt(vm, vm->xt_lit);
     vm_compile_cell(vm, xt);
 }
 
@@ -229,17 +292,20 @@ static void p_create(vm_t *vm) {
     char name[NAME_MAX_LEN + 1];
     int len = vm_word(vm, name);
     if (len == 0) { vm_abort(vm, "CREATE requires a name"); return; }
+    if (vm->dict_count >= vm_dict_size) { vm_abort(vm, "Dictionary full"); return; }
 
     int idx = vm->dict_count++;
-    vm->dict[idx].link = vm->latest;
-    vm->dict[idx].flags = (uint8_t)len;
-    memcpy(vm->dict[idx].name, name, len);
-    vm->dict[idx].name[len] = '\0';
+    vm->heads[idx].link = vm->latest;
+    vm->heads[idx].flags = (uint8_t)len;
+    vm->heads[idx].attrs = 0;
+    memcpy(vm->heads[idx].name, name, len);
+    vm->heads[idx].name[len] = '\0';
     vm->dict[idx].code = dovar;
     vm->here = vm_align(vm->here);
     vm->dict[idx].param = vm->here;
     vm->dict[idx].does = -1;
     vm->latest = idx;
+    vm_hash_insert(vm, idx);
 }
 
 /* FIND ( addr u -- xt 1 | xt -1 | addr u 0 ) */
@@ -254,7 +320,7 @@ static void p_find(vm_t *vm) {
     int xt = vm_find(vm, name, n);
     if (xt >= 0) {
         push(vm, xt);
-        push(vm, (vm->dict[xt].flags & F_IMMEDIATE) ? 1 : -1);
+        push(vm, (vm->heads[xt].flags & F_IMMEDIATE) ? 1 : -1);
     } else {
         push(vm, addr);
         push(vm, len);
@@ -264,13 +330,13 @@ static void p_find(vm_t *vm) {
 
 /* LITERAL ( x -- ) Compile top of stack as literal (IMMEDIATE) */
 static void p_literal(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_lit);
+    vm_compile_xt(vm, vm->xt_lit);
     vm_compile_cell(vm, pop(vm));
 }
 
 /* COMPILE, ( xt -- ) Compile an XT into current definition */
 static void p_compile_comma(vm_t *vm) {
-    vm_compile_cell(vm, pop(vm));
+    vm_compile_xt(vm, (int)pop(vm));
 }
 
 /* POSTPONE ( "name" -- ) Compile semantics of next word (IMMEDIATE) */
@@ -280,15 +346,15 @@ static void p_postpone(vm_t *vm) {
     int xt = vm_find(vm, name, len);
     if (xt < 0) { vm_abort(vm, "POSTPONE: word not found"); return; }
 
-    if (vm->dict[xt].flags & F_IMMEDIATE) {
+    if (vm->heads[xt].flags & F_IMMEDIATE) {
         /* Immediate: compile directly */
-        vm_compile_cell(vm, xt);
+        vm_compile_xt(vm, xt);
     } else {
         /* Non-immediate: compile code to compile it */
-        vm_compile_cell(vm, vm->xt_lit);
+        vm_compile_xt(vm, vm->xt_lit);
         vm_compile_cell(vm, xt);
         int cc = vm_find(vm, "compile,", 8);
-        vm_compile_cell(vm, cc);
+        vm_compile_xt(vm, cc);
     }
 }
 
@@ -326,7 +392,8 @@ static void p_does_runtime(vm_t *vm) {
 
 /* DOES> -- compile-time: compile (does>) into current definition */
 static void p_does_compile(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_does);
+    vm_compile_xt(vm, vm->xt_does);
+    vm_peep_barrier(vm); /* DOES> body starts here */
 }
 
 /* (s") -- runtime: push inline string address and length */
@@ -339,36 +406,259 @@ static void p_slit(vm_t *vm) {
     vm->ip += vm_align(len);
 }
 
+/* ============================================================
+ * Superinstructions
+ *
+ * vm_compile_xt() keeps the start offsets of the last two instructions
+ * of the definition being compiled. When the word being compiled
+ * completes one of the sequences below, the earlier cells are rewritten
+ * in place as a single fused primitive, saving one or two dispatches.
+ * Control-flow words call vm_peep_barrier() wherever a branch target
+ * lands, so a fusion never swallows a label.
+ * ============================================================ */
+
+/* (lit+) -- (lit) n + */
+static void p_lit_plus(vm_t *vm) { *vm->sp += vm_fetch_ip(vm); }
+
+/* (over@) -- over @ */
+static void p_over_fetch(vm_t *vm) { push(vm, mem_fetch(vm, vm->sp[1])); }
+
+/* (dup0branch) -- dup (0branch): keep x, branch if it is zero */
+static void p_dup_0branch(vm_t *vm) {
+    cell_t dest = vm_fetch_ip(vm);
+    if (tos(vm) == 0) vm->ip = dest;
+}
+
+/* (0=branch) -- 0= (0branch): branch if x is nonzero */
+static void p_0eq_branch(vm_t *vm) {
+    cell_t dest = vm_fetch_ip(vm);
+    if (pop(vm) != 0) vm->ip = dest;
+}
+
+/* (r@+) -- r@ + and i + */
+static void p_r_fetch_plus(vm_t *vm) { *vm->sp += rtos(vm); }
+
+/* (i-cell+) -- i cells + */
+static void p_i_cells_plus(vm_t *vm) { *vm->sp += rtos(vm) * (cell_t)sizeof(cell_t); }
+
+static const struct {
+    const char *name;
+    prim_fn     fn;
+    const char *seq[3];
+    bool        operand;
+} fusion_table[] = {
+    /* Three-word sequences first, so they win over their two-word tails */
+    { "(i-cell+)",    p_i_cells_plus, { "i", "cells", "+" }, false },
+    { "(lit+)",       p_lit_plus,     { "(lit)", "+" },      true  },
+    { "(over@)",      p_over_fetch,   { "over", "@" },       false },
+    { "(dup0branch)", p_dup_0branch,  { "dup", "(0branch)" },false },
+    { "(0=branch)",   p_0eq_branch,   { "0=", "(0branch)" }, false },
+    { "(r@+)",        p_r_fetch_plus, { "r@", "+" },         false },
+    { "(r@+)",        p_r_fetch_plus, { "i", "+" },          false },
+};
+
+/* Oldest entry with this name: the primitive itself, even when a loaded
+ * image has since redefined the word. */
+static int find_prim(vm_t *vm, const char *name) {
+    int len = strlen(name);
+    for (int i = 0; i < vm->dict_count; i++) {
+        if ((vm->heads[i].flags & F_LENMASK) == len &&
+            strncasecmp(vm->heads[i].name, name, len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Register the fused primitives and resolve each rule to XTs.
+ * Also run after loading an image, whose XTs may differ. */
+void fusions_init(vm_t *vm) {
+    int n = (int)(sizeof(fusion_table) / sizeof(fusion_table[0]));
+    for (int r = 0; r < n && r < MAX_FUSIONS; r++) {
+        fusion_rule_t *f = &vm->fusions[r];
+        f->name = fusion_table[r].name;
+        f->fused = find_prim(vm, f->name);
+        if (f->fused < 0)
+            f->fused = vm_add_prim(vm, f->name, fusion_table[r].fn, false);
+        f->operand = fusion_table[r].operand;
+        f->len = 0;
+        for (int k = 0; k < 3 && fusion_table[r].seq[k]; k++)
+            f->seq[f->len++] = find_prim(vm, fusion_table[r].seq[k]);
+        vm->fusion_count = r + 1;
+    }
+    vm_peep_barrier(vm);
+}
+
+/* Try to fold xt into the instructions just compiled. Returns true if
+ * the sequence was rewritten and xt needs no cell of its own. */
+static bool try_fuse(vm_t *vm, int xt) {
+    const cell_t cs = sizeof(cell_t);
+    for (int r = 0; r < vm->fusion_count; r++) {
+        fusion_rule_t *f = &vm->fusions[r];
+        if (f->seq[f->len - 1] != xt) continue;
+
+        cell_t first = (f->len == 3) ? vm->peep_prev : vm->peep_last;
+        if (first < 0) continue;
+        if (f->len == 3 && vm->peep_last != first + cs) continue;
+
+        /* The earlier words must be exactly the cells up to HERE */
+        cell_t first_size = f->operand ? 2 * cs : cs;
+        if (first + first_size + (f->len - 2) * cs != vm->here) continue;
+
+        bool match = true;
+        cell_t at = first;
+        for (int k = 0; k < f->len - 1 && match; k++) {
+            match = mem_fetch(vm, at) == vm_xt_to_cell(f->seq[k]);
+            at += (k == 0) ? first_size : cs;
+        }
+        if (!match) continue;
+
+        mem_store(vm, first, vm_xt_to_cell(f->fused));
+        vm->here = first + first_size;
+        vm->peep_last = first;
+        vm->peep_prev = -1;
+        vm->fusion_hits[r]++;
+        return true;
+    }
+    return false;
+}
+
+/* ============================================================
+ * Literal joining
+ *
+ * A sink (A_SINK, set by COALESCING) is a word ( addr u -- ) that just
+ * writes the bytes out, like TYPE or lib/html.fs's h>>. Two calls of
+ * the same sink on adjacent string literals write what one call on the
+ * joined string would, so
+ *
+ *     s" <div" h>> s" >" h>>     compiles as     s" <div>" h>>
+ *
+ * and a static page skeleton goes out in a few large writes. A call to
+ * a colon word whose whole body is one such pair (  : >t s" >" h>> ;  )
+ * is compiled as that pair, so it joins too.
+ * ============================================================ */
+
+static bool is_sink(vm_t *vm, int xt) {
+    return xt >= 0 && xt < vm->dict_count && (vm->heads[xt].attrs & A_SINK);
+}
+
+/* End of the (s") instruction at at, or -1 if at is not one */
+static cell_t slit_end(vm_t *vm, cell_t at) {
+    if (at < 0 || mem_fetch(vm, at) != vm_xt_to_cell(vm->xt_slit)) return -1;
+    cell_t len = mem_fetch(vm, at + (cell_t)sizeof(cell_t));
+    return len < 0 ? -1 : at + 2 * (cell_t)sizeof(cell_t) + vm_align(len);
+}
+
+/* Compiling sink xt right after a literal: append the literal to the
+ * one before the previous call of xt, if that is all that lies between */
+static void try_join(vm_t *vm, int xt) {
+    const cell_t cs = sizeof(cell_t);
+    cell_t s2 = vm->peep_last, s1 = vm->join_at;
+    if (s1 < 0 || slit_end(vm, s2) != vm->here) return;
+    cell_t w1 = slit_end(vm, s1);
+    if (w1 < 0 || w1 + cs != s2 || vm->peep_prev != w1 ||
+        mem_fetch(vm, w1) != vm_xt_to_cell(xt))
+        return;
+    cell_t len1 = mem_fetch(vm, s1 + cs);
+    cell_t len2 = mem_fetch(vm, s2 + cs);
+    memmove(vm->mem + s1 + 2 * cs + len1, vm->mem + s2 + 2 * cs, (size_t)len2);
+    mem_store(vm, s1 + cs, len1 + len2);
+    vm->here = s1 + 2 * cs + vm_align(len1 + len2);
+    vm->peep_last = s1;
+    vm->peep_prev = -1;
+    vm->join_hits++;
+}
+
+/* A call of a colon word that is just  s" ..." sink ;  compiled as its
+ * body. Returns true if xt was inlined. */
+static bool inline_literal_sink(vm_t *vm, int xt) {
+    const cell_t cs = sizeof(cell_t);
+    dict_entry_t *d = &vm->dict[xt];
+    if (d->code != docol || d->does >= 0 || (vm->heads[xt].flags & F_HIDDEN)) return false;
+    cell_t body = d->param;
+    cell_t at = slit_end(vm, body);
+    if (at < 0 || at + 2 * cs > vm->here) return false;
+    cell_t c = mem_fetch(vm, at), arg = mem_fetch(vm, at + cs);
+    int sink = -1;
+    if (c == vm_xt_to_cell(vm->xt_tailcall)) {
+        for (int i = vm->dict_count - 1; i >= 0 && sink < 0; i--)
+            if (vm->dict[i].code == docol && vm->dict[i].param == arg && is_sink(vm, i)) sink = i;
+    } else if (arg == vm_xt_to_cell(vm->xt_exit)) {
+        sink = vm_cell_to_xt(c);
+    }
+    if (!is_sink(vm, sink)) return false;
+
+    cell_t len = mem_fetch(vm, body + cs);
+    vm_compile_xt(vm, vm->xt_slit);
+    vm_compile_cell(vm, len);
+    memcpy(vm->mem + vm->here, vm->mem + body + 2 * cs, (size_t)len);
+    vm->here += vm_align(len);
+    vm_compile_xt(vm, sink);
+    return true;
+}
+
+void vm_compile_xt(vm_t *vm, int xt) {
+    bool sink = is_sink(vm, xt);
+    if (!sink && vm->state && inline_literal_sink(vm, xt)) return;
+    if (try_fuse(vm, xt)) {
+        vm->tail_at = -1;
+        return;
+    }
+    if (sink) try_join(vm, xt);
+    vm->tail_at = vm->here;
+    vm->tail_nrefs = 0;
+    vm->peep_prev = vm->peep_last;
+    vm->peep_last = vm->here;
+    if (sink) vm->join_at = slit_end(vm, vm->peep_prev) == vm->here ? vm->peep_prev : -1;
+    vm_compile_cell(vm, vm_xt_to_cell(xt));
+}
+
+/* COALESCING ( -- ) Mark the latest word a sink ( addr u -- ): calls
+ * on adjacent string literals may be joined into one */
+static void p_coalescing(vm_t *vm) {
+    vm->heads[vm->latest].attrs |= A_SINK;
+}
+
+/* TRACE-FUSIONS ( flag -- ) Report fusions fired as each ; completes */
+static void p_trace_fusions(vm_t *vm) { vm->trace_fusions = pop(vm) != 0; }
+
 /* ============================================================
  * Control Flow (IMMEDIATE compile-time words)
  * ============================================================ */
 
 /* IF ( -- fwd ) */
 static void p_if(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_0branch);
+    vm_compile_xt(vm, vm->xt_0branch);
     push(vm, vm->here);
     vm_compile_cell(vm, 0); /* placeholder */
 }
 
 /* ELSE ( fwd1 -- fwd2 ) */
 static void p_else(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_branch);
+    vm_compile_xt(vm, vm->xt_branch);
     cell_t fwd2 = vm->here;
     vm_compile_cell(vm, 0); /* placeholder */
     /* Resolve IF's forward ref */
     cell_t fwd1 = pop(vm);
     mem_store(vm, fwd1, vm->here);
+    vm_peep_barrier(vm);
     push(vm, fwd2);
 }
 
 /* THEN ( fwd -- ) */
 static void p_then(vm_t *vm) {
     cell_t fwd = pop(vm);
+    int n = vm->tail_nrefs;
     mem_store(vm, fwd, vm->here);
+    vm_peep_barrier(vm);
+    if (n >= 0 && n < (int)(sizeof(vm->tail_refs) / sizeof(cell_t))) {
+        vm->tail_refs[n] = fwd;             /* compile_tailcall may move it */
+        vm->tail_nrefs = n + 1;
+    }
 }
 
 /* BEGIN ( -- back ) */
 static void p_begin(vm_t *vm) {
+    vm_peep_barrier(vm);
     push(vm, vm->here);
 }
 
@@ -376,22 +666,23 @@ static void p_begin(vm_t *vm) {
 static void p_repeat(vm_t *vm) {
     cell_t back = pop(vm);
     cell_t orig = pop(vm);
-    vm_compile_cell(vm, vm->xt_branch);
+    vm_compile_xt(vm, vm->xt_branch);
     vm_compile_cell(vm, back);
     mem_store(vm, orig, vm->here);
+    vm_peep_barrier(vm);
 }
 
 /* UNTIL ( back -- ) */
 static void p_until(vm_t *vm) {
     cell_t back = pop(vm);
-    vm_compile_cell(vm, vm->xt_0branch);
+    vm_compile_xt(vm, vm->xt_0branch);
     vm_compile_cell(vm, back);
 }
 
 /* AGAIN ( back -- ) */
 static void p_again(vm_t *vm) {
     cell_t back = pop(vm);
-    vm_compile_cell(vm, vm->xt_branch);
+    vm_compile_xt(vm, vm->xt_branch);
     vm_compile_cell(vm, back);
 }
 
@@ -456,16 +747,18 @@ static void p_ploop_rt(vm_t *vm) {
 
 /* DO ( -- orig back ) */
 static void p_do_compile(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_do);
+    vm_compile_xt(vm, vm->xt_do);
+    vm_peep_barrier(vm);
     push(vm, 0); /* no forward ref for DO (only ?DO needs one) */
     push(vm, vm->here); /* back ref for LOOP */
 }
 
 /* ?DO ( -- orig back ) */
 static void p_qdo_compile(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_qdo);
+    vm_compile_xt(vm, vm->xt_qdo);
     cell_t orig = vm->here;
     vm_compile_cell(vm, 0); /* placeholder for skip-past-loop */
+    vm_peep_barrier(vm);
     push(vm, orig);
     push(vm, vm->here); /* back ref for LOOP */
 }
@@ -474,18 +767,20 @@ static void p_qdo_compile(vm_t *vm) {
 static void p_loop_compile(vm_t *vm) {
     cell_t back = pop(vm);
     cell_t orig = pop(vm);
-    vm_compile_cell(vm, vm->xt_loop);
+    vm_compile_xt(vm, vm->xt_loop);
     vm_compile_cell(vm, back);
     if (orig) mem_store(vm, orig, vm->here); /* resolve ?DO forward */
+    vm_peep_barrier(vm);
 }
 
 /* +LOOP ( orig back -- ) */
 static void p_ploop_compile(vm_t *vm) {
     cell_t back = pop(vm);
     cell_t orig = pop(vm);
-    vm_compile_cell(vm, vm->xt_ploop);
+    vm_compile_xt(vm, vm->xt_ploop);
     vm_compile_cell(vm, back);
     if (orig) mem_store(vm, orig, vm->here);
+    vm_peep_barrier(vm);
 }
 
 /* I ( -- index ) */
@@ -494,6 +789,9 @@ static void p_i(vm_t *vm) { push(vm, *vm->rsp); }
 /* J ( -- index ) Outer loop index */
 static void p_j(vm_t *vm) { push(vm, vm->rsp[2]); }
 
+/* K ( -- index ) Third loop index out */
+static void p_k(vm_t *vm) { push(vm, vm->rsp[4]); }
+
 /* UNLOOP ( -- ) R: ( limit index -- ) */
 static void p_unloop(vm_t *vm) { rpop(vm); rpop(vm); }
 
@@ -509,35 +807,37 @@ static void p_of(vm_t *vm) {
     int xt_over = vm_find(vm, "over", 4);
     int xt_eq = vm_find(vm, "=", 1);
     int xt_drop = vm_find(vm, "drop", 4);
-    vm_compile_cell(vm, xt_over);
-    vm_compile_cell(vm, xt_eq);
-    vm_compile_cell(vm, vm->xt_0branch);
+    vm_compile_xt(vm, xt_over);
+    vm_compile_xt(vm, xt_eq);
+    vm_compile_xt(vm, vm->xt_0branch);
     cell_t orig = vm->here;
     vm_compile_cell(vm, 0); /* placeholder */
-    vm_compile_cell(vm, xt_drop);
+    vm_compile_xt(vm, xt_drop);
     push(vm, orig);
 }
 
 /* ENDOF ( orig -- fwd ) compile: BRANCH fwd; resolve OF */
 static void p_endof(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_branch);
+    vm_compile_xt(vm, vm->xt_branch);
     cell_t fwd = vm->here;
     vm_compile_cell(vm, 0); /* placeholder */
     cell_t orig = pop(vm);
     mem_store(vm, orig, vm->here); /* resolve OF's 0branch */
+    vm_peep_barrier(vm);
     push(vm, fwd); /* push for ENDCASE to resolve */
 }
 
 /* ENDCASE ( 0 fwd... -- ) compile: DROP; resolve all ENDOF branches */
 static void p_endcase(vm_t *vm) {
     int xt_drop = vm_find(vm, "drop", 4);
-    vm_compile_cell(vm, xt_drop);
+    vm_compile_xt(vm, xt_drop);
     /* Resolve all ENDOF forward refs until we hit the sentinel 0 */
     while (tos(vm) != 0) {
         cell_t fwd = pop(vm);
         mem_store(vm, fwd, vm->here);
     }
     pop(vm); /* remove sentinel */
+    vm_peep_barrier(vm);
 }
 
 /* ============================================================
@@ -551,7 +851,7 @@ static void p_s_quote(vm_t *vm) {
 
     if (vm->state) {
         /* Compile: (s") len bytes... */
-        vm_compile_cell(vm, vm->xt_slit);
+        vm_compile_xt(vm, vm->xt_slit);
         vm_compile_cell(vm, len);
         memcpy(vm->mem + vm->here, buf, len);
         vm->here += vm_align(len);
@@ -559,8 +859,9 @@ static void p_s_quote(vm_t *vm) {
         /* Interpret: copy to pad, push */
         memcpy(vm->pad, buf, len);
         vm->pad[len] = '\0';
-        /* Store in mem[] at a scratch area so @ works */
-        cell_t addr = vm->here; /* Use space above HERE temporarily */
+        /* Keep it in string space, clear of HERE (arena.c) */
+        cell_t addr = vm_string_alloc(vm, (size_t)len);
+        if (addr < 0) return;
         memcpy(vm->mem + addr, buf, len);
         push(vm, addr);
         push(vm, (cell_t)len);
@@ -602,12 +903,13 @@ static void p_s_bs_quote(vm_t *vm) {
     }
 
     if (vm->state) {
-        vm_compile_cell(vm, vm->xt_slit);
+        vm_compile_xt(vm, vm->xt_slit);
         vm_compile_cell(vm, len);
         memcpy(vm->mem + vm->here, buf, len);
         vm->here += vm_align(len);
     } else {
-        cell_t addr = vm->here;
+        cell_t addr = vm_string_alloc(vm, (size_t)len);
+        if (addr < 0) return;
         memcpy(vm->mem + addr, buf, len);
         push(vm, addr);
         push(vm, (cell_t)len);
@@ -620,7 +922,7 @@ static void p_bracket_char(vm_t *vm) {
     int len = vm_word(vm, buf);
     if (len == 0) { vm_abort(vm, "[CHAR] needs a character"); return; }
     if (vm->state) {
-        vm_compile_cell(vm, vm->xt_lit);
+        vm_compile_xt(vm, vm->xt_lit);
         vm_compile_cell(vm, (cell_t)buf[0]);
     } else {
         push(vm, (cell_t)buf[0]);
@@ -647,29 +949,172 @@ static void p_parse_name(vm_t *vm) {
     push(vm, (cell_t)len);
 }
 
+/* ============================================================
+ * String Kernels
+ *
+ * Whole-string scans for lib/str.fs, which used to walk rows and
+ * templates a byte at a time with c@. Single bytes go to memchr and
+ * memcmp, which libc vectorizes; a set of up to 8 bytes is matched 16
+ * at a time with SSE2 or NEON, and through a byte table otherwise.
+ * ============================================================ */
+
+void vm_byteset_init(vm_byteset_t *s, const uint8_t *bytes, int n) {
+    memset(s->in, 0, sizeof(s->in));
+    for (int i = 0; i < n; i++) s->in[bytes[i]] = 1;
+    s->bytes = bytes;
+    s->n = n;
+}
+
+/* Offset of the first byte of p[0..n) in the set, or n */
+size_t vm_byteset_scan(const vm_byteset_t *s, const uint8_t *p, size_t n) {
+    if (s->n == 1) {
+        const uint8_t *q = memchr(p, s->bytes[0], n);
+        return q ? (size_t)(q - p) : n;
+    }
+    size_t i = 0;
+#if defined(__SSE2__)
+    if (s->n <= 8) {
+        __m128i d[8];
+        for (int k = 0; k < s->n; k++) d[k] = _mm_set1_epi8((char)s->bytes[k]);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+            __m128i m = _mm_cmpeq_epi8(v, d[0]);
+            for (int k = 1; k < s->n; k++) m = _mm_or_si128(m, _mm_cmpeq_epi8(v, d[k]));
+            int bits = _mm_movemask_epi8(m);
+            if (bits) return i + (size_t)__builtin_ctz((unsigned)bits);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (s->n <= 8) {
+        uint8x16_t d[8];
+        for (int k = 0; k < s->n; k++) d[k] = vdupq_n_u8(s->bytes[k]);
+        for (; i + 16 <= n; i += 16) {
+            uint8x16_t v = vld1q_u8(p + i);
+            uint8x16_t m = vceqq_u8(v, d[0]);
+            for (int k = 1; k < s->n; k++) m = vorrq_u8(m, vceqq_u8(v, d[k]));
+            if (vmaxvq_u8(m)) break;     /* The table finds it within 16 */
+        }
+    }
+#endif
+    for (; i < n; i++)
+        if (s->in[p[i]]) return i;
+    return n;
+}
+
+/* SCAN-CHAR ( addr u c -- addr' u' ) Rest of the string from the first
+ * c, or addr+u 0 when there is none */
+static void p_scan_char(vm_t *vm) {
+    uint8_t c = (uint8_t)pop(vm);
+    cell_t u = pop(vm);
+    cell_t addr = pop(vm);
+    const uint8_t *p = vm->mem + addr;
+    const uint8_t *q = u > 0 ? memchr(p, c, (size_t)u) : NULL;
+    cell_t off = q ? (cell_t)(q - p) : (u > 0 ? u : 0);
+    push(vm, addr + off);
+    push(vm, u > off ? u - off : 0);
+}
+
+/* COMPARE ( addr1 u1 addr2 u2 -- n ) -1, 0 or 1, as unsigned bytes */
+static void p_compare(vm_t *vm) {
+    cell_t u2 = pop(vm);
+    cell_t a2 = pop(vm);
+    cell_t u1 = pop(vm);
+    cell_t a1 = pop(vm);
+    cell_t n = u1 < u2 ? u1 : u2;
+    int r = n > 0 ? memcmp(vm->mem + a1, vm->mem + a2, (size_t)n) : 0;
+    if (r == 0) r = (u1 > u2) - (u1 < u2);
+    push(vm, r < 0 ? -1 : r > 0);
+}
+
+/* SEARCH ( addr1 u1 addr2 u2 -- addr3 u3 flag ) Find the second string
+ * in the first: the rest from the match and true, or addr1 u1 false */
+static void p_search(vm_t *vm) {
+    cell_t u2 = pop(vm);
+    cell_t a2 = pop(vm);
+    cell_t u1 = pop(vm);
+    cell_t a1 = pop(vm);
+    const uint8_t *hay = vm->mem + a1, *needle = vm->mem + a2;
+    if (u2 <= 0) {
+        push(vm, a1); push(vm, u1); push(vm, -1);
+        return;
+    }
+    const uint8_t *p = hay;
+    const uint8_t *last = hay + u1 - u2;     /* Last possible start */
+    while (u1 >= u2 && p <= last) {
+        p = memchr(p, needle[0], (size_t)(last - p) + 1);
+        if (!p) break;
+        if (memcmp(p + 1, needle + 1, (size_t)u2 - 1) == 0) {
+            push(vm, a1 + (cell_t)(p - hay));
+            push(vm, u1 - (cell_t)(p - hay));
+            push(vm, -1);
+            return;
+        }
+        p++;
+    }
+    push(vm, a1); push(vm, u1); push(vm, 0);
+}
+
+/* SPLIT-FIELDS ( addr u delims ndelims fields max -- n ) Split the
+ * string at any of the delimiter bytes in one pass. Stores addr len
+ * cell pairs for the first max fields at fields and returns how many it
+ * stored; n delimiters make n+1 fields, empty ones included. */
+static void p_split_fields(vm_t *vm) {
+    cell_t max = pop(vm);
+    cell_t fields = pop(vm);
+    cell_t nd = pop(vm);
+    cell_t delims = pop(vm);
+    cell_t u = pop(vm);
+    cell_t addr = pop(vm);
+    if (max <= 0 || u < 0 || nd < 0 || nd > 256) {
+        push(vm, 0);
+        return;
+    }
+    vm_byteset_t set;
+    vm_byteset_init(&set, vm->mem + delims, (int)nd);
+
+    const uint8_t *p = vm->mem + addr;
+    size_t len = (size_t)u, at = 0;
+    cell_t n = 0;
+    for (;;) {
+        size_t end = nd ? at + vm_byteset_scan(&set, p + at, len - at) : len;
+        mem_store(vm, fields, addr + (cell_t)at);
+        mem_store(vm, fields + (cell_t)sizeof(cell_t), (cell_t)(end - at));
+        fields += 2 * (cell_t)sizeof(cell_t);
+        if (++n == max || end == len) break;
+        at = end + 1;
+    }
+    push(vm, n);
+}
+
 /* ============================================================
  * Numeric Output
  * ============================================================ */
 
+/* Print n and a space */
+static void print_cell(vm_t *vm, cell_t n) {
+    char buf[32];
+    vm_write(vm, buf, (size_t)snprintf(buf, sizeof(buf), "%ld ", (long)n));
+}
+
 /* . ( n -- ) Print number and space */
 static void p_dot(vm_t *vm) {
-    cell_t n = pop(vm);
-    fprintf(vm->out, "%ld ", (long)n);
+    print_cell(vm, pop(vm));
 }
 
 /* U. ( u -- ) Print unsigned number and space */
 static void p_u_dot(vm_t *vm) {
     ucell_t n = (ucell_t)pop(vm);
-    fprintf(vm->out, "%lu ", (unsigned long)n);
+    char buf[32];
+    vm_write(vm, buf, (size_t)snprintf(buf, sizeof(buf), "%lu ", (unsigned long)n));
 }
 
 /* .S ( -- ) Print stack contents */
 static void p_dot_s(vm_t *vm) {
     int d = depth(vm);
-    fprintf(vm->out, "<%d> ", d);
-    for (int i = d - 1; i >= 0; i--) {
-        fprintf(vm->out, "%ld ", (long)vm->sp[i]);
-    }
+    char buf[32];
+    vm_write(vm, buf, (size_t)snprintf(buf, sizeof(buf), "<%d> ", d));
+    for (int i = d - 1; i >= 0; i--)
+        print_cell(vm, vm->sp[i]);
 }
 
 /* <# ( -- ) Begin pictured numeric output */
@@ -779,8 +1224,8 @@ static void p_noop(vm_t *vm)  { (void)vm; }
 static void p_true(vm_t *vm)  { push(vm, -1); }
 static void p_false(vm_t *vm) { push(vm, 0); }
 static void p_bl(vm_t *vm)    { push(vm, 32); }
-static void p_space(vm_t *vm) { fputc(' ', vm->out); }
-static void p_spaces(vm_t *vm) { cell_t n = pop(vm); while (n-- > 0) fputc(' ', vm->out); }
+static void p_space(vm_t *vm) { vm_emit(vm, ' '); }
+static void p_spaces(vm_t *vm) { cell_t n = pop(vm); while (n-- > 0) vm_emit(vm, ' '); }
 
 static void p_abort(vm_t *vm) { vm_abort(vm, "ABORT called"); }
 static void p_abort_quote(vm_t *vm) {
@@ -789,12 +1234,12 @@ static void p_abort_quote(vm_t *vm) {
     int len = vm_parse(vm, '"', buf);
     /* Compile: IF (s") len msg TYPE ABORT THEN */
     /* Simplified: always compile the test + message */
-    vm_compile_cell(vm, vm->xt_0branch);
+    vm_compile_xt(vm, vm->xt_0branch);
     cell_t fwd = vm->here;
     vm_compile_cell(vm, 0);
 
     /* Compile the string */
-    vm_compile_cell(vm, vm->xt_slit);
+    vm_compile_xt(vm, vm->xt_slit);
     vm_compile_cell(vm, len);
     memcpy(vm->mem + vm->here, buf, len);
     vm->here += vm_align(len);
@@ -802,8 +1247,8 @@ static void p_abort_quote(vm_t *vm) {
     /* Compile TYPE and ABORT */
     int xt_type = vm_find(vm, "type", 4);
     int xt_abort = vm_find(vm, "abort", 5);
-    if (xt_type >= 0) vm_compile_cell(vm, xt_type);
-    if (xt_abort >= 0) vm_compile_cell(vm, xt_abort);
+    if (xt_type >= 0) vm_compile_xt(vm, xt_type);
+    if (xt_abort >= 0) vm_compile_xt(vm, xt_abort);
 
     /* Resolve forward branch (skip if flag was false) */
     /* Wait - ABORT" triggers if flag is TRUE (nonzero).
@@ -812,17 +1257,18 @@ static void p_abort_quote(vm_t *vm) {
      * So if flag is nonzero, 0branch does NOT skip -> we fall through to abort.
      * If flag is 0, 0branch DOES skip -> we jump past abort. Correct. */
     mem_store(vm, fwd, vm->here);
+    vm_peep_barrier(vm);
 }
 
 /* RECURSE ( -- ) Compile a call to the current definition (IMMEDIATE) */
 static void p_recurse(vm_t *vm) {
-    vm_compile_cell(vm, vm->latest);
+    vm_compile_xt(vm, vm->latest);
 }
 
 /* EXIT ( -- ) compile (exit) for user use (IMMEDIATE in compile mode) */
 static void p_user_exit(vm_t *vm) {
-    if (vm->state) {
-        vm_compile_cell(vm, vm->xt_exit);
+    if (vm->state && !compile_tailcall(vm)) {
+        vm_compile_xt(vm, vm->xt_exit);
     }
 }
 
@@ -832,14 +1278,14 @@ static void p_dot_quote(vm_t *vm) {
     int len = vm_parse(vm, '"', buf);
 
     if (vm->state) {
-        vm_compile_cell(vm, vm->xt_slit);
+        vm_compile_xt(vm, vm->xt_slit);
         vm_compile_cell(vm, len);
         memcpy(vm->mem + vm->here, buf, len);
         vm->here += vm_align(len);
         int xt_type = vm_find(vm, "type", 4);
-        if (xt_type >= 0) vm_compile_cell(vm, xt_type);
+        if (xt_type >= 0) vm_compile_xt(vm, xt_type);
     } else {
-        fwrite(buf, 1, len, vm->out);
+        vm_write(vm, buf, (size_t)len);
     }
 }
 
@@ -847,7 +1293,7 @@ static void p_dot_quote(vm_t *vm) {
 static void p_dot_paren(vm_t *vm) {
     char buf[PAD_SIZE];
     int len = vm_parse(vm, ')', buf);
-    fwrite(buf, 1, len, vm->out);
+    vm_write(vm, buf, (size_t)len);
 }
 
 /* ============================================================
@@ -858,7 +1304,7 @@ static void p_dot_paren(vm_t *vm) {
  * Compile 0branch with forward ref, swap so dest is on top for REPEAT
  */
 static void p_while_fixed(vm_t *vm) {
-    vm_compile_cell(vm, vm->xt_0branch);
+    vm_compile_xt(vm, vm->xt_0branch);
     cell_t orig = vm->here;
     vm_compile_cell(vm, 0); /* placeholder */
     cell_t dest = pop(vm); /* the BEGIN address */
@@ -885,6 +1331,7 @@ void prims_init(vm_t *vm) {
     vm->xt_loop   = vm_add_prim(vm, "(loop)",   p_loop_rt,false);
     vm->xt_ploop  = vm_add_prim(vm, "(+loop)",  p_ploop_rt,false);
     vm->xt_does   = vm_add_prim(vm, "(does>)",  p_does_runtime, false);
+    vm->xt_tailcall = vm_add_prim(vm, "(tailcall)", p_branch, false);  /* A jump to the body */
 
     /* Stack */
     vm_add_prim(vm, "dup",    p_dup,    false);
@@ -958,11 +1405,16 @@ void prims_init(vm_t *vm) {
     vm_add_prim(vm, "fill",   p_fill,   false);
     vm_add_prim(vm, "/string",p_slash_string, false);
     vm_add_prim(vm, "count",  p_count,  false);
+    vm_add_prim(vm, "scan-char",   p_scan_char,   false);
+    vm_add_prim(vm, "compare",     p_compare,     false);
+    vm_add_prim(vm, "search",      p_search,      false);
+    vm_add_prim(vm, "split-fields",p_split_fields,false);
 
     /* Compiler */
     vm_add_prim(vm, ":",        p_colon,     false);
     vm_add_prim(vm, ";",        p_semicolon, true);
     vm_add_prim(vm, "immediate",p_immediate, false);
+    vm_add_prim(vm, "coalescing",p_coalescing, false);
     vm_add_prim(vm, "[",        p_lbracket,  true);
     vm_add_prim(vm, "]",        p_rbracket,  false);
     vm_add_prim(vm, "state",    p_state,     false);
@@ -977,6 +1429,7 @@ void prims_init(vm_t *vm) {
     vm_add_prim(vm, "postpone", p_postpone,  true);
     vm_add_prim(vm, "does>",    p_does_compile, true);  /* compile-time: compile (does>) */
     vm_add_prim(vm, "recurse",  p_recurse,   true);
+    vm_add_prim(vm, "trace-fusions", p_trace_fusions, false);
 
     /* Control Flow (IMMEDIATE) */
     vm_add_prim(vm, "if",      p_if,         true);
@@ -993,6 +1446,7 @@ void prims_init(vm_t *vm) {
     vm_add_prim(vm, "+loop",   p_ploop_compile,true);
     vm_add_prim(vm, "i",       p_i,          false);
     vm_add_prim(vm, "j",       p_j,          false);
+    vm_add_prim(vm, "k",       p_k,          false);
     vm_add_prim(vm, "unloop",  p_unloop,     false);
     vm_add_prim(vm, "case",    p_case,       true);
     vm_add_prim(vm, "of",      p_of,         true);
@@ -1036,4 +1490,7 @@ void prims_init(vm_t *vm) {
     /* Number parsing */
     vm_add_prim(vm, "s>number?", p_s_to_number, false);
     vm_add_prim(vm, ">number",   p_to_number,   false);
+
+    /* Superinstructions (needs the words above registered) */
+    fusions_init(vm);
 }
@@ -0,0 +1,431 @@
+/* profile.c - Call counters and a sampling profiler
+ *
+ *   fifth --profile app.fs              Count calls and time per word
+ *   fifth --profile-sample app.fs       Sample the running word ~1000/s
+ *   fifth --profile-sample=4000 --profile-out app.folded app.fs
+ *
+ * Both modes swap vm_run for the portable loop below, which keeps IP,
+ * W and RSP in the VM where the sampler can read them. vm_run tests the
+ * mode once per call, so nothing is paid per instruction when it is off.
+ *
+ * Counters: every dispatch bumps its XT. Time spent in a primitive,
+ * less any nested EXECUTE, is its self time; the self times add up to
+ * the whole run. A colon definition stays on a shadow stack until RSP
+ * rises above the return address docol pushed; that span is its total
+ * time, counted once through recursion. Ticks are TSC cycles on x86,
+ * nanoseconds elsewhere.
+ *
+ * Sampler: SIGPROF on ITIMER_PROF. The handler walks the return stack
+ * of the VM running on that thread and keeps each return address whose
+ * previous cell calls a colon definition: that call is the frame. The
+ * result is a report of self and total samples, and a folded-stack file
+ * ("outer;inner;leaf count") for flamegraph.pl and friends.
+ *
+ * Task VMs keep their own counters and merge them when they finish. The
+ * report, on stderr, is made at exit with the main VM's names.
+ */
+
+#include "fifth.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICK_UNIT "cycles"
+#else
+#define TICK_UNIT "ns"
+#endif
+
+#define PROFILE_TOP     30           /* Rows in the report */
+#define MAX_SAMPLES     65536
+#define SAMPLE_DEPTH    64           /* Innermost frames a sample keeps */
+
+int vm_profile_mode;
+
+typedef struct {
+    uint64_t     calls, self, total;
+    uint32_t     active;             /* Activations on the shadow stack */
+} prof_count_t;
+
+typedef struct {
+    int          xt;
+    cell_t      *rsp;                /* RSP just after docol's push */
+    uint64_t     t0;
+} prof_frame_t;
+
+typedef struct {
+    prof_count_t *count;             /* vm_dict_size entries */
+    prof_frame_t frames[RSTACK_SIZE];
+    int          nframes;
+    uint64_t     spent;              /* Ticks accounted so far */
+} prof_t;
+
+typedef struct {
+    int          n;                  /* Frames in xt[], outermost first */
+    int          xt[SAMPLE_DEPTH + 1];  /* Leaf last; -1 = outer interpreter */
+} sample_t;
+
+static prof_count_t   *totals;
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static sample_t       *samples;
+static atomic_uint     sample_count;
+static int             sample_hz;
+static const char     *folded_path = "fifth.folded";
+
+static _Thread_local vm_t *prof_vm;  /* VM running on this thread */
+
+/* Colon definitions entered through vm_execute on this thread. Their
+ * return address is wherever IP was, so the sampler takes the frame
+ * from here when it reaches the slot docol pushed. */
+typedef struct {
+    vm_t        *vm;
+    cell_t      *rsp;
+    int          xt;
+} prof_entry_t;
+
+static _Thread_local prof_entry_t entries[RSTACK_SIZE];
+static _Thread_local volatile int nentries;
+
+static inline uint64_t ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline bool is_colon(prim_fn code) {
+    return code == docol || code == dodoes;
+}
+
+static prof_t *prof_get(vm_t *vm) {
+    if (!vm->prof) {
+        prof_t *p = calloc(1, sizeof(prof_t));
+        if (p && !(p->count = calloc((size_t)vm_dict_size, sizeof(prof_count_t)))) {
+            free(p);
+            p = NULL;
+        }
+        vm->prof = p;
+    }
+    return vm->prof;
+}
+
+/* ============================================================
+ * Counters
+ * ============================================================ */
+
+/* Account one dispatch of xt that ran from t0 to t1 */
+static void note(prof_t *p, vm_t *vm, int xt, prim_fn code, uint64_t t0, uint64_t t1, uint64_t spent0) {
+    prof_count_t *c = &p->count[xt];
+    c->calls++;
+    uint64_t self = (t1 - t0) - (p->spent - spent0);
+    p->spent = spent0 + (t1 - t0);
+    c->self += self;
+    if (is_colon(code)) {
+        if (p->nframes < RSTACK_SIZE) {
+            c->active++;
+            p->frames[p->nframes++] = (prof_frame_t){ xt, vm->rsp, t0 };
+        }
+        return;
+    }
+    c->total += t1 - t0;
+    while (p->nframes && vm->rsp > p->frames[p->nframes - 1].rsp) {
+        prof_frame_t *f = &p->frames[--p->nframes];
+        if (--p->count[f->xt].active == 0) p->count[f->xt].total += t1 - f->t0;
+    }
+}
+
+/* vm_run while profiling: the portable loop, IP and RSP kept in the VM */
+void vm_run_profiled(vm_t *vm) {
+    prof_t *p = (vm_profile_mode & PROFILE_COUNT) ? prof_get(vm) : NULL;
+    vm_t *outer = prof_vm;
+    prof_vm = vm;
+    cell_t *rsp_base = vm->rsp;
+    while (vm->running && vm->rsp <= rsp_base) {
+        int xt = vm_cell_to_xt(vm_fetch_ip(vm));
+        prim_fn code = vm->dict[xt].code;
+        vm->w = xt;
+        if (p) {
+            uint64_t spent0 = p->spent, t0 = ticks();
+            code(vm);
+            note(p, vm, xt, code, t0, ticks(), spent0);
+        } else {
+            code(vm);
+        }
+    }
+    prof_vm = outer;
+}
+
+/* vm_execute while profiling */
+void vm_execute_profiled(vm_t *vm, int xt) {
+    prof_t *p = (vm_profile_mode & PROFILE_COUNT) ? prof_get(vm) : NULL;
+    vm_t *outer = prof_vm;
+    prof_vm = vm;
+    prim_fn code = vm->dict[xt].code;
+    vm->w = xt;
+    uint64_t spent0 = p ? p->spent : 0, t0 = p ? ticks() : 0;
+    code(vm);
+    if (p) note(p, vm, xt, code, t0, ticks(), spent0);
+    if (is_colon(code)) {
+        int e = nentries;
+        if (e < RSTACK_SIZE) {
+            entries[e] = (prof_entry_t){ vm, vm->rsp, xt };
+            atomic_signal_fence(memory_order_release);
+            nentries = e + 1;
+        }
+        vm_run_profiled(vm);
+        nentries = e;
+    }
+    prof_vm = outer;
+}
+
+/* Merge a VM's counters into the totals; at VM release and task end */
+void vm_profile_release(vm_t *vm) {
+    prof_t *p = vm->prof;
+    if (!p) return;
+    vm->prof = NULL;
+    pthread_mutex_lock(&totals_lock);
+    if (totals) {
+        for (int i = 0; i < vm_dict_size; i++) {
+            totals[i].calls += p->count[i].calls;
+            totals[i].self  += p->count[i].self;
+            totals[i].total += p->count[i].total;
+        }
+    }
+    pthread_mutex_unlock(&totals_lock);
+    free(p->count);
+    free(p);
+}
+
+/* ============================================================
+ * Sampler
+ * ============================================================ */
+
+static void on_sigprof(int sig) {
+    (void)sig;
+    unsigned i = atomic_fetch_add_explicit(&sample_count, 1, memory_order_relaxed);
+    if (i >= MAX_SAMPLES) return;
+    sample_t *s = &samples[i];
+    vm_t *vm = prof_vm;
+    if (!vm) {
+        s->xt[0] = -1;
+        s->n = 1;
+        return;
+    }
+
+    /* Innermost first, reversed below */
+    int n = 0;
+    int leaf = (int)vm->w;
+    int e = nentries - 1;
+    cell_t *top = vm->rstack + RSTACK_SIZE;
+    for (cell_t *r = vm->rsp; r >= vm->rstack && r < top && n < SAMPLE_DEPTH; r++) {
+        while (e >= 0 && (entries[e].vm != vm || entries[e].rsp < r)) e--;
+        if (e >= 0 && entries[e].rsp == r) {
+            int xt = entries[e--].xt;
+            if (n > 0 || xt != leaf) s->xt[n++] = xt;
+            continue;
+        }
+        cell_t ret = *r;
+        if (ret < (cell_t)sizeof(cell_t) || ret > vm->here || ret % (cell_t)sizeof(cell_t))
+            continue;
+        cell_t call = *(cell_t *)(vm->mem + ret - sizeof(cell_t));
+        int xt = vm_cell_to_xt(call);
+        if (call < 0 || vm_xt_to_cell(xt) != call || xt >= vm->dict_count ||
+            !is_colon(vm->dict[xt].code))
+            continue;
+        if (n == 0 && xt == leaf) continue;   /* Just entered: leaf is the frame */
+        s->xt[n++] = xt;
+    }
+    for (int a = 0, b = n - 1; a < b; a++, b--) {
+        int t = s->xt[a];
+        s->xt[a] = s->xt[b];
+        s->xt[b] = t;
+    }
+    s->xt[n++] = leaf;
+    s->n = n;
+}
+
+/* ============================================================
+ * Start and report
+ * ============================================================ */
+
+void vm_profile_start(int mode, int hz, const char *out) {
+    if (out) folded_path = out;
+    if ((mode & PROFILE_COUNT) && !(totals = calloc((size_t)vm_dict_size, sizeof(prof_count_t)))) {
+        fprintf(stderr, "Profile: out of memory\n");
+        mode &= ~PROFILE_COUNT;
+    }
+    if ((mode & PROFILE_SAMPLE) && !(samples = malloc(MAX_SAMPLES * sizeof(sample_t)))) {
+        fprintf(stderr, "Profile: out of memory\n");
+        mode &= ~PROFILE_SAMPLE;
+    }
+    if (mode & PROFILE_SAMPLE) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_sigprof;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGPROF, &sa, NULL);
+        sample_hz = hz > 0 ? hz : 997;
+        long us = 1000000L / sample_hz;
+        struct itimerval it = { { 0, us ? us : 1 }, { 0, us ? us : 1 } };
+        setitimer(ITIMER_PROF, &it, NULL);
+    }
+    vm_profile_mode = mode;
+}
+
+static const char *word_name(vm_t *vm, int xt, char *buf, size_t len) {
+    if (xt < 0) return "[interpreter]";
+    if (xt < vm->dict_count && vm->heads[xt].name[0]) return vm->heads[xt].name;
+    snprintf(buf, len, "xt#%d", xt);
+    return buf;
+}
+
+static prof_count_t *sort_rows;
+
+static int by_self(const void *a, const void *b) {
+    const prof_count_t *x = &sort_rows[*(const int *)a], *y = &sort_rows[*(const int *)b];
+    if (x->self != y->self) return x->self < y->self ? 1 : -1;
+    if (x->total != y->total) return x->total < y->total ? 1 : -1;
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Print rows sorted by self, the top PROFILE_TOP of them */
+static void print_rows(vm_t *vm, prof_count_t *rows, bool calls) {
+    int *order = malloc((size_t)vm_dict_size * sizeof(int));
+    if (!order) return;
+    int n = 0;
+    uint64_t sum = 0;
+    for (int i = 0; i < vm_dict_size; i++) {
+        if (rows[i].calls || rows[i].self || rows[i].total) order[n++] = i;
+        sum += rows[i].self;
+    }
+    sort_rows = rows;
+    qsort(order, (size_t)n, sizeof(int), by_self);
+    if (calls) fprintf(stderr, "  self%%  %14s %14s %12s  word\n", "self", "total", "calls");
+    else       fprintf(stderr, "  self%%  %14s %14s  word\n", "self", "total");
+    char buf[32];
+    for (int k = 0; k < n && k < PROFILE_TOP; k++) {
+        prof_count_t *c = &rows[order[k]];
+        double pct = sum ? 100.0 * (double)c->self / (double)sum : 0.0;
+        const char *name = word_name(vm, order[k], buf, sizeof(buf));
+        if (calls)
+            fprintf(stderr, "%6.2f  %14llu %14llu %12llu  %s\n", pct, (unsigned long long)c->self,
+                    (unsigned long long)c->total, (unsigned long long)c->calls, name);
+        else
+            fprintf(stderr, "%6.2f  %14llu %14llu  %s\n", pct, (unsigned long long)c->self,
+                    (unsigned long long)c->total, name);
+    }
+    if (n > PROFILE_TOP) fprintf(stderr, "  (%d more)\n", n - PROFILE_TOP);
+    free(order);
+}
+
+static int by_string(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Folded stacks: one line per distinct stack, "a;b;c count" */
+static void write_folded(vm_t *vm, unsigned n) {
+    FILE *f = fopen(folded_path, "w");
+    if (!f) {
+        fprintf(stderr, "Profile: cannot write %s\n", folded_path);
+        return;
+    }
+    char **lines = calloc(n, sizeof(char *));
+    if (!lines) {
+        fclose(f);
+        return;
+    }
+    char buf[32];
+    for (unsigned i = 0; i < n; i++) {
+        size_t len = 1;
+        for (int k = 0; k < samples[i].n; k++)
+            len += strlen(word_name(vm, samples[i].xt[k], buf, sizeof(buf))) + 1;
+        char *line = malloc(len);
+        if (!line) break;
+        char *q = line;
+        for (int k = 0; k < samples[i].n; k++) {
+            if (k) *q++ = ';';
+            const char *w = word_name(vm, samples[i].xt[k], buf, sizeof(buf));
+            size_t wl = strlen(w);
+            memcpy(q, w, wl);
+            q += wl;
+        }
+        *q = '\0';
+        lines[i] = line;
+    }
+    unsigned m = 0;
+    while (m < n && lines[m]) m++;
+    qsort(lines, m, sizeof(char *), by_string);
+    for (unsigned i = 0; i < m; ) {
+        unsigned j = i;
+        while (j < m && strcmp(lines[i], lines[j]) == 0) j++;
+        fprintf(f, "%s %u\n", lines[i], j - i);
+        i = j;
+    }
+    for (unsigned i = 0; i < n; i++) free(lines[i]);
+    free(lines);
+    fclose(f);
+    fprintf(stderr, "Profile: folded stacks in %s\n", folded_path);
+}
+
+/* Stop sampling, merge the main VM and report on stderr */
+void vm_profile_report(vm_t *vm) {
+    int mode = vm_profile_mode;
+    if (!mode) return;
+    if (mode & PROFILE_SAMPLE) {
+        struct itimerval off = { { 0, 0 }, { 0, 0 } };
+        setitimer(ITIMER_PROF, &off, NULL);
+        signal(SIGPROF, SIG_IGN);
+    }
+    vm_profile_mode = 0;
+    vm_flush(vm);
+
+    if (mode & PROFILE_COUNT) {
+        vm_profile_release(vm);
+        uint64_t calls = 0;
+        for (int i = 0; i < vm_dict_size; i++) calls += totals[i].calls;
+        fprintf(stderr, "Profile: %llu calls, time in %s\n", (unsigned long long)calls, TICK_UNIT);
+        print_rows(vm, totals, true);
+        free(totals);
+        totals = NULL;
+    }
+
+    if (mode & PROFILE_SAMPLE) {
+        unsigned n = atomic_load(&sample_count);
+        if (n > MAX_SAMPLES) n = MAX_SAMPLES;
+        prof_count_t *rows = calloc((size_t)vm_dict_size, sizeof(prof_count_t));
+        unsigned *seen = calloc((size_t)vm_dict_size, sizeof(unsigned));
+        if (rows && seen) {
+            unsigned outer = 0;
+            for (unsigned i = 0; i < n; i++) {
+                sample_t *s = &samples[i];
+                int leaf = s->xt[s->n - 1];
+                if (leaf < 0) {
+                    outer++;
+                    continue;
+                }
+                rows[leaf].self++;
+                for (int k = 0; k < s->n; k++) {
+                    if (seen[s->xt[k]] != i + 1) {
+                        seen[s->xt[k]] = i + 1;
+                        rows[s->xt[k]].total++;
+                    }
+                }
+            }
+            fprintf(stderr, "Profile: %u samples at %d Hz, %u in the outer interpreter\n",
+                    n, sample_hz, outer);
+            print_rows(vm, rows, false);
+            write_folded(vm, n);
+        }
+        free(rows);
+        free(seen);
+        free(samples);
+        samples = NULL;
+    }
+}
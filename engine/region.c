@@ -0,0 +1,710 @@
+/* region.c - VM memory regions and copy-on-write cloning
+ *
+ * dict[], heads[] and mem[] are separate mappings (vm_region_alloc), so
+ * pages a program never touches cost nothing. Files can be mapped into a
+ * window reserved after mem[] (file views, below).
+ *
+ * All are reserved inaccessible at their full limit (vm_mem_size,
+ * vm_dict_size; --mem and --dict) and committed a step at a time as
+ * they are used: the first touch past the committed end faults into
+ * the handler below, which makes the next COMMIT_STEP accessible.
+ * A large limit therefore costs address space only, and data space
+ * grows with ALLOT up to it.
+ *
+ * SPAWN copies the parent's used dictionary and data space into the
+ * child, then write-protects the parent's pages to learn which of them
+ * change before the next SPAWN. The first write to a page faults into
+ * the handler below, which makes that page writable and marks it in a
+ * bitmap. At the next SPAWN the parent's pages are moved into an
+ * anonymous shared-memory file once and the parent is remapped
+ * MAP_PRIVATE onto it; from then on every clone maps the same file
+ * MAP_PRIVATE and the kernel copies a page only when one side writes to
+ * it. A clone then copies only the pages the parent wrote since the
+ * snapshot, and whatever it grew past it, over the mapping. The cost of
+ * a SPAWN follows what the parent changed, not the size of the loaded
+ * program. Once the changes reach a quarter of the snapshot, a new
+ * snapshot is taken.
+ *
+ * The parent's own writes land in private pages and never reach the
+ * file, so a snapshot stays valid for the clones already made.
+ *
+ * The kernel does not fault on our behalf: a read(2) into a protected
+ * page fails with EFAULT instead. C code that hands mem[] to a syscall
+ * as a destination calls vm_range_writable() first.
+ *
+ * Each region also maps the VM's two stacks, each between inaccessible
+ * guard pages and ending where its upper guard starts. push and pop
+ * stay unchecked; a runaway recursion or one pop too many touches a
+ * guard, and the same handler jumps back to the innermost
+ * vm_execute_caught on the thread, which aborts.
+ */
+
+#define _GNU_SOURCE                  /* memfd_create */
+#include "fifth.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define DICT_BYTES   page_round((size_t)vm_dict_size * sizeof(dict_entry_t))
+#define HEADS_BYTES  page_round((size_t)vm_dict_size * sizeof(dict_head_t))
+#define MEM_SPAN     (vm_mem_size + VIEW_SPACE)  /* mem[] plus the view window */
+#define COMMIT_STEP  ((size_t)256 << 10) /* Growth per fault, a page multiple */
+#define MAX_GUARDS   384             /* Protected ranges, three per VM */
+#define MAX_REGIONS  65536           /* Live and spare VM regions */
+#define MAX_SPARES   8               /* Freed regions kept for reuse */
+#define DSTACK_BYTES page_round(DSTACK_SIZE * sizeof(cell_t))
+#define RSTACK_BYTES page_round(RSTACK_SIZE * sizeof(cell_t))
+#define STACK_SPAN   (4 * page_size() + DSTACK_BYTES + RSTACK_BYTES)  /* Both, four guards */
+
+size_t vm_mem_size = MEM_SIZE_DEFAULT;
+int    vm_dict_size = DICT_SIZE_DEFAULT;
+static bool limits_fixed;            /* A region has been reserved */
+
+/* A write-protected range and the VM that owns it */
+typedef struct {
+    uintptr_t           lo, hi;
+    size_t              off;         /* Offset of lo in the snapshot layout */
+    _Atomic(vm_t *)     vm;          /* NULL = free slot */
+} guard_t;
+
+static guard_t guards[MAX_GUARDS];
+
+/* A VM's dict, heads and mem reservations. Slots are handed out under
+ * guard_mutex; the fault handler scans them without it. */
+typedef struct {
+    dict_entry_t *dict;
+    dict_head_t  *heads;
+    uint8_t      *mem;
+    int          *hash_next;
+    size_t        dict_committed;    /* Accessible bytes */
+    size_t        heads_committed;
+    size_t        mem_committed;     /* Accessible, and may be nonzero */
+    size_t        dict_used;         /* Bytes of dict that may be nonzero */
+    size_t        heads_used;
+    uint8_t      *stacks;            /* STACK_SPAN: guard, data stack, guard, guard, return stack, guard */
+    atomic_bool   live;              /* Mapped and growable */
+} region_t;
+
+static region_t regions[MAX_REGIONS];
+static atomic_int region_top;        /* Slots ever used */
+static int free_slots[MAX_REGIONS];
+static int free_count;
+static pthread_mutex_t guard_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t handler_once = PTHREAD_ONCE_INIT;
+
+_Thread_local vm_catch_t *vm_catch_top;
+
+static size_t page_size(void) {
+    static size_t page;
+    if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+    return page;
+}
+
+static size_t page_round(size_t n) {
+    size_t p = page_size();
+    return (n + p - 1) & ~(p - 1);
+}
+
+/* One past the top cell of each stack in a STACK_SPAN mapping */
+static uint8_t *dstack_top(uint8_t *stacks) { return stacks + page_size() + DSTACK_BYTES; }
+static uint8_t *rstack_top(uint8_t *stacks) { return dstack_top(stacks) + 2 * page_size() + RSTACK_BYTES; }
+
+/* Make base[0..upto) accessible, rounding up to COMMIT_STEP */
+static bool grow(void *base, size_t *committed, size_t limit, size_t upto) {
+    if (upto <= *committed) return true;
+    if (upto > limit) return false;
+    size_t to = (upto + COMMIT_STEP - 1) & ~(COMMIT_STEP - 1);
+    if (to > limit) to = limit;
+    if (mprotect((uint8_t *)base + *committed, to - *committed, PROT_READ | PROT_WRITE) != 0)
+        return false;
+    *committed = to;
+    return true;
+}
+
+/* Touch past the committed end of a reservation: commit up to it */
+static bool grow_fault(uintptr_t a) {
+    int top = atomic_load(&region_top);
+    for (int i = 0; i < top; i++) {
+        region_t *r = &regions[i];
+        if (!atomic_load(&r->live)) continue;
+        uintptr_t d = (uintptr_t)r->dict, h = (uintptr_t)r->heads, m = (uintptr_t)r->mem;
+        if (a >= m && a < m + vm_mem_size)
+            return a - m >= r->mem_committed &&
+                   grow(r->mem, &r->mem_committed, vm_mem_size, a - m + 1);
+        if (a >= d && a < d + DICT_BYTES)
+            return a - d >= r->dict_committed &&
+                   grow(r->dict, &r->dict_committed, DICT_BYTES, a - d + 1);
+        if (a >= h && a < h + HEADS_BYTES)
+            return a - h >= r->heads_committed &&
+                   grow(r->heads, &r->heads_committed, HEADS_BYTES, a - h + 1);
+    }
+    return false;
+}
+
+/* A touch of a stack guard page of the VM running on this thread:
+ * jump back to its vm_execute_caught. Returns if it was not one. */
+static void stack_fault(uintptr_t a) {
+    vm_catch_t *c = vm_catch_top;
+    if (!c) return;
+    uintptr_t s = (uintptr_t)regions[c->vm->region].stacks, p = page_size();
+    uintptr_t d = (uintptr_t)dstack_top((uint8_t *)s), r = (uintptr_t)rstack_top((uint8_t *)s);
+    int fault = a >= s && a < s + p         ? FAULT_DSTACK_OVER
+              : a >= d && a < d + p         ? FAULT_DSTACK_UNDER
+              : a >= d + p && a < d + 2 * p ? FAULT_RSTACK_OVER
+              : a >= r && a < r + p         ? FAULT_RSTACK_UNDER : 0;
+    if (!fault) return;
+    c->fault = fault;
+    siglongjmp(c->jb, 1);
+}
+
+/* Make the protected page at a writable and mark it written */
+static void mark_written(vm_t *vm, const guard_t *g, uintptr_t a) {
+    uintptr_t p = page_size(), page = a & ~(p - 1);
+    size_t bit = (g->off + (page - g->lo)) / p;
+    if (vm->snap.written[bit / 64] & (1ull << (bit % 64))) return;
+    mprotect((void *)page, p, PROT_READ | PROT_WRITE);
+    vm->snap.written[bit / 64] |= 1ull << (bit % 64);
+    vm->snap.written_pages++;
+}
+
+/* First write to a protected page: make that page writable and mark it
+ * in the owner's bitmap. A touch past a committed end grows the region,
+ * and one on a stack guard aborts. Anything else is a real fault;
+ * restore the default action and let it re-fire. */
+static void cow_fault(int sig, siginfo_t *si, void *uc) {
+    (void)uc;
+    uintptr_t a = (uintptr_t)si->si_addr;
+    for (int i = 0; i < MAX_GUARDS; i++) {
+        vm_t *vm = atomic_load(&guards[i].vm);
+        if (vm && a >= guards[i].lo && a < guards[i].hi) {
+            mark_written(vm, &guards[i], a);
+            return;
+        }
+    }
+    if (!grow_fault(a)) {
+        stack_fault(a);
+        signal(sig, SIG_DFL);
+    }
+}
+
+static void install_handler(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = cow_fault;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART | SA_NODEFER;  /* stack_fault leaves by siglongjmp */
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS, &sa, NULL);    /* macOS reports protection faults here */
+}
+
+static void guard(vm_t *vm, void *base, size_t len, size_t off) {
+    if (len == 0) return;
+    pthread_mutex_lock(&guard_mutex);
+    for (int i = 0; i < MAX_GUARDS; i++) {
+        if (atomic_load(&guards[i].vm) == NULL) {
+            guards[i].lo = (uintptr_t)base;
+            guards[i].hi = (uintptr_t)base + len;
+            guards[i].off = off;
+            atomic_store(&guards[i].vm, vm);
+            mprotect(base, len, PROT_READ);
+            break;
+        }
+    }
+    /* No free slot: the range stays writable and arm() drops the
+     * other one too, so the VM counts as dirty at once. */
+    pthread_mutex_unlock(&guard_mutex);
+}
+
+/* Drop every protected range of vm, making its pages writable; it is
+ * untracked until the next arm() */
+static void unguard(vm_t *vm) {
+    pthread_mutex_lock(&guard_mutex);
+    for (int i = 0; i < MAX_GUARDS; i++) {
+        if (atomic_load(&guards[i].vm) == vm) {
+            atomic_store(&guards[i].vm, NULL);
+            mprotect((void *)guards[i].lo, guards[i].hi - guards[i].lo,
+                     PROT_READ | PROT_WRITE);
+            vm->snap.dirty = 1;
+        }
+    }
+    pthread_mutex_unlock(&guard_mutex);
+}
+
+/* Before a syscall writes to [lo, hi): what a fault would have done */
+static void touch(vm_t *vm, uintptr_t lo, uintptr_t hi) {
+    pthread_mutex_lock(&guard_mutex);
+    for (int i = 0; i < MAX_GUARDS; i++) {
+        if (atomic_load(&guards[i].vm) != vm) continue;
+        uintptr_t from = lo > guards[i].lo ? lo : guards[i].lo;
+        uintptr_t to = hi < guards[i].hi ? hi : guards[i].hi;
+        for (uintptr_t a = from & ~(page_size() - 1); a < to; a += page_size())
+            mark_written(vm, &guards[i], a);
+    }
+    pthread_mutex_unlock(&guard_mutex);
+}
+
+static int guarded_count(vm_t *vm) {
+    int n = 0;
+    for (int i = 0; i < MAX_GUARDS; i++)
+        if (atomic_load(&guards[i].vm) == vm) n++;
+    return n;
+}
+
+int vm_set_limits(size_t mem, int dict) {
+    if (limits_fixed || mem < ((size_t)64 << 10) || mem > SIZE_MAX / 4 ||
+        dict < 1024 || dict > (1 << 24))
+        return -1;
+    vm_mem_size = page_round(mem);
+    vm_dict_size = dict;
+    return 0;
+}
+
+/* Anonymous shared-memory file of the given size */
+static int shm_file(size_t size) {
+    int fd;
+#ifdef __linux__
+    fd = memfd_create("fifth-vm", MFD_CLOEXEC);
+#else
+    static _Atomic unsigned counter;
+    char name[64];
+    snprintf(name, sizeof(name), "/fifth-%d-%u", (int)getpid(), atomic_fetch_add(&counter, 1));
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) shm_unlink(name);
+#endif
+    if (fd >= 0 && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/* ============================================================
+ * File views
+ *
+ * mem[] is followed by VIEW_SPACE bytes of reserved, inaccessible
+ * address space. A view maps a file MAP_PRIVATE into a gap there, so
+ * it has an ordinary mem[] address and every string word works on it
+ * unchanged. Writes to a view stay private to the VM. Clones map
+ * the parent's views at the same addresses.
+ *
+ * A view with no file (fd -1) is zeroed scratch space (sql.c keeps
+ * result text there). Clones get a copy of the used part of arenas
+ * (arena.c); other scratch stays private to its VM.
+ * ============================================================ */
+
+/* Return a view's span to reserved, inaccessible space */
+static void release_span(vm_t *vm, vm_view_t *v) {
+    mmap(vm->mem + v->addr, v->span, PROT_NONE,
+         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+    if (v->fd >= 0) close(v->fd);
+}
+
+static void drop_views(vm_t *vm) {
+    for (int i = 0; i < vm->view_count; i++) release_span(vm, &vm->views[i]);
+    vm->view_count = 0;
+    vm->slurp_view = 0;
+}
+
+static void clone_views(vm_t *child, vm_t *parent) {
+    child->view_count = 0;
+    for (int i = 0; i < parent->view_count; i++) {
+        vm_view_t v = parent->views[i];
+        if (v.fd < 0) {              /* Arenas are copied, other scratch stays */
+            size_t used = vm_arena_used(parent, v.addr);
+            if (used && mmap(child->mem + v.addr, v.len, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE,
+                             -1, 0) != MAP_FAILED) {
+                memcpy(child->mem + v.addr, parent->mem + v.addr, used);
+                child->views[child->view_count++] = v;
+            }
+            continue;
+        }
+        v.fd = dup(v.fd);
+        if (v.fd < 0) continue;
+        if (mmap(child->mem + v.addr, v.len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_FIXED, v.fd, 0) == MAP_FAILED) {
+            close(v.fd);
+            continue;
+        }
+        child->views[child->view_count++] = v;
+    }
+}
+
+/* Map a view at want, or at the first gap that fits when want is 0 */
+static cell_t map_view(vm_t *vm, cell_t want, int fd, size_t len) {
+    size_t span = page_round(len);
+    if (vm->view_count == MAX_VIEWS || span == 0 || span > VIEW_SPACE ||
+        (size_t)want % page_size() != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    /* First fit between the sorted views, or the gap holding want */
+    cell_t at = (cell_t)vm_mem_size;
+    int slot = 0;
+    for (; slot < vm->view_count; slot++) {
+        if (want ? vm->views[slot].addr > want : (size_t)(vm->views[slot].addr - at) >= span) break;
+        at = vm->views[slot].addr + (cell_t)vm->views[slot].span;
+    }
+    if (want) {
+        if (want < at || (slot < vm->view_count && (size_t)(vm->views[slot].addr - want) < span)) {
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        at = want;
+    }
+    int flags = MAP_PRIVATE | MAP_FIXED | (fd < 0 ? MAP_ANONYMOUS | MAP_NORESERVE : 0);
+    if ((size_t)at + span > MEM_SPAN ||
+        mmap(vm->mem + at, len, PROT_READ | PROT_WRITE, flags, fd, 0) == MAP_FAILED) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    memmove(&vm->views[slot + 1], &vm->views[slot],
+            (size_t)(vm->view_count - slot) * sizeof(vm_view_t));
+    vm->views[slot] = (vm_view_t){ at, len, span, fd };
+    vm->view_count++;
+    return at;
+}
+
+cell_t vm_map_view(vm_t *vm, int fd, size_t len) {
+    return map_view(vm, 0, fd, len);
+}
+
+cell_t vm_map_view_at(vm_t *vm, cell_t at, size_t len) {
+    return at > 0 ? map_view(vm, at, -1, len) : -1;
+}
+
+int vm_unmap_view(vm_t *vm, cell_t addr) {
+    for (int i = 0; i < vm->view_count; i++) {
+        if (vm->views[i].addr != addr) continue;
+        release_span(vm, &vm->views[i]);
+        memmove(&vm->views[i], &vm->views[i + 1],
+                (size_t)(vm->view_count - i - 1) * sizeof(vm_view_t));
+        vm->view_count--;
+        if (vm->slurp_view == addr) vm->slurp_view = 0;
+        return 0;
+    }
+    return -1;
+}
+
+/* Freed regions kept for the next VM, so a SPAWN loop does not pay
+ * for fresh page faults on every clone */
+static int spares[MAX_SPARES];
+static int spare_count;
+
+/* Take a spare region, or map a fresh (zero) one; -1 on failure. A
+ * spare may hold a previous VM's data; the caller clears what it does
+ * not overwrite. */
+static int take_region(bool *reused) {
+    pthread_mutex_lock(&guard_mutex);
+    if (spare_count > 0) {
+        int slot = spares[--spare_count];
+        pthread_mutex_unlock(&guard_mutex);
+        *reused = true;
+        return slot;
+    }
+    limits_fixed = true;
+    pthread_mutex_unlock(&guard_mutex);
+    *reused = false;
+    pthread_once(&handler_once, install_handler);
+
+    /* Reserved only; pages are committed on first touch (grow_fault) */
+    void *dict = mmap(NULL, DICT_BYTES, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    void *heads = mmap(NULL, HEADS_BYTES, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    void *mem = mmap(NULL, MEM_SPAN, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    int *hash_next = malloc((size_t)vm_dict_size * sizeof(int));
+    uint8_t *stacks = mmap(NULL, STACK_SPAN, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stacks != MAP_FAILED &&
+        (mprotect(dstack_top(stacks) - DSTACK_BYTES, DSTACK_BYTES, PROT_READ | PROT_WRITE) != 0 ||
+         mprotect(rstack_top(stacks) - RSTACK_BYTES, RSTACK_BYTES, PROT_READ | PROT_WRITE) != 0)) {
+        munmap(stacks, STACK_SPAN);
+        stacks = MAP_FAILED;
+    }
+
+    int slot = -1;
+    pthread_mutex_lock(&guard_mutex);
+    if (free_count > 0) slot = free_slots[--free_count];
+    else if (atomic_load(&region_top) < MAX_REGIONS) slot = atomic_fetch_add(&region_top, 1);
+    pthread_mutex_unlock(&guard_mutex);
+
+    if (dict == MAP_FAILED || heads == MAP_FAILED || mem == MAP_FAILED || stacks == MAP_FAILED ||
+        !hash_next || slot < 0) {
+        if (dict != MAP_FAILED) munmap(dict, DICT_BYTES);
+        if (heads != MAP_FAILED) munmap(heads, HEADS_BYTES);
+        if (mem != MAP_FAILED) munmap(mem, MEM_SPAN);
+        if (stacks != MAP_FAILED) munmap(stacks, STACK_SPAN);
+        free(hash_next);
+        if (slot >= 0) {
+            pthread_mutex_lock(&guard_mutex);
+            free_slots[free_count++] = slot;
+            pthread_mutex_unlock(&guard_mutex);
+        }
+        return -1;
+    }
+    region_t *r = &regions[slot];
+    r->dict = dict;
+    r->heads = heads;
+    r->mem = mem;
+    r->hash_next = hash_next;
+    r->stacks = stacks;
+    r->dict_committed = r->heads_committed = r->mem_committed = 0;
+    r->dict_used = r->heads_used = 0;
+    atomic_store(&r->live, true);
+    return slot;
+}
+
+/* Keep a region for the next VM, or unmap it */
+static void put_region(int slot) {
+    region_t *r = &regions[slot];
+    pthread_mutex_lock(&guard_mutex);
+    if (spare_count < MAX_SPARES) {
+        spares[spare_count++] = slot;
+        pthread_mutex_unlock(&guard_mutex);
+        return;
+    }
+    pthread_mutex_unlock(&guard_mutex);
+    atomic_store(&r->live, false);
+    munmap(r->dict, DICT_BYTES);
+    munmap(r->heads, HEADS_BYTES);
+    munmap(r->mem, MEM_SPAN);
+    munmap(r->stacks, STACK_SPAN);
+    free(r->hash_next);
+    pthread_mutex_lock(&guard_mutex);
+    free_slots[free_count++] = slot;
+    pthread_mutex_unlock(&guard_mutex);
+}
+
+/* Attach a region to vm, zeroing a reused one from the given offsets */
+static void attach(vm_t *vm, int slot, bool reused, size_t dict_from, size_t heads_from,
+                   size_t mem_from) {
+    region_t *r = &regions[slot];
+    if (reused) {
+        if (r->dict_used > dict_from)
+            memset((uint8_t *)r->dict + dict_from, 0, r->dict_used - dict_from);
+        if (r->heads_used > heads_from)
+            memset((uint8_t *)r->heads + heads_from, 0, r->heads_used - heads_from);
+        if (r->mem_committed > mem_from)
+            memset(r->mem + mem_from, 0, r->mem_committed - mem_from);
+    }
+    vm->region = slot;
+    vm->dict = r->dict;
+    vm->heads = r->heads;
+    vm->mem = r->mem;
+    vm->hash_next = r->hash_next;
+    vm->dstack = (cell_t *)dstack_top(r->stacks) - DSTACK_SIZE;
+    vm->rstack = (cell_t *)rstack_top(r->stacks) - RSTACK_SIZE;
+    vm->snap.fd = -1;
+    vm->snap.dirty = 1;              /* Nothing known clean yet */
+}
+
+/* Give up vm's region, noting how much of dict it may have written */
+static int detach(vm_t *vm) {
+    unguard(vm);
+    if (vm->snap.fd >= 0) close(vm->snap.fd);
+    free(vm->snap.written);
+    vm->snap.written = NULL;
+    drop_views(vm);
+    regions[vm->region].dict_used = (size_t)vm->dict_count * sizeof(dict_entry_t);
+    regions[vm->region].heads_used = (size_t)vm->dict_count * sizeof(dict_head_t);
+    return vm->region;
+}
+
+int vm_region_alloc(vm_t *vm) {
+    bool reused;
+    int slot = take_region(&reused);
+    if (slot < 0) return -1;
+    attach(vm, slot, reused, 0, 0, 0);
+    return 0;
+}
+
+void vm_region_free(vm_t *vm) {
+    put_region(detach(vm));
+}
+
+bool vm_mem_writable(vm_t *vm, cell_t end) {
+    region_t *r = &regions[vm->region];
+    return end >= 0 && grow(r->mem, &r->mem_committed, vm_mem_size, (size_t)end);
+}
+
+bool vm_range_valid(vm_t *vm, cell_t addr, cell_t len) {
+    if (addr < 0 || len < 0) return false;
+    if ((size_t)addr < vm_mem_size) return (size_t)len <= vm_mem_size - (size_t)addr;
+    /* Above mem[]: a view (arena, scratch or file) is mapped whole */
+    for (int i = 0; i < vm->view_count; i++) {
+        const vm_view_t *v = &vm->views[i];
+        if (addr >= v->addr && (size_t)(addr - v->addr) <= v->len)
+            return (size_t)len <= v->len - (size_t)(addr - v->addr);
+    }
+    return false;
+}
+
+bool vm_range_writable(vm_t *vm, cell_t addr, cell_t len) {
+    if (!vm_range_valid(vm, addr, len)) return false;
+    if ((size_t)addr >= vm_mem_size) return true;
+    if (!vm_mem_writable(vm, addr + len)) return false;
+    touch(vm, (uintptr_t)(vm->mem + addr), (uintptr_t)(vm->mem + addr + len));
+    return true;
+}
+
+/* Write-protect the used pages of vm and start tracking them */
+static void arm(vm_t *vm) {
+    unguard(vm);
+    size_t dlen = page_round((size_t)vm->dict_count * sizeof(dict_entry_t));
+    size_t hlen = page_round((size_t)vm->dict_count * sizeof(dict_head_t));
+    size_t mlen = page_round((size_t)vm->here);
+    vm->snap.dict_len = dlen ? dlen : page_size();
+    vm->snap.heads_len = hlen ? hlen : page_size();
+    vm->snap.mem_len = mlen ? mlen : page_size();
+    /* Protecting uncommitted pages would make them readable */
+    region_t *r = &regions[vm->region];
+    grow(r->dict, &r->dict_committed, DICT_BYTES, vm->snap.dict_len);
+    grow(r->heads, &r->heads_committed, HEADS_BYTES, vm->snap.heads_len);
+    grow(r->mem, &r->mem_committed, vm_mem_size, vm->snap.mem_len);
+    size_t pages = (vm->snap.dict_len + vm->snap.heads_len + vm->snap.mem_len) / page_size();
+    free(vm->snap.written);
+    vm->snap.written = calloc((pages + 63) / 64, sizeof(uint64_t));
+    vm->snap.written_pages = 0;
+    if (!vm->snap.written) return;   /* Stays untracked */
+    vm->snap.dirty = 0;
+    guard(vm, vm->dict, vm->snap.dict_len, 0);
+    guard(vm, vm->heads, vm->snap.heads_len, vm->snap.dict_len);
+    guard(vm, vm->mem, vm->snap.mem_len, vm->snap.dict_len + vm->snap.heads_len);
+    if (guarded_count(vm) < 3) unguard(vm);
+}
+
+/* Move the used pages of a tracked vm into a new snapshot file */
+static int snapshot(vm_t *vm) {
+    arm(vm);                         /* Spans as they are now */
+    if (vm->snap.dirty) return -1;
+    size_t dlen = vm->snap.dict_len, hlen = vm->snap.heads_len, mlen = vm->snap.mem_len;
+    int fd = shm_file(dlen + hlen + mlen);
+    if (fd < 0) return -1;
+    uint8_t *p = mmap(NULL, dlen + hlen + mlen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    memcpy(p, vm->dict, dlen);
+    memcpy(p + dlen, vm->heads, hlen);
+    memcpy(p + dlen + hlen, vm->mem, mlen);
+    munmap(p, dlen + hlen + mlen);
+
+    /* Same contents, now backed by the snapshot. Failure here would
+     * leave the parent without its pages, so it is fatal. */
+    if (mmap(vm->dict, dlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(vm->heads, hlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+             (off_t)dlen) == MAP_FAILED ||
+        mmap(vm->mem, mlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+             (off_t)(dlen + hlen)) == MAP_FAILED) {
+        fprintf(stderr, "SPAWN: cannot remap VM onto snapshot\n");
+        exit(1);
+    }
+    if (vm->snap.fd >= 0) close(vm->snap.fd);  /* Older clones keep their mappings */
+    vm->snap.fd = fd;
+    arm(vm);                         /* The remap dropped the protection */
+    return 0;
+}
+
+/* Bytes of an area in use beyond its tracked span */
+static size_t grown(size_t used, size_t span) {
+    return used > span ? used - span : 0;
+}
+
+/* Copy the parent's pages written since its snapshot, and what it grew
+ * past the snapshot, into a child region that maps the snapshot */
+static bool overlay(region_t *r, vm_t *parent) {
+    const vm_snap_t *s = &parent->snap;
+    size_t p = page_size(), dlen = (size_t)parent->dict_count * sizeof(dict_entry_t);
+    size_t hlen = (size_t)parent->dict_count * sizeof(dict_head_t), mlen = (size_t)parent->here;
+    if (!grow(r->dict, &r->dict_committed, DICT_BYTES, dlen) ||
+        !grow(r->heads, &r->heads_committed, HEADS_BYTES, hlen) ||
+        !grow(r->mem, &r->mem_committed, vm_mem_size, mlen))
+        return false;
+    size_t words = ((s->dict_len + s->heads_len + s->mem_len) / p + 63) / 64;
+    for (size_t w = 0; s->written_pages && w < words; w++) {
+        for (uint64_t bits = s->written[w]; bits; bits &= bits - 1) {
+            size_t off = (w * 64 + (size_t)__builtin_ctzll(bits)) * p;
+            if (off < s->dict_len)
+                memcpy((uint8_t *)r->dict + off, (uint8_t *)parent->dict + off, p);
+            else if ((off -= s->dict_len) < s->heads_len)
+                memcpy((uint8_t *)r->heads + off, (uint8_t *)parent->heads + off, p);
+            else
+                memcpy(r->mem + (off - s->heads_len), parent->mem + (off - s->heads_len), p);
+        }
+    }
+    if (dlen > s->dict_len)
+        memcpy((uint8_t *)r->dict + s->dict_len, (uint8_t *)parent->dict + s->dict_len, dlen - s->dict_len);
+    if (hlen > s->heads_len)
+        memcpy((uint8_t *)r->heads + s->heads_len, (uint8_t *)parent->heads + s->heads_len, hlen - s->heads_len);
+    if (mlen > s->mem_len)
+        memcpy(r->mem + s->mem_len, parent->mem + s->mem_len, mlen - s->mem_len);
+    return true;
+}
+
+/* Give child the parent's dictionary and data space: the parent's
+ * snapshot shared copy-on-write, plus the pages it changed since, or a
+ * plain copy the first time. child is either zeroed (regions are taken
+ * here) or a finished VM being reused, whose regions are refilled. */
+int vm_region_clone(vm_t *child, vm_t *parent) {
+    bool reused = true;
+    int slot = child->mem ? detach(child) : take_region(&reused);
+    if (slot < 0) return -1;
+    region_t *r = &regions[slot];
+
+    /* Tracked since the last clone: snapshot on the second one, and
+     * again once overlaying the changes would cost a quarter of it */
+    const vm_snap_t *s = &parent->snap;
+    size_t dlen = (size_t)parent->dict_count * sizeof(dict_entry_t);
+    size_t hlen = (size_t)parent->dict_count * sizeof(dict_head_t);
+    size_t changed = s->written_pages * page_size() + grown(dlen, s->dict_len) +
+                     grown(hlen, s->heads_len) + grown((size_t)parent->here, s->mem_len);
+    bool shared = !s->dirty &&
+                  ((s->fd >= 0 && 4 * changed <= s->dict_len + s->heads_len + s->mem_len) ||
+                   snapshot(parent) == 0);
+    if (shared &&
+        mmap(r->dict, s->dict_len, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, s->fd, 0) != MAP_FAILED &&
+        mmap(r->heads, s->heads_len, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, s->fd, (off_t)s->dict_len) != MAP_FAILED &&
+        mmap(r->mem, s->mem_len, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, s->fd, (off_t)(s->dict_len + s->heads_len)) != MAP_FAILED) {
+        if (r->dict_committed < s->dict_len) r->dict_committed = s->dict_len;
+        if (r->heads_committed < s->heads_len) r->heads_committed = s->heads_len;
+        if (r->mem_committed < s->mem_len) r->mem_committed = s->mem_len;
+        if (overlay(r, parent)) {
+            size_t mlen = (size_t)parent->here;
+            attach(child, slot, reused, dlen > s->dict_len ? dlen : s->dict_len,
+                   hlen > s->heads_len ? hlen : s->heads_len, mlen > s->mem_len ? mlen : s->mem_len);
+            clone_views(child, parent);
+            return 0;
+        }
+    }
+
+    if (!grow(r->dict, &r->dict_committed, DICT_BYTES, dlen) ||
+        !grow(r->heads, &r->heads_committed, HEADS_BYTES, hlen) ||
+        !grow(r->mem, &r->mem_committed, vm_mem_size, (size_t)parent->here)) {
+        put_region(slot);
+        child->dict = NULL;
+        child->heads = NULL;
+        child->mem = NULL;
+        return -1;
+    }
+    memcpy(r->dict, parent->dict, dlen);
+    memcpy(r->heads, parent->heads, hlen);
+    memcpy(r->mem, parent->mem, (size_t)parent->here);
+    attach(child, slot, reused, dlen, hlen, (size_t)parent->here);
+    clone_views(child, parent);
+    if (parent->snap.fd >= 0) {
+        close(parent->snap.fd);
+        parent->snap.fd = -1;
+    }
+    arm(parent);
+    return 0;
+}
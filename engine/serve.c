@@ -0,0 +1,234 @@
+/* serve.c - Persistent server mode
+ *
+ * fifth lib.fs ... --serve path boots once, loads the libraries named
+ * before it, and then answers requests on a Unix socket at path
+ * instead of starting the REPL. The loaded VM becomes a template that
+ * never runs again. Each of the --workers threads (default nproc)
+ * keeps a clone of it (copy-on-write, region.c) ready for its next
+ * connection.
+ *
+ * A request is the script's argv as NUL-terminated strings, an empty
+ * string, then the script text up to end of file (the client shuts
+ * down its write side). The worker interprets the text as if it were
+ * a file, with ARGC and ARGV showing that argv, and streams its output
+ * back on the connection, which closes when the script ends. Error
+ * messages, and whatever SYSTEM runs, go to the server's stderr and
+ * stdout.
+ *
+ * After the connection closes the worker re-clones the template over
+ * its VM, so HERE, LATEST, the stacks, variables and the scratch arena
+ * are back as the libraries left them before the next request arrives.
+ * The template stays clean, so this maps its snapshot again rather
+ * than copying it.
+ *
+ * fifth --connect path page.fs args... is the client: it sends page.fs
+ * ("-" for stdin) and copies the output to stdout.
+ */
+
+#include "fifth.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVE_BACKLOG  128
+#define MAX_REQUEST_ARGS 256
+
+static vm_t *template_vm;
+static int listen_fd = -1;
+static pthread_mutex_t template_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Read fd to end of file into a NUL-terminated buffer */
+static char *read_all(int fd, size_t *len) {
+    size_t cap = 4096, n = 0;
+    char *buf = malloc(cap);
+    while (buf) {
+        if (n + 1 == cap) {
+            char *b = realloc(buf, cap * 2);
+            if (!b) break;
+            buf = b;
+            cap *= 2;
+        }
+        ssize_t r = read(fd, buf + n, cap - n - 1);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) break;
+        if (r == 0) {
+            buf[n] = '\0';
+            *len = n;
+            return buf;
+        }
+        n += (size_t)r;
+    }
+    free(buf);
+    return NULL;
+}
+
+static bool write_all(int fd, const void *p, size_t n) {
+    const char *c = p;
+    while (n) {
+        ssize_t w = write(fd, c, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        c += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+/* A clone of the template, refilling reuse if given. Cloning updates
+ * the template's snapshot state, so one at a time. */
+static vm_t *fresh(vm_t *reuse) {
+    pthread_mutex_lock(&template_lock);
+    vm_t *vm = vm_clone(template_vm, reuse);
+    pthread_mutex_unlock(&template_lock);
+    if (!vm) fprintf(stderr, "SERVE: cannot clone VM\n");
+    return vm;
+}
+
+/* Run one request on vm; closes fd */
+static void serve_request(vm_t *vm, int fd) {
+    size_t len;
+    char *req = read_all(fd, &len);
+    FILE *out = req ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        free(req);
+        close(fd);
+        return;
+    }
+
+    /* argv, then an empty string, then the text */
+    char *args[MAX_REQUEST_ARGS];
+    int argc = 0;
+    size_t p = 0;
+    while (p < len && req[p]) {
+        if (argc < MAX_REQUEST_ARGS) args[argc++] = req + p;
+        p += strlen(req + p) + 1;
+    }
+    if (p < len) p++;
+
+    vm->out = out;
+    vm->obuf.line = false;
+    vm_set_args(vm, argc, args);
+    vm_load_source(vm, req + p, len - p);
+    vm_out_release(vm);
+    vm->out = stdout;
+    vm->args = NULL;
+    vm->arg_count = 0;
+    vm->arg_copies = 0;
+    fclose(out);
+    free(req);
+}
+
+static void *serve_worker(void *arg) {
+    (void)arg;
+    vm_t *vm = fresh(NULL);
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("SERVE: accept");
+            break;
+        }
+        fcntl(fd, F_SETFD, FD_CLOEXEC);  /* Not for SYSTEM's children */
+        if (!vm && !(vm = fresh(NULL))) {
+            close(fd);
+            continue;
+        }
+        serve_request(vm, fd);
+        vm = fresh(vm);
+    }
+    vm_destroy(vm);
+    return NULL;
+}
+
+int vm_serve(vm_t *vm, const char *path, int workers) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "SERVE: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("SERVE: socket");
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    unlink(path);                    /* A socket left by an earlier server */
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, SERVE_BACKLOG) != 0) {
+        fprintf(stderr, "SERVE: cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    /* A client that hangs up early must not take the server with it */
+    signal(SIGPIPE, SIG_IGN);
+    /* Native code made while the libraries loaded is shared by every
+     * clone; code made for a request would go with its clone */
+    vm_jit_threshold = 0;
+    vm_flush(vm);
+    template_vm = vm;
+    listen_fd = fd;
+
+    if (workers < 1) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = n > 0 ? (int)n : 1;
+    }
+    for (int i = 1; i < workers; i++) {
+        pthread_t th;
+        if (pthread_create(&th, NULL, serve_worker, NULL) != 0) {
+            fprintf(stderr, "SERVE: started %d of %d workers\n", i, workers);
+            break;
+        }
+        pthread_detach(th);
+    }
+    serve_worker(NULL);              /* This thread is a worker too */
+    return -1;
+}
+
+int vm_serve_connect(const char *path, int argc, char **argv) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (argc < 1 || strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Usage: fifth --connect socket script.fs [args ...]\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int in = strcmp(argv[0], "-") == 0 ? 0 : open(argv[0], O_RDONLY);
+    size_t len = 0;
+    char *text = in >= 0 ? read_all(in, &len) : NULL;
+    if (in > 0) close(in);
+    if (!text) {
+        fprintf(stderr, "Cannot open: %s\n", argv[0]);
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Cannot connect: %s: %s\n", path, strerror(errno));
+        free(text);
+        return 1;
+    }
+    bool ok = true;
+    for (int i = 0; ok && i < argc; i++) ok = write_all(fd, argv[i], strlen(argv[i]) + 1);
+    ok = ok && write_all(fd, "", 1) && write_all(fd, text, len);
+    free(text);
+    shutdown(fd, SHUT_WR);
+
+    char buf[65536];
+    for (;;) {
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0 || !write_all(1, buf, (size_t)r)) break;
+    }
+    close(fd);
+    return ok ? 0 : 1;
+}
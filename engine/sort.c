@@ -0,0 +1,211 @@
+/* sort.c - Sorting cell arrays
+ *
+ *   sort          ( addr n xt -- )   n cells at addr, in the order of
+ *                                    xt ( x1 x2 -- flag ), true if x1
+ *                                    goes before x2:  ['] < sort
+ *   sort-cells    ( addr n -- )      Signed ascending
+ *   sort-strings  ( addr n -- )      n addr u pairs (as split-fields
+ *                                    stores them), bytewise ascending
+ *
+ * SORT and SORT-STRINGS are introsort: quicksort on a median of three,
+ * heapsort past 2 log2 n levels so the worst case stays n log n, and
+ * insertion sort below 16 elements. SORT calls back into the VM only
+ * for compares. SORT-CELLS is an LSD radix sort a byte at a time,
+ * skipping the bytes on which every cell agrees; small arrays, or a
+ * failed malloc of the n-cell buffer, fall back to introsort. None of
+ * them is stable.
+ */
+
+#include "fifth.h"
+
+#define SORT_SMALL   16              /* Insertion sort below this */
+#define RADIX_MIN    256             /* Radix sort from this many cells */
+
+typedef struct { cell_t addr, len; } str_t;
+
+/* State for SORT's comparator calls */
+typedef struct {
+    vm_t     *vm;
+    int       xt;
+    unsigned  aborts;
+    bool      stop;                  /* xt aborted or misbehaved: finish without it */
+} sort_ctx_t;
+
+static bool xt_less(sort_ctx_t *c, cell_t a, cell_t b) {
+    if (c->stop) return false;
+    vm_t *vm = c->vm;
+    cell_t *sp = vm->sp;
+    push(vm, a);
+    push(vm, b);
+    vm_execute(vm, c->xt);
+    if (vm->aborts != c->aborts || !vm->running) {
+        c->stop = true;
+        return false;
+    }
+    if (vm->sp != sp - 1) {
+        vm->sp = sp;
+        vm_abort(vm, "SORT: comparator must be ( x1 x2 -- flag )");
+        c->stop = true;
+        return false;
+    }
+    return pop(vm) != 0;
+}
+
+static bool str_less(vm_t *vm, str_t a, str_t b) {
+    size_t n = (size_t)(a.len < b.len ? a.len : b.len);
+    int r = memcmp(vm->mem + a.addr, vm->mem + b.addr, n);
+    return r < 0 || (r == 0 && a.len < b.len);
+}
+
+/* Introsort of n elements of type T at v, with LESS(a, b) over two
+ * elements; ctx is passed through to LESS */
+#define INTROSORT(name, T, CTX, LESS)                                           \
+static void name##_insertion(CTX ctx, T *v, size_t n) {                         \
+    for (size_t i = 1; i < n; i++) {                                            \
+        T x = v[i];                                                             \
+        size_t j = i;                                                           \
+        for (; j > 0 && LESS(ctx, x, v[j - 1]); j--) v[j] = v[j - 1];           \
+        v[j] = x;                                                               \
+    }                                                                           \
+}                                                                               \
+static void name##_sift(CTX ctx, T *v, size_t i, size_t n) {                    \
+    T x = v[i];                                                                 \
+    for (size_t c; (c = 2 * i + 1) < n; i = c) {                                \
+        if (c + 1 < n && LESS(ctx, v[c], v[c + 1])) c++;                        \
+        if (!LESS(ctx, x, v[c])) break;                                         \
+        v[i] = v[c];                                                            \
+    }                                                                           \
+    v[i] = x;                                                                   \
+}                                                                               \
+static void name##_heap(CTX ctx, T *v, size_t n) {                              \
+    for (size_t i = n / 2; i-- > 0;) name##_sift(ctx, v, i, n);                 \
+    for (size_t i = n; i-- > 1;) {                                              \
+        T x = v[0]; v[0] = v[i]; v[i] = x;                                      \
+        name##_sift(ctx, v, 0, i);                                              \
+    }                                                                           \
+}                                                                               \
+static void name##_sort(CTX ctx, T *v, size_t n, int depth) {                   \
+    while (n > SORT_SMALL) {                                                    \
+        if (depth-- == 0) {                                                     \
+            name##_heap(ctx, v, n);                                             \
+            return;                                                             \
+        }                                                                       \
+        /* Pivot: the median of v[0], v[n/2] and v[n-1], left in v[0]       \
+         * with v[1] <= it <= v[n-1] */                                         \
+        T t = v[1]; v[1] = v[n / 2]; v[n / 2] = t;                              \
+        if (LESS(ctx, v[0], v[1])) { t = v[0]; v[0] = v[1]; v[1] = t; }         \
+        if (LESS(ctx, v[n - 1], v[0])) {                                        \
+            t = v[0]; v[0] = v[n - 1]; v[n - 1] = t;                            \
+            if (LESS(ctx, v[0], v[1])) { t = v[0]; v[0] = v[1]; v[1] = t; }     \
+        }                                                                       \
+        T p = v[0];                                                             \
+        size_t i = 1, j = n;                                                    \
+        for (;;) {                                                              \
+            do i++; while (i < n && LESS(ctx, v[i], p));                        \
+            do j--; while (j > 0 && LESS(ctx, p, v[j]));                        \
+            if (i >= j) break;                                                  \
+            t = v[i]; v[i] = v[j]; v[j] = t;                                    \
+        }                                                                       \
+        v[0] = v[j]; v[j] = p;                                                  \
+        /* Recurse into the smaller side, loop on the larger */                 \
+        if (j < n - j - 1) {                                                    \
+            name##_sort(ctx, v, j, depth);                                      \
+            v += j + 1; n -= j + 1;                                             \
+        } else {                                                                \
+            name##_sort(ctx, v + j + 1, n - j - 1, depth);                      \
+            n = j;                                                              \
+        }                                                                       \
+    }                                                                           \
+    name##_insertion(ctx, v, n);                                                \
+}
+
+#define XT_LESS(c, a, b)    xt_less(c, a, b)
+#define CELL_LESS(c, a, b)  ((void)(c), (a) < (b))
+#define STR_LESS(vm, a, b)  str_less(vm, a, b)
+
+INTROSORT(xt,   cell_t, sort_ctx_t *, XT_LESS)
+INTROSORT(cell, cell_t, void *,       CELL_LESS)
+INTROSORT(str,  str_t,  vm_t *,       STR_LESS)
+
+static int depth_limit(size_t n) {
+    int d = 0;
+    while (n >>= 1) d++;
+    return 2 * d;
+}
+
+/* Signed order on unsigned keys: flip the sign bit */
+#define RADIX_KEY(x)  ((ucell_t)(x) ^ ((ucell_t)1 << (sizeof(cell_t) * 8 - 1)))
+
+static bool radix_cells(cell_t *v, size_t n) {
+    cell_t *tmp = malloc(n * sizeof(cell_t));
+    if (!tmp) return false;
+    size_t count[sizeof(cell_t)][256];
+    memset(count, 0, sizeof(count));
+    for (size_t i = 0; i < n; i++) {
+        ucell_t k = RADIX_KEY(v[i]);
+        for (size_t b = 0; b < sizeof(cell_t); b++) count[b][(k >> (8 * b)) & 0xff]++;
+    }
+    cell_t *src = v, *dst = tmp;
+    for (size_t b = 0; b < sizeof(cell_t); b++) {
+        size_t *c = count[b];
+        if (c[(RADIX_KEY(v[0]) >> (8 * b)) & 0xff] == n) continue;  /* All the same */
+        size_t at = 0;
+        for (int d = 0; d < 256; d++) {
+            size_t k = c[d];
+            c[d] = at;
+            at += k;
+        }
+        for (size_t i = 0; i < n; i++) dst[c[(RADIX_KEY(src[i]) >> (8 * b)) & 0xff]++] = src[i];
+        cell_t *t = src; src = dst; dst = t;
+    }
+    if (src != v) memcpy(v, src, n * sizeof(cell_t));
+    free(tmp);
+    return true;
+}
+
+/* ============================================================
+ * Primitives
+ * ============================================================ */
+
+/* SORT ( addr n xt -- ) */
+static void p_sort(vm_t *vm) {
+    cell_t xt = pop(vm), n = pop(vm), addr = pop(vm);
+    if (xt < 0 || xt >= vm->dict_count) {
+        vm_abort(vm, "SORT: invalid xt");
+        return;
+    }
+    cell_t *v = vm_cells(vm, addr, n, "SORT");
+    if (!v) return;
+    sort_ctx_t c = { vm, (int)xt, vm->aborts, false };
+    xt_sort(&c, v, (size_t)n, depth_limit((size_t)n));
+}
+
+/* SORT-CELLS ( addr n -- ) */
+static void p_sort_cells(vm_t *vm) {
+    cell_t n = pop(vm), addr = pop(vm);
+    cell_t *v = vm_cells(vm, addr, n, "SORT-CELLS");
+    if (!v) return;
+    if (n < RADIX_MIN || !radix_cells(v, (size_t)n))
+        cell_sort(NULL, v, (size_t)n, depth_limit((size_t)n));
+}
+
+/* SORT-STRINGS ( addr n -- ) */
+static void p_sort_strings(vm_t *vm) {
+    cell_t n = pop(vm), addr = pop(vm);
+    cell_t cells = n >= 0 && (size_t)n <= (vm_mem_size + VIEW_SPACE) / sizeof(str_t) ? 2 * n : -1;
+    str_t *v = vm_cells(vm, addr, cells, "SORT-STRINGS");
+    if (!v) return;
+    for (cell_t i = 0; i < n; i++) {
+        if (!vm_range_valid(vm, v[i].addr, v[i].len)) {
+            vm_abort(vm, "SORT-STRINGS: string out of range");
+            return;
+        }
+    }
+    str_sort(vm, v, (size_t)n, depth_limit((size_t)n));
+}
+
+void sort_init(vm_t *vm) {
+    vm_add_prim(vm, "sort",         p_sort,         false);
+    vm_add_prim(vm, "sort-cells",   p_sort_cells,   false);
+    vm_add_prim(vm, "sort-strings", p_sort_strings, false);
+}
@@ -1,56 +1,166 @@
 /* spawn.c - Native concurrency for Fifth
  *
- * Adds spawn/wait primitives using pthreads.
- * Each spawned word runs in its own thread with its own stack.
+ * A persistent pool of nproc worker threads runs tasks. A task is an
+ * XT executed on its own clone of the submitting VM (copy-on-write, see
+ * region.c): it sees the parent exactly as it was at submission and
+ * writes only to its own copy. Its result is the TOS it leaves.
+ *
+ * Each worker owns a deque. Tasks submitted by a worker go on the
+ * bottom of its own deque and are taken back newest first; an idle
+ * worker steals the oldest task from the top of another's. Tasks from
+ * outside the pool are dealt round-robin. AWAIT runs queued tasks
+ * while the one it waits for is unfinished, so tasks that await
+ * subtasks cannot starve the pool. A thread about to block elsewhere
+ * (on a channel) calls task_blocking(), which adds a worker if queued
+ * tasks would otherwise have none.
+ *
+ * Finished VMs are kept and refilled by the next clone rather than
+ * freed, so a task costs neither pthread_create nor a fresh VM.
+ *
+ * PARALLEL-EACH and --jobs capture each task's output in memory and
+ * write it from the submitting VM in submission order, as each task
+ * finishes, so output from concurrent tasks never interleaves.
+ *
+ *   task          ( xt -- id )
+ *   await         ( id -- result )
+ *   parallel-for  ( lo hi xt -- )   xt ( i -- ) for each i in [lo, hi)
+ *   parallel-each ( addr n xt -- )  xt ( x -- ) for each of n cells, output in order
+ *   spawn/wait/wait-all/thread-done?   the same pool, older names
  */
 
 #include "fifth.h"
 #include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
 
-#define MAX_THREADS 64
+#define MAX_WORKERS   256            /* nproc, plus stand-ins for blocked ones */
+#define MAX_IDLE_VMS  64             /* Finished VMs kept for reuse */
+#define CHUNKS_PER_WORKER 4          /* parallel-for split granularity */
 
 typedef struct {
-    pthread_t thread;
-    vm_t *vm;           /* Each thread gets its own VM */
-    int xt;             /* Word to execute */
-    bool active;
-    bool done;
-    cell_t result;      /* TOS after execution */
-} thread_slot_t;
-
-static thread_slot_t threads[MAX_THREADS];
-static pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int next_thread_id = 0;
-
-/* Thread entry point */
-static void *thread_runner(void *arg) {
-    thread_slot_t *slot = (thread_slot_t *)arg;
-
-    /* Execute the word */
-    vm_execute(slot->vm, slot->xt);
-
-    /* Capture result (TOS) */
-    if (depth(slot->vm) > 0) {
-        slot->result = pop(slot->vm);
-    } else {
-        slot->result = 0;
+    vm_t       *vm;                  /* Clone the task runs on */
+    int         xt;                  /* Word to execute */
+    bool        range;               /* parallel-for chunk: xt ( i -- ) */
+    cell_t      lo, hi;              /* Chunk indices [lo, hi) */
+    bool        each;                /* Pass the cells at array[lo, hi) instead */
+    cell_t      array;
+    char      **job;                 /* --jobs: load job[0] instead, with it as ARGV */
+    bool        ordered;             /* Capture output for task_commit */
+    char       *out;                 /* The captured output */
+    size_t      out_len;
+    cell_t      result;              /* TOS after execution; a job's exit status */
+    atomic_int  done;
+    int         id;                  /* Handle, -1 if not in the table */
+} task_t;
+
+/* Per-worker deque: owner works the bottom, thieves take the top.
+ * top and bottom only grow; slots are buf[i % cap]. */
+typedef struct {
+    pthread_mutex_t lock;
+    task_t    **buf;
+    long        cap, top, bottom;
+} deque_t;
+
+static struct {
+    pthread_once_t  once;
+    atomic_int      nworkers;
+    deque_t        *deques;          /* MAX_WORKERS, first nworkers in use */
+    pthread_mutex_t lock;            /* Sleeping, waking, adding workers */
+    pthread_cond_t  cv;              /* Work queued or a task finished */
+    atomic_int      pending;         /* Tasks queued, not yet taken */
+    int             idle;            /* Workers asleep, under lock */
+    atomic_uint     next;            /* Round-robin for outside submitters */
+} pool = { PTHREAD_ONCE_INIT, 0, NULL, PTHREAD_MUTEX_INITIALIZER,
+           PTHREAD_COND_INITIALIZER, 0, 0, 0 };
+
+static _Thread_local int worker_self = -1;
+
+/* Task handles: growable table with a free list */
+static pthread_mutex_t table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static task_t **table;
+static int table_cap, table_used;
+static int *free_ids;
+static int free_count;
+
+/* Finished VMs */
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static vm_t *idle_vms[MAX_IDLE_VMS];
+static int idle_count;
+
+/* ============================================================
+ * Deques
+ * ============================================================ */
+
+static bool deque_push(deque_t *d, task_t *t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom - d->top == d->cap) {
+        long cap = d->cap ? d->cap * 2 : 64;
+        task_t **buf = malloc((size_t)cap * sizeof(task_t *));
+        if (!buf) {
+            pthread_mutex_unlock(&d->lock);
+            return false;
+        }
+        for (long i = d->top; i < d->bottom; i++)
+            buf[i % cap] = d->buf[i % d->cap];
+        free(d->buf);
+        d->buf = buf;
+        d->cap = cap;
     }
+    d->buf[d->bottom % d->cap] = t;
+    d->bottom++;
+    pthread_mutex_unlock(&d->lock);
+    return true;
+}
 
-    slot->done = true;
-    return NULL;
+static task_t *deque_pop(deque_t *d) {
+    task_t *t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) t = d->buf[--d->bottom % d->cap];
+    pthread_mutex_unlock(&d->lock);
+    return t;
+}
+
+static task_t *deque_steal(deque_t *d) {
+    task_t *t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) t = d->buf[d->top++ % d->cap];
+    pthread_mutex_unlock(&d->lock);
+    return t;
 }
 
-/* Clone a VM for a new thread */
-static vm_t *vm_clone(vm_t *parent) {
-    vm_t *child = calloc(1, sizeof(vm_t));
+/* ============================================================
+ * VMs
+ * ============================================================ */
+
+/* Clone parent for a task, refilling reuse if given */
+vm_t *vm_clone(vm_t *parent, vm_t *reuse) {
+    vm_t *child = reuse ? reuse : calloc(1, sizeof(vm_t));
     if (!child) return NULL;
+    vm_flush(parent);                /* Parent's output stays ahead of the child's */
 
-    /* Copy dictionary and memory */
-    memcpy(child->dict, parent->dict, sizeof(parent->dict));
+    /* Share dictionary and memory copy-on-write (region.c) */
+    if (vm_region_clone(child, parent) != 0) {
+        free(child);
+        return NULL;
+    }
+    if (reuse) vm_reset(child);
     child->dict_count = parent->dict_count;
     child->latest = parent->latest;
-    memcpy(child->mem, parent->mem, parent->here);
+    memcpy(child->hash_head, parent->hash_head, sizeof(parent->hash_head));
+    memcpy(child->name_bloom, parent->name_bloom, sizeof(parent->name_bloom));
+    child->numeric_names = parent->numeric_names;
+    memcpy(child->hash_next, parent->hash_next, (size_t)parent->dict_count * sizeof(int));
     child->here = parent->here;
+    for (int i = 0; i < parent->loaded_count; i++)  /* REQUIRE skips what the parent loaded */
+        if ((child->loaded_files[child->loaded_count] = strdup(parent->loaded_files[i])))
+            child->loaded_count++;
+    for (int i = 0; i < child->view_count; i++) {   /* Copied by vm_region_clone */
+        if (parent->scratch && child->views[i].addr == parent->scratch) child->scratch = parent->scratch;
+        if (parent->strings && child->views[i].addr == parent->strings) {
+            child->strings = parent->strings;
+            child->env_seen = parent->env_seen;
+        }
+    }
 
     /* Fresh stacks */
     child->sp = child->dstack + DSTACK_SIZE;
@@ -58,8 +168,13 @@ static vm_t *vm_clone(vm_t *parent) {
 
     /* Copy state */
     child->base = parent->base;
+    child->args = parent->args;
+    child->arg_count = parent->arg_count;
+    child->arg_copies = child->strings ? parent->arg_copies : 0;
     child->running = true;
     child->out = parent->out;
+    child->obuf.cap = parent->capture_depth ? parent->captures[0].cap : parent->obuf.cap;
+    child->obuf.line = parent->capture_depth ? parent->captures[0].line : parent->obuf.line;
 
     /* Copy cached XTs */
     child->xt_lit = parent->xt_lit;
@@ -72,110 +187,417 @@ static vm_t *vm_clone(vm_t *parent) {
     child->xt_loop = parent->xt_loop;
     child->xt_ploop = parent->xt_ploop;
     child->xt_does = parent->xt_does;
+    child->xt_tailcall = parent->xt_tailcall;
+
+    /* Fusion rules (resolved XTs are valid in the copied dictionary) */
+    memcpy(child->fusions, parent->fusions, sizeof(parent->fusions));
+    child->fusion_count = parent->fusion_count;
+    child->peep_last = child->peep_prev = child->join_at = -1;
 
     return child;
 }
 
-/* SPAWN ( xt -- thread-id )
- * Execute xt in a new thread, return thread ID
- */
-static void p_spawn(vm_t *vm) {
-    int xt = (int)pop(vm);
+static vm_t *vm_acquire(vm_t *parent) {
+    vm_t *reuse = NULL;
+    pthread_mutex_lock(&idle_mutex);
+    if (idle_count > 0) reuse = idle_vms[--idle_count];
+    pthread_mutex_unlock(&idle_mutex);
+    return vm_clone(parent, reuse);
+}
 
-    pthread_mutex_lock(&thread_mutex);
+static void vm_recycle(vm_t *vm) {
+    pthread_mutex_lock(&idle_mutex);
+    if (idle_count < MAX_IDLE_VMS) {
+        idle_vms[idle_count++] = vm;
+        vm = NULL;
+    }
+    pthread_mutex_unlock(&idle_mutex);
+    vm_destroy(vm);
+}
 
-    /* Find free slot */
-    int id = -1;
-    for (int i = 0; i < MAX_THREADS; i++) {
-        int idx = (next_thread_id + i) % MAX_THREADS;
-        if (!threads[idx].active) {
-            id = idx;
-            next_thread_id = (idx + 1) % MAX_THREADS;
-            break;
+/* ============================================================
+ * Pool
+ * ============================================================ */
+
+static void task_run(task_t *t) {
+    vm_t *vm = t->vm;
+    if (t->ordered) vm->obuf = (vm_obuf_t){ .memory = true };
+    if (t->job) {
+        vm_set_args(vm, 1, t->job);
+        t->result = vm_load_file(vm, t->job[0]) != 0 ? 1 : vm->exit_code;
+    } else if (t->range) {
+        for (cell_t i = t->lo; i < t->hi && vm->running; i++) {
+            vm->sp = vm->dstack + DSTACK_SIZE;
+            push(vm, t->each ? mem_fetch(vm, t->array + i * (cell_t)sizeof(cell_t)) : i);
+            vm_execute_caught(vm, t->xt);
         }
+        t->result = 0;
+    } else {
+        vm_execute_caught(vm, t->xt);
+        t->result = depth(vm) > 0 ? pop(vm) : 0;
+    }
+    t->vm = NULL;
+    if (t->ordered) {
+        vm_out_reset(vm);            /* Captures left open fold into the output */
+        t->out = vm->obuf.buf;
+        t->out_len = vm->obuf.len;
+        vm->obuf.buf = NULL;
     }
+    vm_out_release(vm);              /* Output is due when the task ends */
+    sql_release(vm);                 /* So are its connections */
+    vm_profile_release(vm);          /* And its counters */
+    vm_recycle(vm);
+
+    pthread_mutex_lock(&pool.lock);
+    atomic_store(&t->done, 1);
+    pthread_cond_broadcast(&pool.cv);
+    pthread_mutex_unlock(&pool.lock);
+}
 
-    if (id < 0) {
-        pthread_mutex_unlock(&thread_mutex);
-        fprintf(stderr, "SPAWN: No free thread slots\n");
-        push(vm, -1);
-        return;
+/* Own deque first, then steal round the others */
+static task_t *find_work(void) {
+    int n = atomic_load(&pool.nworkers);
+    int self = worker_self;
+    task_t *t = NULL;
+    if (self >= 0) t = deque_pop(&pool.deques[self]);
+    int start = self >= 0 ? self : (int)(atomic_load(&pool.next) % (unsigned)n);
+    for (int k = 1; !t && k <= n; k++)
+        t = deque_steal(&pool.deques[(start + k) % n]);
+    if (t) atomic_fetch_sub(&pool.pending, 1);
+    return t;
+}
+
+static void *worker_main(void *arg) {
+    worker_self = (int)(intptr_t)arg;
+    for (;;) {
+        task_t *t = find_work();
+        if (t) {
+            task_run(t);
+            continue;
+        }
+        pthread_mutex_lock(&pool.lock);
+        pool.idle++;
+        while (atomic_load(&pool.pending) == 0)
+            pthread_cond_wait(&pool.cv, &pool.lock);
+        pool.idle--;
+        pthread_mutex_unlock(&pool.lock);
     }
+    return NULL;
+}
 
-    /* Set up thread */
-    threads[id].vm = vm_clone(vm);
-    threads[id].xt = xt;
-    threads[id].active = true;
-    threads[id].done = false;
-    threads[id].result = 0;
+/* Start one more worker; call with pool.lock held */
+static bool add_worker(void) {
+    int id = atomic_load(&pool.nworkers);
+    if (id >= MAX_WORKERS) return false;
+    pthread_t th;
+    if (pthread_create(&th, NULL, worker_main, (void *)(intptr_t)id) != 0) return false;
+    pthread_detach(th);
+    atomic_store(&pool.nworkers, id + 1);
+    return true;
+}
 
-    /* Copy arguments from parent stack to child */
-    /* (For now, child starts with empty stack) */
+static void pool_start(void) {
+    pool.deques = calloc(MAX_WORKERS, sizeof(deque_t));
+    if (!pool.deques) {
+        fprintf(stderr, "TASK: cannot start worker pool\n");
+        exit(1);
+    }
+    for (int i = 0; i < MAX_WORKERS; i++)
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
 
-    /* Create thread */
-    if (pthread_create(&threads[id].thread, NULL, thread_runner, &threads[id]) != 0) {
-        free(threads[id].vm);
-        threads[id].active = false;
-        pthread_mutex_unlock(&thread_mutex);
-        fprintf(stderr, "SPAWN: pthread_create failed\n");
-        push(vm, -1);
-        return;
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    pthread_mutex_lock(&pool.lock);
+    for (long i = 0; i < n && add_worker(); i++) {}
+    pthread_mutex_unlock(&pool.lock);
+    /* With no workers at all, AWAIT still runs every task itself */
+    if (atomic_load(&pool.nworkers) == 0) {
+        fprintf(stderr, "TASK: no worker threads, running tasks inline\n");
+        atomic_store(&pool.nworkers, 1);
     }
+}
 
-    pthread_mutex_unlock(&thread_mutex);
-    push(vm, id);
+/* Clone vm for the task described by spec and queue it. NULL if no VM
+ * could be made. */
+static task_t *task_submit(vm_t *vm, const task_t *spec) {
+    pthread_once(&pool.once, pool_start);
+
+    task_t *t = calloc(1, sizeof(task_t));
+    if (!t) return NULL;
+    t->vm = vm_acquire(vm);
+    if (!t->vm) {
+        free(t);
+        return NULL;
+    }
+    t->xt = spec->xt;
+    t->range = spec->range;
+    t->lo = spec->lo;
+    t->hi = spec->hi;
+    t->each = spec->each;
+    t->array = spec->array;
+    t->job = spec->job;
+    t->ordered = spec->ordered;
+    t->id = -1;
+
+    int q = worker_self >= 0 ? worker_self
+                             : (int)(atomic_fetch_add(&pool.next, 1) % (unsigned)atomic_load(&pool.nworkers));
+    if (!deque_push(&pool.deques[q], t)) {
+        vm_recycle(t->vm);
+        free(t);
+        return NULL;
+    }
+    pthread_mutex_lock(&pool.lock);
+    atomic_fetch_add(&pool.pending, 1);
+    pthread_cond_broadcast(&pool.cv);
+    pthread_mutex_unlock(&pool.lock);
+    return t;
 }
 
-/* WAIT ( thread-id -- result )
- * Wait for thread to complete, return its result
- */
-static void p_wait(vm_t *vm) {
-    int id = (int)pop(vm);
+/* The calling thread is about to block on something the pool cannot
+ * see (a channel). If tasks are queued and no worker is free to take
+ * them, add one: the task being waited for may be among them. */
+void task_blocking(void) {
+    pthread_once(&pool.once, pool_start);
+    pthread_mutex_lock(&pool.lock);
+    if (atomic_load(&pool.pending) > 0 && pool.idle == 0) add_worker();
+    pthread_mutex_unlock(&pool.lock);
+}
 
-    if (id < 0 || id >= MAX_THREADS || !threads[id].active) {
-        fprintf(stderr, "WAIT: Invalid thread ID %d\n", id);
-        push(vm, 0);
-        return;
+/* Help with queued work until t is done */
+static void task_wait(task_t *t) {
+    while (!atomic_load(&t->done)) {
+        task_t *w = find_work();
+        if (w) {
+            task_run(w);
+            continue;
+        }
+        pthread_mutex_lock(&pool.lock);
+        while (!atomic_load(&t->done) && atomic_load(&pool.pending) == 0)
+            pthread_cond_wait(&pool.cv, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+    }
+}
+
+/* Wait for t, then free it */
+static cell_t task_await(task_t *t) {
+    task_wait(t);
+    cell_t result = t->result;
+    free(t);
+    return result;
+}
+
+/* Wait for an ordered task and write its output to vm */
+static cell_t task_commit(vm_t *vm, task_t *t) {
+    task_wait(t);
+    if (t->out) vm_write(vm, t->out, t->out_len);
+    free(t->out);
+    return task_await(t);
+}
+
+/* ============================================================
+ * Task handles
+ * ============================================================ */
+
+static int handle_new(task_t *t) {
+    int id = -1;
+    pthread_mutex_lock(&table_mutex);
+    if (free_count > 0) {
+        id = free_ids[--free_count];
+    } else if (table_used < table_cap) {
+        id = table_used++;
+    } else {
+        int cap = table_cap ? table_cap * 2 : 64;
+        task_t **nt = realloc(table, (size_t)cap * sizeof(task_t *));
+        int *nf = nt ? realloc(free_ids, (size_t)cap * sizeof(int)) : NULL;
+        if (nt) table = nt;
+        if (nf) {
+            free_ids = nf;
+            table_cap = cap;
+            id = table_used++;
+        }
+    }
+    if (id >= 0) {
+        table[id] = t;
+        t->id = id;
     }
+    pthread_mutex_unlock(&table_mutex);
+    return id;
+}
 
-    pthread_join(threads[id].thread, NULL);
+/* Take the task out of the table; NULL for an unknown handle */
+static task_t *handle_take(cell_t id) {
+    task_t *t = NULL;
+    pthread_mutex_lock(&table_mutex);
+    if (id >= 0 && id < table_used && table[id]) {
+        t = table[id];
+        table[id] = NULL;
+        free_ids[free_count++] = (int)id;
+    }
+    pthread_mutex_unlock(&table_mutex);
+    return t;
+}
 
-    cell_t result = threads[id].result;
+/* ============================================================
+ * Primitives
+ * ============================================================ */
 
-    /* Cleanup */
-    free(threads[id].vm);
-    threads[id].active = false;
+/* TASK ( xt -- id )
+ * Run xt on a worker, on a clone of this VM. -1 on failure.
+ */
+static void p_task(vm_t *vm) {
+    int xt = (int)pop(vm);
+    if (xt < 0 || xt >= vm->dict_count) {
+        fprintf(stderr, "TASK: invalid xt %d\n", xt);
+        push(vm, -1);
+        return;
+    }
+    task_t *t = task_submit(vm, &(task_t){ .xt = xt });
+    if (!t) {
+        fprintf(stderr, "TASK: cannot clone VM\n");
+        push(vm, -1);
+        return;
+    }
+    int id = handle_new(t);
+    if (id < 0) {
+        /* Unreachable by handle; finish it here */
+        task_await(t);
+        fprintf(stderr, "TASK: out of memory for task handle\n");
+    }
+    push(vm, id);
+}
 
-    push(vm, result);
+/* AWAIT ( id -- result )
+ * Wait for a task, return the TOS it left (0 if none)
+ */
+static void p_await(vm_t *vm) {
+    cell_t id = pop(vm);
+    task_t *t = handle_take(id);
+    if (!t) {
+        fprintf(stderr, "AWAIT: Invalid task ID %ld\n", (long)id);
+        push(vm, 0);
+        return;
+    }
+    push(vm, task_await(t));
 }
 
 /* WAIT-ALL ( -- )
- * Wait for all spawned threads
+ * Await every outstanding task, discarding results
  */
 static void p_wait_all(vm_t *vm) {
     (void)vm;
-
-    for (int i = 0; i < MAX_THREADS; i++) {
-        if (threads[i].active) {
-            pthread_join(threads[i].thread, NULL);
-            free(threads[i].vm);
-            threads[i].active = false;
-        }
+    for (int id = 0; ; id++) {
+        pthread_mutex_lock(&table_mutex);
+        int used = table_used;
+        pthread_mutex_unlock(&table_mutex);
+        if (id >= used) break;
+        task_t *t = handle_take(id);
+        if (t) task_await(t);
     }
 }
 
-/* THREAD-DONE? ( thread-id -- flag )
- * Check if thread is done without blocking
+/* THREAD-DONE? ( id -- flag )
+ * Check if a task is done without blocking
  */
 static void p_thread_done(vm_t *vm) {
-    int id = (int)pop(vm);
+    cell_t id = pop(vm);
+    bool done = true;                /* Invalid = done */
+    pthread_mutex_lock(&table_mutex);
+    if (id >= 0 && id < table_used && table[id])
+        done = atomic_load(&table[id]->done);
+    pthread_mutex_unlock(&table_mutex);
+    push(vm, done ? -1 : 0);
+}
 
-    if (id < 0 || id >= MAX_THREADS || !threads[id].active) {
-        push(vm, -1);  /* Invalid = done */
+/* Run xt on every index in [lo, hi), or on the cells of array there,
+ * in chunks across the pool, and wait for all of them */
+static void run_chunks(vm_t *vm, int xt, cell_t lo, cell_t hi, bool each, cell_t array,
+                       const char *who) {
+    if (xt < 0 || xt >= vm->dict_count) {
+        fprintf(stderr, "%s: invalid xt %d\n", who, xt);
         return;
     }
+    if (hi <= lo) return;
+
+    pthread_once(&pool.once, pool_start);
+    cell_t n = hi - lo;
+    cell_t chunks = (cell_t)atomic_load(&pool.nworkers) * CHUNKS_PER_WORKER;
+    if (chunks > n) chunks = n;
+    task_t **tasks = malloc((size_t)chunks * sizeof(task_t *));
+    if (!tasks) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s: out of memory", who);
+        vm_abort(vm, msg);
+        return;
+    }
+
+    cell_t submitted = 0, next = lo;
+    for (cell_t c = 0; c < chunks; c++) {
+        cell_t end = lo + n * (c + 1) / chunks;
+        task_t *t = task_submit(vm, &(task_t){ .xt = xt, .range = true, .lo = next, .hi = end,
+                                               .each = each, .array = array, .ordered = each });
+        if (!t) break;
+        tasks[submitted++] = t;
+        next = end;
+    }
+    for (cell_t c = 0; c < submitted; c++) {
+        if (each) task_commit(vm, tasks[c]);
+        else task_await(tasks[c]);
+    }
+    free(tasks);
+    if (next < hi) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s: cannot clone VM", who);
+        vm_abort(vm, msg);
+    }
+}
 
-    push(vm, threads[id].done ? -1 : 0);
+/* PARALLEL-FOR ( lo hi xt -- )
+ * Execute xt ( i -- ) for every i in [lo, hi) across the pool and wait
+ * for all of them. Each chunk of indices runs on its own clone.
+ */
+static void p_parallel_for(vm_t *vm) {
+    int xt = (int)pop(vm);
+    cell_t hi = pop(vm);
+    cell_t lo = pop(vm);
+    run_chunks(vm, xt, lo, hi, false, 0, "PARALLEL-FOR");
+}
+
+/* PARALLEL-EACH ( addr n xt -- )
+ * Execute xt ( x -- ) for each of the n cells at addr across the pool.
+ * Output appears as if the calls had run one after another.
+ */
+static void p_parallel_each(vm_t *vm) {
+    int xt = (int)pop(vm);
+    cell_t n = pop(vm);
+    cell_t addr = pop(vm);
+    run_chunks(vm, xt, 0, n, true, addr, "PARALLEL-EACH");
+}
+
+int vm_run_jobs(vm_t *vm, char **files, int n, int jobs) {
+    pthread_once(&pool.once, pool_start);
+    if (jobs < 1) jobs = atomic_load(&pool.nworkers);
+    task_t **tasks = calloc(n > 0 ? (size_t)n : 1, sizeof(task_t *));
+    if (!tasks) {
+        fprintf(stderr, "JOBS: out of memory\n");
+        return -1;
+    }
+
+    /* Up to jobs ahead of the oldest unfinished one, committed in order */
+    int status = 0, next = 0;
+    vm_flush(vm);
+    for (int i = 0; i < n; i++) {
+        for (; next < n && next < i + jobs; next++)
+            tasks[next] = task_submit(vm, &(task_t){ .job = files + next, .ordered = true });
+        if (!tasks[i]) {
+            fprintf(stderr, "JOBS: cannot clone VM for %s\n", files[i]);
+            status = -1;
+            continue;
+        }
+        if (task_commit(vm, tasks[i]) != 0) status = -1;
+        vm_flush(vm);
+    }
+    free(tasks);
+    return status;
 }
 
 /* NPROC ( -- n )
@@ -188,8 +610,12 @@ static void p_nproc(vm_t *vm) {
 
 /* Initialize spawn primitives */
 void spawn_init(vm_t *vm) {
-    vm_add_prim(vm, "spawn", p_spawn, false);
-    vm_add_prim(vm, "wait", p_wait, false);
+    vm_add_prim(vm, "task", p_task, false);
+    vm_add_prim(vm, "await", p_await, false);
+    vm_add_prim(vm, "parallel-for", p_parallel_for, false);
+    vm_add_prim(vm, "parallel-each", p_parallel_each, false);
+    vm_add_prim(vm, "spawn", p_task, false);
+    vm_add_prim(vm, "wait", p_await, false);
     vm_add_prim(vm, "wait-all", p_wait_all, false);
     vm_add_prim(vm, "thread-done?", p_thread_done, false);
     vm_add_prim(vm, "nproc", p_nproc, false);
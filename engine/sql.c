@@ -0,0 +1,374 @@
+/* sql.c - In-process SQLite
+ *
+ * lib/sql.fs used to run the sqlite3 shell for every query and read the
+ * rows back from a temporary file. With SQLite linked in (make SQLITE=1,
+ * the default when the library is found) these words talk to it
+ * directly. Each VM keeps its connections open, keyed by path, and
+ * caches prepared statements by SQL text, so repeating a query is a
+ * reset rather than a parse.
+ *
+ * Column text is copied once, from SQLite's buffer into a per-statement
+ * window of scratch space above mem[] (a view with no file, region.c),
+ * and returned as an ordinary addr u. It stays valid until that
+ * statement steps again; each statement has its own window, so a query
+ * can run inside another's row loop.
+ *
+ *   sql-open-db  ( addr u -- db ior )
+ *   sql-prepare  ( addr u db -- stmt ior )   text may hold several statements
+ *   sql-step     ( stmt -- flag )            true while there is a row
+ *   sql-column   ( n stmt -- addr u )        NULL and out of range give 0 0
+ *   sql-columns  ( stmt -- n )
+ *   sql-row      ( stmt -- addr u )          columns joined with |, like the shell
+ *   sql-native?  ( -- flag )                 false when built without SQLite
+ *
+ * Preparing the same text again restarts it. Errors are reported on
+ * stderr, as the shell did; sql-step then returns false.
+ */
+
+#include "fifth.h"
+
+#ifdef FIFTH_SQLITE
+
+#include <limits.h>
+#include <sqlite3.h>
+
+#define MAX_SQL_DBS    8
+#define MAX_SQL_STMTS  32
+#define SQL_ROW_BYTES  ((size_t)1 << 20)   /* Scratch per statement */
+
+typedef struct {
+    char         *path;
+    sqlite3      *db;
+} sql_db_t;
+
+typedef struct {
+    int           db;                /* -1 = free slot */
+    char         *text;              /* Cache key, owned */
+    size_t        len;
+    sqlite3_stmt *first;             /* Cached; NULL if the text is empty */
+    const char   *first_tail;        /* Text after first */
+    sqlite3_stmt *cur;               /* Statement being stepped */
+    const char   *tail;              /* Text after cur */
+    bool          row;               /* cur holds a row */
+    size_t        fill;              /* Scratch used by the current row */
+    unsigned long used;              /* LRU stamp */
+} sql_stmt_t;
+
+typedef struct {
+    sql_db_t      dbs[MAX_SQL_DBS];
+    int           db_count;
+    sql_stmt_t    stmts[MAX_SQL_STMTS];
+    unsigned long clock;
+    cell_t        scratch;           /* View address, 0 = not mapped yet */
+} sql_state_t;
+
+static sql_state_t *sql_state(vm_t *vm) {
+    if (!vm->sql) {
+        sql_state_t *st = calloc(1, sizeof(sql_state_t));
+        if (!st) {
+            vm_abort(vm, "SQL: out of memory");
+            return NULL;
+        }
+        for (int i = 0; i < MAX_SQL_STMTS; i++) st->stmts[i].db = -1;
+        vm->sql = st;
+    }
+    return vm->sql;
+}
+
+static sql_stmt_t *stmt_get(vm_t *vm, cell_t h, const char *word) {
+    sql_state_t *st = sql_state(vm);
+    if (st && h >= 0 && h < MAX_SQL_STMTS && st->stmts[h].db >= 0) return &st->stmts[h];
+    if (st) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s: invalid statement", word);
+        vm_abort(vm, msg);
+    }
+    return NULL;
+}
+
+static void stmt_free(sql_stmt_t *s) {
+    if (s->cur && s->cur != s->first) sqlite3_finalize(s->cur);
+    sqlite3_finalize(s->first);
+    free(s->text);
+    memset(s, 0, sizeof(*s));
+    s->db = -1;
+}
+
+/* Back to the first statement, ready to run again */
+static void stmt_rewind(sql_stmt_t *s) {
+    if (s->cur && s->cur != s->first) sqlite3_finalize(s->cur);
+    if (s->first) sqlite3_reset(s->first);
+    s->cur = s->first;
+    s->tail = s->first_tail;
+    s->row = false;
+}
+
+/* Prepare the next non-empty statement from text; false at the end or
+ * on error (reported) */
+static bool prepare_next(sqlite3 *db, const char *text, const char *end,
+                         sqlite3_stmt **out, const char **tail) {
+    *out = NULL;
+    while (text < end) {
+        if (sqlite3_prepare_v2(db, text, (int)(end - text), out, tail) != SQLITE_OK) {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+            *out = NULL;
+            return false;
+        }
+        if (*out) return true;
+        text = *tail;                /* Whitespace or a comment */
+    }
+    return false;
+}
+
+/* Copy len bytes into the statement's scratch window */
+static cell_t scratch_put(vm_t *vm, sql_state_t *st, int h, const void *p, size_t len) {
+    if (!st->scratch) {
+        cell_t at = vm_map_view(vm, -1, MAX_SQL_STMTS * SQL_ROW_BYTES);
+        if (at < 0) {
+            vm_abort(vm, "SQL: no address space for results");
+            return -1;
+        }
+        st->scratch = at;
+    }
+    sql_stmt_t *s = &st->stmts[h];
+    if (s->fill + len > SQL_ROW_BYTES) {
+        vm_abort(vm, "SQL: row too large");
+        return -1;
+    }
+    cell_t at = st->scratch + (cell_t)(h * SQL_ROW_BYTES + s->fill);
+    memcpy(vm->mem + at, p, len);
+    s->fill += len;
+    return at;
+}
+
+/* ============================================================
+ * Primitives
+ * ============================================================ */
+
+/* SQL-OPEN-DB ( addr u -- db ior ) Connections stay open per VM */
+static void p_sql_open_db(vm_t *vm) {
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    sql_state_t *st = sql_state(vm);
+    if (!st) return;
+
+    char raw[PATH_MAX], path[PATH_MAX];
+    int n = (len >= (cell_t)sizeof(raw)) ? (int)sizeof(raw) - 1 : (int)len;
+    memcpy(raw, vm->mem + addr, n);
+    raw[n] = '\0';
+    vm_expand_path(raw, path, sizeof(path));
+
+    for (int i = 0; i < st->db_count; i++) {
+        if (strcmp(st->dbs[i].path, path) == 0) {
+            push(vm, i);
+            push(vm, 0);
+            return;
+        }
+    }
+
+    sqlite3 *db = NULL;
+    int rc = st->db_count < MAX_SQL_DBS
+           ? sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL)
+           : SQLITE_FULL;
+    char *copy = rc == SQLITE_OK ? strdup(path) : NULL;
+    if (!copy) {
+        fprintf(stderr, "Error: unable to open database \"%s\": %s\n", path,
+                db ? sqlite3_errmsg(db) : "too many databases");
+        sqlite3_close(db);
+        push(vm, 0);
+        push(vm, -1);
+        return;
+    }
+    sqlite3_busy_timeout(db, 5000);
+    st->dbs[st->db_count] = (sql_db_t){ copy, db };
+    push(vm, st->db_count++);
+    push(vm, 0);
+}
+
+/* SQL-PREPARE ( addr u db -- stmt ior ) Cached by text */
+static void p_sql_prepare(vm_t *vm) {
+    cell_t dbh = pop(vm);
+    cell_t len = pop(vm);
+    cell_t addr = pop(vm);
+    sql_state_t *st = sql_state(vm);
+    if (!st) return;
+    if (dbh < 0 || dbh >= st->db_count) {
+        vm_abort(vm, "SQL-PREPARE: invalid database");
+        return;
+    }
+    const char *text = (const char *)(vm->mem + addr);
+    st->clock++;
+
+    /* Hit, or the least recently used slot, preferring idle ones */
+    int victim = 0;
+    for (int i = 0; i < MAX_SQL_STMTS; i++) {
+        sql_stmt_t *s = &st->stmts[i];
+        if (s->db == dbh && s->len == (size_t)len && memcmp(s->text, text, (size_t)len) == 0) {
+            stmt_rewind(s);
+            s->used = st->clock;
+            push(vm, i);
+            push(vm, 0);
+            return;
+        }
+        sql_stmt_t *v = &st->stmts[victim];
+        if ((v->row && !s->row) || (v->row == s->row && s->used < v->used)) victim = i;
+    }
+
+    sql_stmt_t *s = &st->stmts[victim];
+    stmt_free(s);
+    char *copy = malloc((size_t)len + 1);
+    if (!copy) {
+        vm_abort(vm, "SQL-PREPARE: out of memory");
+        return;
+    }
+    memcpy(copy, text, (size_t)len);
+    copy[len] = '\0';
+
+    sqlite3 *db = st->dbs[dbh].db;
+    const char *tail = copy;
+    sqlite3_stmt *first = NULL;
+    if (!prepare_next(db, copy, copy + len, &first, &tail) &&
+        sqlite3_errcode(db) != SQLITE_OK) {
+        free(copy);
+        push(vm, 0);
+        push(vm, -1);
+        return;
+    }
+    s->db = (int)dbh;
+    s->text = copy;
+    s->len = (size_t)len;
+    s->first = first;
+    s->first_tail = tail;
+    s->used = st->clock;
+    stmt_rewind(s);
+    push(vm, victim);
+    push(vm, 0);
+}
+
+/* SQL-STEP ( stmt -- flag ) Next row, moving on through the text's
+ * statements; rewinds when they are done */
+static void p_sql_step(vm_t *vm) {
+    cell_t h = pop(vm);
+    sql_stmt_t *s = stmt_get(vm, h, "SQL-STEP");
+    if (!s) return;
+    sql_state_t *st = vm->sql;
+    sqlite3 *db = st->dbs[s->db].db;
+    const char *end = s->text + s->len;
+    s->fill = 0;
+    s->used = ++st->clock;
+
+    while (s->cur) {
+        int rc = sqlite3_step(s->cur);
+        if (rc == SQLITE_ROW) {
+            s->row = true;
+            push(vm, -1);
+            return;
+        }
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+            break;
+        }
+        if (s->cur != s->first) sqlite3_finalize(s->cur);
+        s->cur = NULL;
+        if (!prepare_next(db, s->tail, end, &s->cur, &s->tail)) break;
+    }
+    if (s->cur == NULL) s->cur = s->first;   /* stmt_rewind must not finalize it */
+    stmt_rewind(s);
+    push(vm, 0);
+}
+
+/* SQL-COLUMNS ( stmt -- n ) */
+static void p_sql_columns(vm_t *vm) {
+    sql_stmt_t *s = stmt_get(vm, pop(vm), "SQL-COLUMNS");
+    if (!s) return;
+    push(vm, s->cur ? sqlite3_column_count(s->cur) : 0);
+}
+
+/* SQL-COLUMN ( n stmt -- addr u ) Text of column n in the current row */
+static void p_sql_column(vm_t *vm) {
+    cell_t h = pop(vm);
+    cell_t n = pop(vm);
+    sql_stmt_t *s = stmt_get(vm, h, "SQL-COLUMN");
+    if (!s) return;
+    if (!s->row) {
+        vm_abort(vm, "SQL-COLUMN: no row");
+        return;
+    }
+    const unsigned char *p = NULL;
+    size_t len = 0;
+    if (n >= 0 && n < sqlite3_column_count(s->cur)) {
+        p = sqlite3_column_text(s->cur, (int)n);
+        len = (size_t)sqlite3_column_bytes(s->cur, (int)n);
+    }
+    cell_t at = p ? scratch_put(vm, vm->sql, (int)h, p, len) : 0;
+    push(vm, at < 0 ? 0 : at);
+    push(vm, at <= 0 ? 0 : (cell_t)len);
+}
+
+/* SQL-ROW ( stmt -- addr u ) The current row as the sqlite3 shell prints it */
+static void p_sql_row(vm_t *vm) {
+    cell_t h = pop(vm);
+    sql_stmt_t *s = stmt_get(vm, h, "SQL-ROW");
+    if (!s) return;
+    if (!s->row) {
+        vm_abort(vm, "SQL-ROW: no row");
+        return;
+    }
+    sql_state_t *st = vm->sql;
+    size_t from = s->fill;
+    int cols = sqlite3_column_count(s->cur);
+    for (int i = 0; i < cols; i++) {
+        const unsigned char *p = sqlite3_column_text(s->cur, i);
+        size_t len = (size_t)sqlite3_column_bytes(s->cur, i);
+        if (i > 0 && scratch_put(vm, st, (int)h, "|", 1) < 0) return;
+        if (p && len && scratch_put(vm, st, (int)h, p, len) < 0) return;
+    }
+    size_t total = s->fill - from;
+    push(vm, total ? st->scratch + (cell_t)(h * SQL_ROW_BYTES + from) : 0);
+    push(vm, (cell_t)total);
+}
+
+static void p_sql_native(vm_t *vm) { push(vm, -1); }
+
+void sql_release(vm_t *vm) {
+    sql_state_t *st = vm->sql;
+    if (!st) return;
+    for (int i = 0; i < MAX_SQL_STMTS; i++)
+        if (st->stmts[i].db >= 0) stmt_free(&st->stmts[i]);
+    for (int i = 0; i < st->db_count; i++) {
+        sqlite3_close(st->dbs[i].db);
+        free(st->dbs[i].path);
+    }
+    free(st);
+    vm->sql = NULL;                  /* The scratch view goes with the VM's views */
+}
+
+#else /* !FIFTH_SQLITE */
+
+static void p_sql_missing(vm_t *vm) {
+    vm_abort(vm, "SQL: engine built without SQLite");
+}
+
+#define p_sql_open_db  p_sql_missing
+#define p_sql_prepare  p_sql_missing
+#define p_sql_step     p_sql_missing
+#define p_sql_columns  p_sql_missing
+#define p_sql_column   p_sql_missing
+#define p_sql_row      p_sql_missing
+
+static void p_sql_native(vm_t *vm) { push(vm, 0); }
+
+void sql_release(vm_t *vm) { (void)vm; }
+
+#endif /* FIFTH_SQLITE */
+
+/* Initialize SQLite primitives */
+void sql_init(vm_t *vm) {
+    vm_add_prim(vm, "sql-open-db", p_sql_open_db, false);
+    vm_add_prim(vm, "sql-prepare", p_sql_prepare, false);
+    vm_add_prim(vm, "sql-step",    p_sql_step,    false);
+    vm_add_prim(vm, "sql-columns", p_sql_columns, false);
+    vm_add_prim(vm, "sql-column",  p_sql_column,  false);
+    vm_add_prim(vm, "sql-row",     p_sql_row,     false);
+    vm_add_prim(vm, "sql-native?", p_sql_native,  false);
+}
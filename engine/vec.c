@@ -0,0 +1,172 @@
+/* vec.c - Kernels over cell arrays
+ *
+ * A loop over an array written in Forth (  i cells a + @ +  ) pays a
+ * dispatch for every word and every element. These primitives take a
+ * whole array of n cells in mem[] and do the loop in C (summing a
+ * 100k-row column is one call), checking the address range once per
+ * call instead of once per element.
+ *
+ *   v+      ( a b c n -- )     c[i] = a[i] + b[i]
+ *   v*      ( a b c n -- )     c[i] = a[i] * b[i]
+ *   vscale  ( a n x -- )       a[i] = a[i] * x
+ *   vfill   ( a n x -- )       a[i] = x
+ *   vsum    ( a n -- sum )
+ *   vdot    ( a b n -- sum )   Sum of a[i] * b[i]
+ *   vmin    ( a n -- x )       0 when n = 0
+ *   vmax    ( a n -- x )
+ *
+ * c may be a or b; other overlaps are undefined. Arithmetic wraps, as
+ * with + and *.
+ *
+ * The loops are plain C for the compiler to vectorize: SSE2 or NEON,
+ * which every x86-64 and AArch64 CPU has. On x86-64 a second copy is
+ * compiled for AVX2, and vec_init picks it when the CPU supports it.
+ */
+
+#include "fifth.h"
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("tree-vectorize", "vect-cost-model=dynamic")  /* -O2 alone skips them */
+#endif
+
+/* Unsigned, so that overflow wraps instead of being undefined */
+#define VEC_KERNELS(sfx, attr)                                                  \
+attr static void add_##sfx(ucell_t *c, const ucell_t *a, const ucell_t *b, size_t n) { \
+    for (size_t i = 0; i < n; i++) c[i] = a[i] + b[i];                          \
+}                                                                               \
+attr static void mul_##sfx(ucell_t *c, const ucell_t *a, const ucell_t *b, size_t n) { \
+    for (size_t i = 0; i < n; i++) c[i] = a[i] * b[i];                          \
+}                                                                               \
+attr static void scale_##sfx(ucell_t *a, size_t n, ucell_t x) {                 \
+    for (size_t i = 0; i < n; i++) a[i] *= x;                                   \
+}                                                                               \
+attr static void fill_##sfx(ucell_t *a, size_t n, ucell_t x) {                  \
+    for (size_t i = 0; i < n; i++) a[i] = x;                                    \
+}                                                                               \
+attr static ucell_t sum_##sfx(const ucell_t *a, size_t n) {                     \
+    ucell_t s = 0;                                                              \
+    for (size_t i = 0; i < n; i++) s += a[i];                                   \
+    return s;                                                                   \
+}                                                                               \
+attr static ucell_t dot_##sfx(const ucell_t *a, const ucell_t *b, size_t n) {   \
+    ucell_t s = 0;                                                              \
+    for (size_t i = 0; i < n; i++) s += a[i] * b[i];                            \
+    return s;                                                                   \
+}                                                                               \
+attr static cell_t min_##sfx(const cell_t *a, size_t n) {                       \
+    cell_t m = a[0];                                                            \
+    for (size_t i = 1; i < n; i++) m = a[i] < m ? a[i] : m;                     \
+    return m;                                                                   \
+}                                                                               \
+attr static cell_t max_##sfx(const cell_t *a, size_t n) {                       \
+    cell_t m = a[0];                                                            \
+    for (size_t i = 1; i < n; i++) m = a[i] > m ? a[i] : m;                     \
+    return m;                                                                   \
+}
+
+VEC_KERNELS(base, )
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define VEC_AVX2 1
+VEC_KERNELS(avx2, __attribute__((target("avx2"))))
+#endif
+
+static struct {
+    void    (*add)(ucell_t *, const ucell_t *, const ucell_t *, size_t);
+    void    (*mul)(ucell_t *, const ucell_t *, const ucell_t *, size_t);
+    void    (*scale)(ucell_t *, size_t, ucell_t);
+    void    (*fill)(ucell_t *, size_t, ucell_t);
+    ucell_t (*sum)(const ucell_t *, size_t);
+    ucell_t (*dot)(const ucell_t *, const ucell_t *, size_t);
+    cell_t  (*min)(const cell_t *, size_t);
+    cell_t  (*max)(const cell_t *, size_t);
+} k = { add_base, mul_base, scale_base, fill_base, sum_base, dot_base, min_base, max_base };
+
+/* The n cells at addr as a C pointer, or NULL (and an abort) if they
+ * are not all inside mem[] or one of its views */
+void *vm_cells(vm_t *vm, cell_t addr, cell_t n, const char *word) {
+    if (n < 0 || (size_t)n > (vm_mem_size + VIEW_SPACE) / sizeof(cell_t) ||
+        !vm_range_valid(vm, addr, n * (cell_t)sizeof(cell_t))) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "%s: address out of range", word);
+        vm_abort(vm, msg);
+        return NULL;
+    }
+    return vm->mem + addr;
+}
+
+/* V+ ( a b c n -- ) */
+static void p_vadd(vm_t *vm) {
+    cell_t n = pop(vm), c = pop(vm), b = pop(vm), a = pop(vm);
+    ucell_t *pa = vm_cells(vm, a, n, "V+"), *pb = pa ? vm_cells(vm, b, n, "V+") : NULL;
+    ucell_t *pc = pb ? vm_cells(vm, c, n, "V+") : NULL;
+    if (pc) k.add(pc, pa, pb, (size_t)n);
+}
+
+/* V* ( a b c n -- ) */
+static void p_vmul(vm_t *vm) {
+    cell_t n = pop(vm), c = pop(vm), b = pop(vm), a = pop(vm);
+    ucell_t *pa = vm_cells(vm, a, n, "V*"), *pb = pa ? vm_cells(vm, b, n, "V*") : NULL;
+    ucell_t *pc = pb ? vm_cells(vm, c, n, "V*") : NULL;
+    if (pc) k.mul(pc, pa, pb, (size_t)n);
+}
+
+/* VSCALE ( a n x -- ) */
+static void p_vscale(vm_t *vm) {
+    cell_t x = pop(vm), n = pop(vm), a = pop(vm);
+    ucell_t *p = vm_cells(vm, a, n, "VSCALE");
+    if (p) k.scale(p, (size_t)n, (ucell_t)x);
+}
+
+/* VFILL ( a n x -- ) */
+static void p_vfill(vm_t *vm) {
+    cell_t x = pop(vm), n = pop(vm), a = pop(vm);
+    ucell_t *p = vm_cells(vm, a, n, "VFILL");
+    if (p) k.fill(p, (size_t)n, (ucell_t)x);
+}
+
+/* VSUM ( a n -- sum ) */
+static void p_vsum(vm_t *vm) {
+    cell_t n = pop(vm), a = pop(vm);
+    ucell_t *p = vm_cells(vm, a, n, "VSUM");
+    if (p) push(vm, (cell_t)k.sum(p, (size_t)n));
+}
+
+/* VDOT ( a b n -- sum ) */
+static void p_vdot(vm_t *vm) {
+    cell_t n = pop(vm), b = pop(vm), a = pop(vm);
+    ucell_t *pa = vm_cells(vm, a, n, "VDOT"), *pb = pa ? vm_cells(vm, b, n, "VDOT") : NULL;
+    if (pb) push(vm, (cell_t)k.dot(pa, pb, (size_t)n));
+}
+
+/* VMIN ( a n -- x ) */
+static void p_vmin(vm_t *vm) {
+    cell_t n = pop(vm), a = pop(vm);
+    cell_t *p = vm_cells(vm, a, n, "VMIN");
+    if (p) push(vm, n ? k.min(p, (size_t)n) : 0);
+}
+
+/* VMAX ( a n -- x ) */
+static void p_vmax(vm_t *vm) {
+    cell_t n = pop(vm), a = pop(vm);
+    cell_t *p = vm_cells(vm, a, n, "VMAX");
+    if (p) push(vm, n ? k.max(p, (size_t)n) : 0);
+}
+
+void vec_init(vm_t *vm) {
+#ifdef VEC_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        k.add = add_avx2;     k.mul = mul_avx2;
+        k.scale = scale_avx2; k.fill = fill_avx2;
+        k.sum = sum_avx2;     k.dot = dot_avx2;
+        k.min = min_avx2;     k.max = max_avx2;
+    }
+#endif
+    vm_add_prim(vm, "v+",     p_vadd,   false);
+    vm_add_prim(vm, "v*",     p_vmul,   false);
+    vm_add_prim(vm, "vscale", p_vscale, false);
+    vm_add_prim(vm, "vfill",  p_vfill,  false);
+    vm_add_prim(vm, "vsum",   p_vsum,   false);
+    vm_add_prim(vm, "vdot",   p_vdot,   false);
+    vm_add_prim(vm, "vmin",   p_vmin,   false);
+    vm_add_prim(vm, "vmax",   p_vmax,   false);
+}
@@ -7,13 +7,20 @@
 #include "fifth.h"
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* === Word Handlers === */
 
 void docol(vm_t *vm) {
     rpush(vm, vm->ip);
     vm->ip = vm->dict[vm->w].param;
+    if (vm_jit_threshold) vm_jit_hit(vm, &vm->dict[vm->w]);
 }
 
 void dovar(vm_t *vm) {
@@ -37,6 +44,10 @@ void dodoes(vm_t *vm) {
  * until the word returns via (exit).
  */
 void vm_execute(vm_t *vm, int xt) {
+    if (vm_profile_mode) {
+        vm_execute_profiled(vm, xt);
+        return;
+    }
     vm->w = xt;
     if (vm->dict[xt].code == docol || vm->dict[xt].code == dodoes) {
         vm->dict[xt].code(vm);  /* Sets up IP */
@@ -46,8 +57,14 @@ void vm_execute(vm_t *vm, int xt) {
     }
 }
 
+#ifndef FIFTH_DIRECT_THREADED
+
 /* Run compiled code starting from current IP until return stack empties */
 void vm_run(vm_t *vm) {
+    if (vm_profile_mode) {
+        vm_run_profiled(vm);
+        return;
+    }
     cell_t *rsp_base = vm->rsp;
     while (vm->running && vm->rsp <= rsp_base) {
         cell_t xt = vm_fetch_ip(vm);
@@ -56,15 +73,175 @@ void vm_run(vm_t *vm) {
     }
 }
 
+#else
+
+/* Direct-threaded inner interpreter.
+ *
+ * Each cell is a code-field address, so dispatch is a single add off the
+ * dictionary base. IP, SP and RSP live in locals for the whole run and
+ * are only written back to the VM around calls into C primitives. The
+ * word handlers and the runtime words the compiler emits are handled
+ * inline; their definitions in this file and prims.c remain the
+ * reference semantics (and are what vm_execute uses).
+ */
+void vm_run(vm_t *vm) {
+    if (vm_profile_mode) {
+        vm_run_profiled(vm);
+        return;
+    }
+    uint8_t *const mem  = vm->mem;
+    uint8_t *const dict = (uint8_t *)vm->dict;
+    const prim_fn c_lit     = vm->dict[vm->xt_lit].code;
+    const prim_fn c_branch  = vm->dict[vm->xt_branch].code;
+    const prim_fn c_0branch = vm->dict[vm->xt_0branch].code;
+    const prim_fn c_exit    = vm->dict[vm->xt_exit].code;
+    const prim_fn c_do      = vm->dict[vm->xt_do].code;
+    const prim_fn c_loop    = vm->dict[vm->xt_loop].code;
+
+    cell_t *ip  = (cell_t *)(mem + vm->ip);
+    cell_t *sp  = vm->sp;
+    cell_t *rsp = vm->rsp;
+    cell_t *const rsp_base = rsp;
+
+    while (vm->running) {
+        dict_entry_t *w = (dict_entry_t *)(dict + *ip++);
+        prim_fn code = w->code;
+
+        if (code == docol) {
+            *--rsp = (cell_t)((uint8_t *)ip - mem);
+            ip = (cell_t *)(mem + w->param);
+            if (vm_jit_threshold) vm_jit_hit(vm, w);
+        } else if (code == c_lit) {
+            *--sp = *ip++;
+        } else if (code == c_0branch) {
+            cell_t dest = *ip++;
+            if (*sp++ == 0) ip = (cell_t *)(mem + dest);
+        } else if (code == c_branch) {
+            ip = (cell_t *)(mem + *ip);
+        } else if (code == c_exit) {
+            ip = (cell_t *)(mem + *rsp++);
+            if (rsp > rsp_base) break;
+        } else if (code == c_loop) {
+            cell_t dest = *ip++;
+            cell_t idx = rsp[0] + 1;
+            if (idx == rsp[1]) {
+                rsp += 2;
+            } else {
+                rsp[0] = idx;
+                ip = (cell_t *)(mem + dest);
+            }
+        } else if (code == c_do) {
+            rsp -= 2;
+            rsp[0] = sp[0];
+            rsp[1] = sp[1];
+            sp += 2;
+        } else if (code == docon || code == dovar) {
+            *--sp = w->param;
+        } else if (code == dodoes) {
+            *--sp = w->param;
+            *--rsp = (cell_t)((uint8_t *)ip - mem);
+            ip = (cell_t *)(mem + w->does);
+        } else {
+            vm->ip = (cell_t)((uint8_t *)ip - mem);
+            vm->sp = sp;
+            vm->rsp = rsp;
+            vm->w = (cell_t)(w - vm->dict);
+            code(vm);
+            ip = (cell_t *)(mem + vm->ip);
+            sp = vm->sp;
+            rsp = vm->rsp;
+            if (rsp > rsp_base) break;
+        }
+    }
+
+    vm->ip = (cell_t)((uint8_t *)ip - mem);
+    vm->sp = sp;
+    vm->rsp = rsp;
+}
+
+#endif /* FIFTH_DIRECT_THREADED */
+
 /* === Dictionary Operations === */
 
-/* Find a word by name. Returns dict index or -1. */
+/* Case-folded FNV-1a, so "DUP" and "dup" share a bucket. The low bits
+ * pick the bucket and the high bits the two bloom filter bits. */
+static uint32_t hash_name(const char *name, int len) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash ^= (uint8_t)tolower((unsigned char)name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline uint32_t bloom_bit2(uint32_t h) {
+    return (h * 0x9E3779B1u) >> 16;
+}
+
+static inline bool bloom_maybe(const vm_t *vm, uint32_t h) {
+    uint32_t a = (h >> 16) & (BLOOM_BITS - 1), b = bloom_bit2(h) & (BLOOM_BITS - 1);
+    return ((vm->name_bloom[a >> 6] >> (a & 63)) & (vm->name_bloom[b >> 6] >> (b & 63)) & 1) != 0;
+}
+
+/* Does a token have the shape of a number: optional sign, optional
+ * $ # % or 0x prefix, then a decimal digit (any hex digit after $ or
+ * 0x) and hex digits only? "2drop", "1+" and "0=" do not. */
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+static inline bool is_xdigit(char c) {
+    return is_digit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+static bool numeric_shape(const char *s, int len) {
+    int i = 0;
+    if (len > 1 && (s[0] == '-' || s[0] == '+')) i = 1;
+    bool hex = false;
+    if (i < len && (s[i] == '#' || s[i] == '%')) i++;
+    else if (i < len && s[i] == '$') { hex = true; i++; }
+    else if (len > i + 2 && s[i] == '0' && (s[i + 1] == 'x' || s[i + 1] == 'X')) { hex = true; i += 2; }
+    if (i >= len || !(hex ? is_xdigit(s[i]) : is_digit(s[i])))
+        return false;
+    for (; i < len; i++)
+        if (!is_xdigit(s[i])) return false;
+    return true;
+}
+
+/* Add an entry to the head of its bucket. Entries are created in link
+ * order, so each chain lists newer definitions first and shadowing works
+ * exactly as it does walking the link chain from latest. */
+void vm_hash_insert(vm_t *vm, int idx) {
+    int len = vm->heads[idx].flags & F_LENMASK;
+    uint32_t h = hash_name(vm->heads[idx].name, len);
+    unsigned bucket = h & (HASH_BUCKETS - 1);
+    vm->hash_next[idx] = vm->hash_head[bucket];
+    vm->hash_head[bucket] = idx;
+    uint32_t a = (h >> 16) & (BLOOM_BITS - 1), b = bloom_bit2(h) & (BLOOM_BITS - 1);
+    vm->name_bloom[a >> 6] |= (uint64_t)1 << (a & 63);
+    vm->name_bloom[b >> 6] |= (uint64_t)1 << (b & 63);
+    if (numeric_shape(vm->heads[idx].name, len)) vm->numeric_names++;
+}
+
+/* Rebuild the whole index from heads[] (clones, images) */
+void vm_hash_rebuild(vm_t *vm) {
+    for (int h = 0; h < HASH_BUCKETS; h++)
+        vm->hash_head[h] = -1;
+    memset(vm->name_bloom, 0, sizeof(vm->name_bloom));
+    vm->numeric_names = 0;
+    for (int i = 0; i < vm->dict_count; i++)
+        vm_hash_insert(vm, i);
+}
+
+/* Find a word by name. Returns dict index or -1.
+ * HIDDEN is tested at lookup time, so a definition under construction
+ * stays invisible until ; without touching the index. Most misses stop
+ * at the bloom filter without touching a chain. */
 int vm_find(vm_t *vm, const char *name, int len) {
-    for (int i = vm->latest; i >= 0; i = vm->dict[i].link) {
-        if (vm->dict[i].flags & F_HIDDEN) continue;
-        int entry_len = vm->dict[i].flags & F_LENMASK;
+    uint32_t h = hash_name(name, len);
+    if (!bloom_maybe(vm, h)) return -1;
+    for (int i = vm->hash_head[h & (HASH_BUCKETS - 1)]; i >= 0; i = vm->hash_next[i]) {
+        if (vm->heads[i].flags & F_HIDDEN) continue;
+        int entry_len = vm->heads[i].flags & F_LENMASK;
         if (entry_len != len) continue;
-        if (strncasecmp(vm->dict[i].name, name, len) == 0)
+        if (strncasecmp(vm->heads[i].name, name, len) == 0)
             return i;
     }
     return -1;
@@ -72,18 +249,24 @@ int vm_find(vm_t *vm, const char *name, int len) {
 
 /* Add a C primitive to the dictionary */
 int vm_add_prim(vm_t *vm, const char *name, prim_fn fn, bool immediate) {
+    if (vm->dict_count >= vm_dict_size) {
+        fprintf(stderr, "Dictionary full registering %s\n", name);
+        exit(1);
+    }
     int idx = vm->dict_count++;
     int len = strlen(name);
     if (len > NAME_MAX_LEN) len = NAME_MAX_LEN;
 
-    vm->dict[idx].link = vm->latest;
-    vm->dict[idx].flags = (uint8_t)len | (immediate ? F_IMMEDIATE : 0);
-    memcpy(vm->dict[idx].name, name, len);
-    vm->dict[idx].name[len] = '\0';
+    vm->heads[idx].link = vm->latest;
+    vm->heads[idx].flags = (uint8_t)len | (immediate ? F_IMMEDIATE : 0);
+    vm->heads[idx].attrs = 0;
+    memcpy(vm->heads[idx].name, name, len);
+    vm->heads[idx].name[len] = '\0';
     vm->dict[idx].code = fn;
     vm->dict[idx].param = 0;
     vm->dict[idx].does = -1;
     vm->latest = idx;
+    vm_hash_insert(vm, idx);
     return idx;
 }
 
@@ -106,15 +289,19 @@ void vm_add_variable(vm_t *vm, const char *name, cell_t initial) {
 
 /* Skip whitespace, parse next word into buf. Returns length. */
 int vm_word(vm_t *vm, char *buf) {
+    const char *tib = vm->tib;
+    int pos = vm->tib_pos, end = vm->tib_len;
+
     /* Skip leading whitespace */
-    while (vm->tib_pos < vm->tib_len && vm->tib[vm->tib_pos] <= ' ')
-        vm->tib_pos++;
+    while (pos < end && tib[pos] <= ' ')
+        pos++;
 
     int len = 0;
-    while (vm->tib_pos < vm->tib_len && vm->tib[vm->tib_pos] > ' ' && len < NAME_MAX_LEN) {
-        buf[len++] = vm->tib[vm->tib_pos++];
+    while (pos < end && tib[pos] > ' ' && len < NAME_MAX_LEN) {
+        buf[len++] = tib[pos++];
     }
     buf[len] = '\0';
+    vm->tib_pos = pos;
     return len;
 }
 
@@ -175,37 +362,103 @@ bool vm_try_number(vm_t *vm, const char *s, int len, cell_t *result) {
 /* === Abort === */
 
 void vm_abort(vm_t *vm, const char *msg) {
+    vm_out_reset(vm);                /* Keep output ahead of the message */
     fprintf(stderr, "ABORT: %s\n", msg);
-    /* Reset stacks */
+    /* Reset stacks, and IP to the "no caller" value the next
+     * interpreted word's frame will carry */
     vm->sp = vm->dstack + DSTACK_SIZE;
     vm->rsp = vm->rstack + RSTACK_SIZE;
+    vm->ip = 0;
     vm->state = 0;
-    /* If loading a file, close it and return to interactive */
-    while (vm->input_depth > 0) {
-        fclose(vm->input[vm->input_depth]);
-        vm->input_depth--;
+    vm->aborts++;
+    /* If loading a file, return to interactive: each vm_load_file
+     * below sees its level gone and unwinds */
+    vm->input_depth = 0;
+}
+
+/* === Stack Faults === */
+
+#define TRACE_FRAMES  8              /* Distinct words a backtrace shows */
+
+/* Abort for the stack fault c caught, naming the colon words on the
+ * return stack, innermost first, and then the word c ran. The
+ * direct-threaded loop and JIT code keep RSP in a register, so there
+ * the walk starts where they last stored it; after a return stack
+ * overflow the whole stack is frames. */
+static void stack_abort(vm_t *vm, const vm_catch_t *c) {
+    static const char *const what[] = {
+        [FAULT_DSTACK_OVER]  = "Data stack overflow",
+        [FAULT_DSTACK_UNDER] = "Data stack underflow",
+        [FAULT_RSTACK_OVER]  = "Return stack overflow",
+        [FAULT_RSTACK_UNDER] = "Return stack underflow",
+    };
+    cell_t *top = vm->rstack + RSTACK_SIZE, *r = vm->rsp;
+    if (c->fault == FAULT_RSTACK_OVER || r < vm->rstack || r > top) r = vm->rstack;
+
+    /* Runs of the same word count as one frame */
+    int xts[TRACE_FRAMES + 1], runs[TRACE_FRAMES + 1], n = 0;
+    for (; r < top; r++) {
+        cell_t ret = *r;
+        if (ret < (cell_t)sizeof(cell_t) || ret > vm->here || ret % (cell_t)sizeof(cell_t))
+            continue;
+        cell_t call = *(cell_t *)(vm->mem + ret - sizeof(cell_t));
+        int callee = vm_cell_to_xt(call);
+        if (call < 0 || vm_xt_to_cell(callee) != call || callee >= vm->dict_count) continue;
+        prim_fn code = vm->dict[callee].code;
+        if (code != docol && code != dodoes && !vm_jit_owns(code)) continue;
+        if (n > 0 && xts[n - 1] == callee) {
+            runs[n - 1]++;
+        } else if (n <= TRACE_FRAMES) {
+            xts[n] = callee;
+            runs[n++] = 1;
+        }
+    }
+    vm_abort(vm, what[c->fault]);
+    for (int i = 0; i < n && i < TRACE_FRAMES; i++) {
+        dict_head_t *d = &vm->heads[xts[i]];
+        if (runs[i] > 1) fprintf(stderr, "  in %.*s (x%d)\n", d->flags & F_LENMASK, d->name, runs[i]);
+        else fprintf(stderr, "  in %.*s\n", d->flags & F_LENMASK, d->name);
     }
+    if (n > TRACE_FRAMES) fprintf(stderr, "  ...\n");
+    if (c->xt >= 0 && (n == 0 || xts[n - 1] != c->xt)) {
+        dict_head_t *d = &vm->heads[c->xt];
+        fprintf(stderr, "  in %.*s\n", d->flags & F_LENMASK, d->name);
+    }
+}
+
+/* vm_execute inside a catch: a stack fault in xt lands back here, with
+ * everything it had on the C stack abandoned */
+void vm_execute_caught(vm_t *vm, int xt) {
+    vm_catch_t c = { .vm = vm, .xt = xt, .prev = vm_catch_top };
+    vm_catch_top = &c;
+    if (sigsetjmp(c.jb, 0) == 0) vm_execute(vm, xt);
+    else stack_abort(vm, &c);
+    vm_catch_top = c.prev;
 }
 
 /* === Outer Interpreter === */
 
-/* Interpret a single line (already in TIB) */
-static void vm_interpret_tib(vm_t *vm) {
+/* The words of the line in TIB, under the catch c */
+static void interpret_words(vm_t *vm, vm_catch_t *c) {
     char word_buf[NAME_MAX_LEN + 1];
 
     while (vm->running) {
         int len = vm_word(vm, word_buf);
         if (len == 0) break; /* end of line */
 
-        /* Try to find the word */
-        int xt = vm_find(vm, word_buf, len);
+        /* Try to find the word. A literal skips the lookup while no
+         * name in the dictionary is shaped like a number. */
+        int xt = vm->numeric_names == 0 && numeric_shape(word_buf, len)
+                 ? -1 : vm_find(vm, word_buf, len);
         if (xt >= 0) {
-            if (vm->state && !(vm->dict[xt].flags & F_IMMEDIATE)) {
+            if (vm->state && !(vm->heads[xt].flags & F_IMMEDIATE)) {
                 /* Compiling: compile the XT */
-                vm_compile_cell(vm, xt);
+                vm_compile_xt(vm, xt);
             } else {
                 /* Interpreting (or immediate word): execute */
+                c->xt = xt;
                 vm_execute(vm, xt);
+                c->xt = -1;
             }
             continue;
         }
@@ -215,7 +468,7 @@ static void vm_interpret_tib(vm_t *vm) {
         if (vm_try_number(vm, word_buf, len, &num)) {
             if (vm->state) {
                 /* Compiling: compile as literal */
-                vm_compile_cell(vm, vm->xt_lit);
+                vm_compile_xt(vm, vm->xt_lit);
                 vm_compile_cell(vm, num);
             } else {
                 push(vm, num);
@@ -230,76 +483,279 @@ static void vm_interpret_tib(vm_t *vm) {
     }
 }
 
-/* Interpret a C string */
+/* Interpret a single line (already in TIB). A stack fault anywhere in
+ * it lands back here and ends the line, as an abort does. */
+static void vm_interpret_tib(vm_t *vm) {
+    vm_catch_t c = { .vm = vm, .xt = -1, .prev = vm_catch_top };
+    vm_catch_top = &c;
+    if (sigsetjmp(c.jb, 0) == 0) interpret_words(vm, &c);
+    else stack_abort(vm, &c);
+    vm_catch_top = c.prev;
+}
+
+/* Interpret a string in place; it must outlive the call */
 void vm_interpret_line(vm_t *vm, const char *line) {
-    int len = strlen(line);
-    if (len >= TIB_SIZE) len = TIB_SIZE - 1;
-    memcpy(vm->tib, line, len);
-    vm->tib[len] = '\0';
-    vm->tib_len = len;
+    const char *tib = vm->tib;
+    int tib_len = vm->tib_len, tib_pos = vm->tib_pos;
+    bool tib_file = vm->tib_file;
+
+    size_t len = strlen(line);
+    vm->tib = line;
+    vm->tib_len = len > INT_MAX ? INT_MAX : (int)len;
     vm->tib_pos = 0;
+    vm->tib_file = false;
     vm_interpret_tib(vm);
+
+    vm->tib = tib;
+    vm->tib_len = tib_len;
+    vm->tib_pos = tib_pos;
+    vm->tib_file = tib_file;
 }
 
 /* === File Loading === */
 
+/* Source files are mapped whole (read, for pipes) and parsed in place,
+ * a line at a time, with no copy and no length limit. The text stays
+ * in a process-wide cache keyed by the file's identity and mtime, so
+ * INCLUDE, REQUIRE and task VMs loading the same file share one copy.
+ * A file changed on disk gets a new entry; the old one goes when
+ * nothing is parsing it. */
+
+#define SOURCE_CACHE 64
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+typedef struct {
+    dev_t        dev;
+    ino_t        ino;
+    off_t        size;
+    struct timespec mtime;
+    char        *text;               /* NULL = free slot */
+    size_t       len;
+    bool         mapped;             /* munmap, else free */
+    bool         cached;             /* In source_cache[] */
+    int          refs;               /* Loads in progress */
+    unsigned     used;               /* Last use, for eviction */
+} source_file_t;
+
+static source_file_t source_cache[SOURCE_CACHE];
+static unsigned source_clock;
+static pthread_mutex_t source_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef __APPLE__
+#define ST_MTIME(st) ((st).st_mtimespec)
+#else
+#define ST_MTIME(st) ((st).st_mtim)
+#endif
+
+static void source_drop(source_file_t *f) {
+    if (f->mapped) munmap(f->text, f->len);
+    else free(f->text);
+    f->text = NULL;
+}
+
+/* Read a pipe or other unmappable file to EOF */
+static char *source_read(int fd, size_t *len) {
+    size_t cap = 65536, n = 0;
+    char *buf = malloc(cap);
+    while (buf) {
+        if (n == cap) {
+            char *grown = realloc(buf, cap *= 2);
+            if (!grown) break;
+            buf = grown;
+        }
+        ssize_t r = read(fd, buf + n, cap - n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) break;
+        if (r == 0) { *len = n; return buf; }
+        n += (size_t)r;
+    }
+    free(buf);
+    return NULL;
+}
+
+static source_file_t *source_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return NULL; }
+
+    bool regular = S_ISREG(st.st_mode);
+    struct timespec mt = ST_MTIME(st);
+    pthread_mutex_lock(&source_lock);
+    source_clock++;
+    if (regular) {
+        for (int i = 0; i < SOURCE_CACHE; i++) {
+            source_file_t *f = &source_cache[i];
+            if (!f->text || f->dev != st.st_dev || f->ino != st.st_ino) continue;
+            if (f->size == st.st_size && f->mtime.tv_sec == mt.tv_sec &&
+                f->mtime.tv_nsec == mt.tv_nsec) {
+                f->refs++;
+                f->used = source_clock;
+                pthread_mutex_unlock(&source_lock);
+                close(fd);
+                return f;
+            }
+            if (f->refs == 0) source_drop(f);      /* Changed on disk */
+        }
+    }
+    pthread_mutex_unlock(&source_lock);
+
+    source_file_t nf = { st.st_dev, st.st_ino, st.st_size, mt, NULL, 0, false, false, 1, 0 };
+    if (regular && st.st_size > 0) {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (p != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            nf.text = p;
+            nf.len = (size_t)st.st_size;
+            nf.mapped = true;
+        }
+    }
+    if (!nf.text) nf.text = source_read(fd, &nf.len);
+    close(fd);
+    if (!nf.text) return NULL;
+
+    /* Cache it in a free slot, else over the least recently used idle
+     * entry; with every slot busy it is private to this load */
+    pthread_mutex_lock(&source_lock);
+    source_file_t *slot = NULL;
+    for (int i = 0; regular && i < SOURCE_CACHE; i++) {
+        source_file_t *f = &source_cache[i];
+        if (!f->text) { slot = f; break; }
+        if (f->refs == 0 && (!slot || f->used < slot->used)) slot = f;
+    }
+    if (slot) {
+        if (slot->text) source_drop(slot);
+        nf.cached = true;
+        nf.used = source_clock;
+        *slot = nf;
+    }
+    pthread_mutex_unlock(&source_lock);
+    if (slot) return slot;
+
+    source_file_t *f = malloc(sizeof(*f));
+    if (!f) { source_drop(&nf); return NULL; }
+    *f = nf;
+    return f;
+}
+
+static void source_close(source_file_t *f) {
+    if (!f->cached) {
+        source_drop(f);
+        free(f);
+        return;
+    }
+    pthread_mutex_lock(&source_lock);
+    f->refs--;
+    pthread_mutex_unlock(&source_lock);
+}
+
+/* REFILL: make the next line of the file being loaded the TIB. False
+ * at end of file, or when the TIB is not a file line (REPL, -e). */
+bool vm_refill(vm_t *vm) {
+    if (vm->input_depth == 0 || !vm->tib_file) return false;
+    vm_source_t *src = &vm->input[vm->input_depth];
+    if (src->pos >= src->len) return false;
+
+    const char *line = src->text + src->pos;
+    size_t n = src->len - src->pos;
+    const char *nl = memchr(line, '\n', n);
+    size_t len = nl ? (size_t)(nl - line) : n;
+    src->pos += len + (nl != NULL);
+    while (len > 0 && line[len-1] == '\r') len--;
+
+    vm->tib = line;
+    vm->tib_len = len > INT_MAX ? INT_MAX : (int)len;
+    vm->tib_pos = 0;
+    return true;
+}
+
 int vm_load_file(vm_t *vm, const char *path) {
-    FILE *f = fopen(path, "r");
+    source_file_t *f = source_open(path);
     if (!f) {
         fprintf(stderr, "Cannot open: %s\n", path);
         return -1;
     }
+    int rc = vm_load_source(vm, f->text, f->len);
+    source_close(f);
+    return rc;
+}
 
-    vm->input_depth++;
-    vm->input[vm->input_depth] = f;
+/* Interpret text[0..len) as the contents of a file */
+int vm_load_source(vm_t *vm, const char *text, size_t len) {
+    if (vm->input_depth >= MAX_FILES - 1) {
+        vm_abort(vm, "INCLUDE nested too deeply");
+        return -1;
+    }
 
-    char line[TIB_SIZE];
-    while (vm->running && fgets(line, sizeof(line), f)) {
-        /* Strip newline */
-        int len = strlen(line);
-        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
-            line[--len] = '\0';
+    /* The including line resumes after the file */
+    const char *tib = vm->tib;
+    int tib_len = vm->tib_len, tib_pos = vm->tib_pos;
+    bool tib_file = vm->tib_file;
 
-        vm->tib_len = len;
-        memcpy(vm->tib, line, len + 1);
-        vm->tib_pos = 0;
+    int depth = ++vm->input_depth;
+    vm->input[depth] = (vm_source_t){ text, len, 0 };
+    vm->tib_file = true;
+    while (vm->running && vm->input_depth == depth && vm_refill(vm))
         vm_interpret_tib(vm);
-    }
+    bool aborted = vm->input_depth != depth;
+    if (!aborted) vm->input_depth--;
 
-    fclose(f);
-    vm->input_depth--;
+    vm->tib = tib;
+    vm->tib_len = tib_len;
+    vm->tib_pos = aborted ? tib_len : tib_pos;   /* An abort drops the rest */
+    vm->tib_file = tib_file;
     return 0;
 }
 
 /* === REPL === */
 
 void vm_repl(vm_t *vm) {
-    char line[TIB_SIZE];
+    char *line = vm->tib_buf;
 
     while (vm->running) {
+        vm_flush(vm);
         if (vm->state)
             fprintf(stderr, "  compiled ");
         else
             fprintf(stderr, "  ok\n");
 
-        if (!fgets(line, sizeof(line), stdin))
+        if (!fgets(line, TIB_SIZE, stdin))
             break;
 
         int len = strlen(line);
         while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
             line[--len] = '\0';
 
+        vm->tib = line;
         vm->tib_len = len;
-        memcpy(vm->tib, line, len + 1);
         vm->tib_pos = 0;
+        vm->tib_file = false;
         vm_interpret_tib(vm);
     }
 }
 
 /* === VM Lifecycle === */
 
-vm_t *vm_create(void) {
+/* Allocate a zeroed VM. Data space is a separate anonymous mapping,
+ * reserved at vm_mem_size and committed as it is touched (region.c),
+ * and an image can be mapped over it copy-on-write (image.c). */
+vm_t *vm_alloc(void) {
     vm_t *vm = calloc(1, sizeof(vm_t));
+    if (!vm) return NULL;
+    if (vm_region_alloc(vm) != 0) {
+        free(vm);
+        return NULL;
+    }
+    return vm;
+}
+
+vm_t *vm_create(void) {
+    vm_t *vm = vm_alloc();
     if (!vm) {
         fprintf(stderr, "Out of memory\n");
         exit(1);
@@ -317,13 +773,22 @@ vm_t *vm_create(void) {
     vm->dict_count = 0;
     vm->running = true;
     vm->out = stdout;
+    vm->obuf.cap = OUT_BUF_SIZE;
+    vm->obuf.line = isatty(fileno(stdout));
     vm->input_depth = 0;
     vm->loaded_count = 0;
+    vm_hash_rebuild(vm);
 
     /* Register all C primitives */
     prims_init(vm);
     io_init(vm);
     spawn_init(vm);
+    chan_init(vm);
+    arena_init(vm);
+    fiber_init(vm);
+    vec_init(vm);
+    hmap_init(vm);
+    sort_init(vm);
 
     /* Align HERE after primitive registration */
     vm->here = vm_align(vm->here);
@@ -331,7 +796,12 @@ vm_t *vm_create(void) {
     return vm;
 }
 
-void vm_destroy(vm_t *vm) {
+/* Release what a VM holds besides its memory regions */
+static void vm_release(vm_t *vm) {
+    vm_out_release(vm);
+    sql_release(vm);
+    vm_profile_release(vm);
+    vm_fibers_release(vm);
     /* Close any open files */
     for (int i = 0; i < MAX_FILES; i++) {
         if (vm->files[i]) {
@@ -343,5 +813,38 @@ void vm_destroy(vm_t *vm) {
     for (int i = 0; i < vm->loaded_count; i++) {
         free(vm->loaded_files[i]);
     }
+}
+
+/* Return a finished VM to the zeroed state of a fresh vm_alloc, keeping
+ * its regions and their contents, for reuse by a pool */
+void vm_reset(vm_t *vm) {
+    vm_release(vm);
+    dict_entry_t *dict = vm->dict;
+    dict_head_t *heads = vm->heads;
+    uint8_t *mem = vm->mem;
+    int *hash_next = vm->hash_next;
+    cell_t *dstack = vm->dstack, *rstack = vm->rstack;
+    int region = vm->region;
+    vm_snap_t snap = vm->snap;
+    vm_view_t views[MAX_VIEWS];
+    int view_count = vm->view_count;
+    memcpy(views, vm->views, sizeof(views));
+    memset(vm, 0, sizeof(*vm));
+    vm->dict = dict;
+    vm->heads = heads;
+    vm->mem = mem;
+    vm->hash_next = hash_next;
+    vm->dstack = dstack;
+    vm->rstack = rstack;
+    vm->region = region;
+    vm->snap = snap;
+    memcpy(vm->views, views, sizeof(views));
+    vm->view_count = view_count;
+}
+
+void vm_destroy(vm_t *vm) {
+    if (!vm) return;
+    vm_release(vm);
+    vm_region_free(vm);
     free(vm);
 }
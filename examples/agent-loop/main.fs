@@ -77,7 +77,7 @@ variable escape-len
   s"  > " str+
   response-file str+
   s"  2>&1" str+
-  str$ system drop
+  str$ system
   \ Read result file
   response-file slurp-file
   dup 0= if
@@ -364,7 +364,7 @@ variable retry-delay
   str-reset
   s" sleep " str+
   1000 / 0 <# #s #> str+
-  str$ system drop ;
+  str$ system ;
 
 \ ============================================================
 \ LLM API Interface
@@ -460,7 +460,7 @@ s" /tmp/fifth-agent-llm-response.json" 2constant llm-response-file
   s" -d @" str+ request-file str+
   s"  > " str+ llm-response-file str+
   s"  2>&1" str+
-  str$ system drop
+  str$ system
   llm-response-file slurp-file
   dup 0= if 2drop false exit then
   nip 0> ;
@@ -70,7 +70,7 @@ variable context-file-count
   s"  \"SELECT role, content FROM messages ORDER BY id DESC LIMIT " str+
   0 <# #s #> str+
   s" ;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : get-conversation-context ( -- addr u )
   \ Build context string from recent conversation
@@ -172,7 +172,7 @@ variable working-memory-len
   s" ', " str+
   total-context-tokens @ 0 <# #s #> str+
   s" , datetime('now'));\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : restore-context-state ( snapshot-id -- )
   \ Restore context from database
@@ -34,7 +34,7 @@ variable current-task-len
   s" CREATE TABLE IF NOT EXISTS file_cache (path TEXT PRIMARY KEY, content TEXT, hash TEXT, cached_at TEXT DEFAULT CURRENT_TIMESTAMP);" str+
   s" CREATE TABLE IF NOT EXISTS tasks (id INTEGER PRIMARY KEY, description TEXT, status TEXT DEFAULT 'pending', parent_id INTEGER, result TEXT, created_at TEXT DEFAULT CURRENT_TIMESTAMP);" str+
   s" \"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Message Logging ---
 
@@ -48,7 +48,7 @@ variable current-task-len
   \ TODO: Escape content properly
   str+        \ content
   s" ');\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : log-user ( content-addr content-u -- )
   s" user" 2swap log-message ;
@@ -74,7 +74,7 @@ variable current-task-len
   \ TODO: Actually read file content
   s" [file content]" str+
   s" ' as content);\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : get-context ( -- context-addr context-u )
   \ Gather relevant context from cache
@@ -85,7 +85,7 @@ variable current-task-len
   s" sqlite3 " str+
   db-file str+
   s"  \"DELETE FROM file_cache;\"" str+
-  str$ system drop
+  str$ system
   s" Context cleared" type cr ;
 
 \ --- Task Management ---
@@ -99,7 +99,7 @@ variable next-task-id
   s"  \"INSERT INTO tasks (description, status) VALUES ('" str+
   str+
   s" ', 'pending'); SELECT last_insert_rowid();\"" str+
-  str$ system drop
+  str$ system
   next-task-id @ dup 1+ next-task-id !  ;
 
 : update-task ( id status-addr status-u -- )
@@ -111,7 +111,7 @@ variable next-task-id
   s" ' WHERE id=" str+
   swap 0 <# #s #> str+
   s" ;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : complete-task ( id result-addr result-u -- )
   str-reset
@@ -122,7 +122,7 @@ variable next-task-id
   s" ' WHERE id=" str+
   swap 0 <# #s #> str+
   s" ;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : list-tasks ( -- )
   s" Tasks:" type cr
@@ -130,7 +130,7 @@ variable next-task-id
   s" sqlite3 -column -header " str+
   db-file str+
   s"  \"SELECT id, status, description FROM tasks ORDER BY id DESC LIMIT 10;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Tool Dispatch ---
 
@@ -156,7 +156,7 @@ variable next-task-id
 
 : tool-shell ( cmd-addr cmd-u -- result-addr result-u )
   s" [Executing: " type 2dup type s" ]" type cr
-  system drop
+  system
   s" {\"status\": \"success\", \"output\": \"...\"}" ;
 
 : tool-search ( pattern-addr pattern-u -- result-addr result-u )
@@ -202,7 +202,7 @@ variable response-len
   s" }'" str+
 
   \ Execute and capture response
-  str$ system drop
+  str$ system
 
   \ For demo, return placeholder
   s" I'll help you with that. Let me analyze the code and suggest improvements." ;
@@ -276,7 +276,7 @@ create input-buf input-buf-size allot
   s" sqlite3 -column " str+
   db-file str+
   s"  \"SELECT role, substr(content, 1, 60) FROM messages ORDER BY id DESC LIMIT 10;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- CLI Commands ---
 
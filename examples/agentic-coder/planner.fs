@@ -31,7 +31,7 @@ variable current-task-id
   s" , " str+
   2r> 0 <# #s #> str+  \ priority
   s" ); SELECT last_insert_rowid();\"" str+
-  str$ system drop
+  str$ system
   current-task-id @ dup 1+ current-task-id ! ;
 
 : create-root-task ( desc-addr desc-u -- task-id )
@@ -51,7 +51,7 @@ variable current-task-id
   s" ' WHERE id=" str+
   swap 0 <# #s #> str+
   s" ;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : start-task ( task-id -- )
   s" running" set-task-status ;
@@ -65,7 +65,7 @@ variable current-task-id
   s" ' WHERE id=" str+
   swap 0 <# #s #> str+
   s" ;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : fail-task ( task-id error-addr error-u -- )
   str-reset
@@ -76,7 +76,7 @@ variable current-task-id
   s" ' WHERE id=" str+
   swap 0 <# #s #> str+
   s" ;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Task Queries ---
 
@@ -86,7 +86,7 @@ variable current-task-id
   s" sqlite3 -column " str+
   tasks-db str+
   s"  \"SELECT id, description FROM tasks WHERE status='pending' ORDER BY priority DESC, id;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : get-task-tree ( root-id -- )
   s" Task tree:" type cr
@@ -99,7 +99,7 @@ variable current-task-id
   s"    UNION ALL" str+
   s"    SELECT t.id, t.description, t.status, tree.depth+1 FROM tasks t JOIN tree ON t.parent_id=tree.id" str+
   s"  ) SELECT printf('%*s', depth*2, '') || description, status FROM tree;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : get-next-task ( -- task-id )
   \ Get highest priority pending task
@@ -132,7 +132,7 @@ variable file-len
   str-reset
   s" ls -la " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : tool-list-dir ( path-addr path-u -- json-addr json-u )
   s" {\"status\": \"success\", \"files\": []}"
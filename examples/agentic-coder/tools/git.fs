@@ -4,7 +4,7 @@
 \ --- Status ---
 
 : git-status ( -- )
-  s" git status --short" system drop ;
+  s" git status --short" system ;
 
 : tool-git-status ( -- json-addr json-u )
   \ Get git status as JSON
@@ -15,16 +15,16 @@
 \ --- Diff ---
 
 : git-diff ( -- )
-  s" git diff" system drop ;
+  s" git diff" system ;
 
 : git-diff-staged ( -- )
-  s" git diff --staged" system drop ;
+  s" git diff --staged" system ;
 
 : git-diff-file ( path-addr path-u -- )
   str-reset
   s" git diff " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : tool-git-diff ( path-addr path-u -- json-addr json-u )
   s" {\"status\": \"success\", \"diff\": \"...\"}"
@@ -37,7 +37,7 @@
   str-reset
   s" git log --oneline -" str+
   0 <# #s #> str+
-  str$ system drop ;
+  str$ system ;
 
 : git-log-file ( path-addr path-u n -- )
   str-reset
@@ -45,7 +45,7 @@
   swap 0 <# #s #> str+
   s"  -- " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : tool-git-log ( n -- json-addr json-u )
   drop s" {\"status\": \"success\", \"commits\": []}"
@@ -55,22 +55,22 @@
 \ --- Branch Operations ---
 
 : git-branch ( -- )
-  s" git branch -a" system drop ;
+  s" git branch -a" system ;
 
 : git-current-branch ( -- )
-  s" git branch --show-current" system drop ;
+  s" git branch --show-current" system ;
 
 : git-checkout ( branch-addr branch-u -- )
   str-reset
   s" git checkout " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : git-create-branch ( name-addr name-u -- )
   str-reset
   s" git checkout -b " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : tool-git-branch ( -- json-addr json-u )
   s" {\"status\": \"success\", \"current\": \"\", \"branches\": []}" ;
@@ -81,20 +81,20 @@
   str-reset
   s" git add " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : git-add-all ( -- )
-  s" git add -A" system drop ;
+  s" git add -A" system ;
 
 : git-commit ( message-addr message-u -- )
   str-reset
   s" git commit -m '" str+
   str+
   s" '" str+
-  str$ system drop ;
+  str$ system ;
 
 : git-commit-amend ( -- )
-  s" git commit --amend --no-edit" system drop ;
+  s" git commit --amend --no-edit" system ;
 
 : tool-git-commit ( message-addr message-u files -- json-addr json-u )
   \ Stage files and commit
@@ -106,24 +106,24 @@
 \ --- Stash ---
 
 : git-stash ( -- )
-  s" git stash" system drop ;
+  s" git stash" system ;
 
 : git-stash-pop ( -- )
-  s" git stash pop" system drop ;
+  s" git stash pop" system ;
 
 : git-stash-list ( -- )
-  s" git stash list" system drop ;
+  s" git stash list" system ;
 
 \ --- Remote Operations ---
 
 : git-fetch ( -- )
-  s" git fetch" system drop ;
+  s" git fetch" system ;
 
 : git-pull ( -- )
-  s" git pull" system drop ;
+  s" git pull" system ;
 
 : git-push ( -- )
-  s" git push" system drop ;
+  s" git push" system ;
 
 \ Note: Push should require explicit user confirmation in agent context
 
@@ -133,7 +133,7 @@
   str-reset
   s" git blame " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : git-blame-line ( path-addr path-u line -- )
   str-reset
@@ -143,7 +143,7 @@
   0 <# #s #> str+
   s"  " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Tool Dispatcher ---
 
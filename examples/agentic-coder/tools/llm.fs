@@ -54,7 +54,7 @@ variable llm-response-len
   s" '" str+
 
   \ Execute
-  str$ system drop
+  str$ system
 
   \ TODO: Capture and parse response
   s" [Claude response would appear here]" true ;
@@ -83,7 +83,7 @@ variable llm-response-len
   str+
   s" '" str+
 
-  str$ system drop
+  str$ system
 
   s" [OpenAI response would appear here]" true ;
 
@@ -129,7 +129,7 @@ variable llm-response-len
   s"  -d '{\"input\": \"" str+
   str+
   s" \", \"model\": \"text-embedding-ada-002\"}'" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Streaming (placeholder) ---
 
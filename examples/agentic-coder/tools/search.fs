@@ -11,7 +11,7 @@
   s" ' " str+
   str+
   s"  2>/dev/null | head -20" str+
-  str$ system drop ;
+  str$ system ;
 
 : tool-grep ( pattern-addr pattern-u path-addr path-u -- json-addr json-u )
   \ Grep and return results as JSON
@@ -28,7 +28,7 @@
   s" ' " str+
   str+
   s"  2>/dev/null | head -20" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Glob/Find ---
 
@@ -40,7 +40,7 @@
   s"  -name '" str+
   2swap str+
   s" ' 2>/dev/null | head -20" str+
-  str$ system drop ;
+  str$ system ;
 
 : tool-glob ( pattern-addr pattern-u path-addr path-u -- json-addr json-u )
   s" {\"status\": \"success\", \"files\": []}"
@@ -59,7 +59,7 @@
   s" \\|: " str+
   s" ' " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : find-class ( name-addr name-u path-addr path-u -- )
   \ Find class definition
@@ -68,7 +68,7 @@
   2swap str+
   s" ' " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : tool-find-definition ( symbol-addr symbol-u path-addr path-u -- json-addr json-u )
   s" {\"status\": \"success\", \"definitions\": []}"
@@ -82,7 +82,7 @@
   str-reset
   s" ctags -R " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : lookup-tag ( symbol-addr symbol-u -- )
   \ Look up symbol in tags file
@@ -90,7 +90,7 @@
   s" grep '^" str+
   str+
   s" ' tags | head -5" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Semantic Search (placeholder) ---
 
@@ -101,19 +101,19 @@ variable safe-commands-len
   str+
   s"  &" str+
   s"  echo $!" str+
-  str$ system drop
+  str$ system
   0 ;  \ TODO: Capture actual PID
 
 : shell-kill ( pid -- )
   str-reset
   s" kill " str+
   0 <# #s #> str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Working Directory ---
 
 : shell-pwd ( -- )
-  s" pwd" system drop ;
+  s" pwd" system ;
 
 : shell-cd ( path-addr path-u -- )
   \ Note: This won't persist in Forth's system calls
@@ -24,7 +24,7 @@ variable response-len
   s"   fetched_at TEXT DEFAULT CURRENT_TIMESTAMP," str+
   s"   ttl_seconds INTEGER" str+
   s" );\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- HTTP Primitives ---
 
@@ -34,7 +34,7 @@ variable response-len
   s" curl -s '" str+
   str+
   s" '" str+
-  str$ system drop
+  str$ system
   \ TODO: Capture output properly
   s" {}" response-buf swap move
   2 response-len ! ;
@@ -47,7 +47,7 @@ variable response-len
   s" ' '" str+
   str+  \ url
   s" '" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Cache Operations ---
 
@@ -78,7 +78,7 @@ variable response-len
   s" sqlite3 " str+
   db-file str+
   s"  \"DELETE FROM cache;\"" str+
-  str$ system drop
+  str$ system
   s" Cache cleared" type cr ;
 
 : show-cache ( -- )
@@ -88,7 +88,7 @@ variable response-len
   s" sqlite3 -column -header " str+
   db-file str+
   s"  \"SELECT url, ttl_seconds, fetched_at FROM cache;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- API: JSONPlaceholder (Demo API) ---
 
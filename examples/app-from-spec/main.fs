@@ -71,7 +71,7 @@ variable gen-fid
   str-reset
   s" mkdir -p " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : file-exists? ( path-addr path-u -- flag )
   \ Check if file exists using test command
@@ -146,7 +146,7 @@ variable stack-frontend-len
   s" ' " str+
   str+
   s"  2>/dev/null" str+
-  str$ system drop
+  str$ system
   \ For demo, return placeholder - real impl would capture output
   s" " ;
 
@@ -289,7 +289,7 @@ variable stack-frontend-len
   str-reset
   s" jq -r '.content[0].text // empty' " str+
   response-file str+
-  str$ system drop
+  str$ system
   \ Return placeholder for demo
   s" [LLM response content]" ;
 
@@ -23,7 +23,7 @@ require ~/.fifth/lib/core.fs
   s" );" str+
   s" CREATE VIRTUAL TABLE IF NOT EXISTS bookmarks_fts USING fts5(title, description, tags, content=bookmarks, content_rowid=id);" str+
   s" \"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Bookmark Operations ---
 
@@ -39,7 +39,7 @@ require ~/.fifth/lib/core.fs
   s" ', '" str+
   2r> str+ \ tags
   s" ');\"" str+
-  str$ system drop
+  str$ system
   s" Bookmark added" type cr ;
 
 : list-bookmarks ( -- )
@@ -49,7 +49,7 @@ require ~/.fifth/lib/core.fs
   s" sqlite3 -column -header " str+
   db-file str+
   s"  \"SELECT id, title, url, tags FROM bookmarks ORDER BY created_at DESC LIMIT 20;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : search-bookmarks ( query-addr query-u -- )
   s" Search results for: " type 2dup type cr
@@ -60,7 +60,7 @@ require ~/.fifth/lib/core.fs
   s"  \"SELECT b.id, b.title, b.url FROM bookmarks b JOIN bookmarks_fts f ON b.id = f.rowid WHERE bookmarks_fts MATCH '" str+
   str+
   s" ' ORDER BY rank LIMIT 20;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : list-by-tag ( tag-addr tag-u -- )
   s" Bookmarks tagged: " type 2dup type cr
@@ -71,7 +71,7 @@ require ~/.fifth/lib/core.fs
   s"  \"SELECT id, title, url FROM bookmarks WHERE tags LIKE '%" str+
   str+
   s" %' ORDER BY created_at DESC;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : delete-bookmark ( id -- )
   str-reset
@@ -80,7 +80,7 @@ require ~/.fifth/lib/core.fs
   s"  \"DELETE FROM bookmarks WHERE id=" str+
   0 <# #s #> str+
   s" ;\"" str+
-  str$ system drop
+  str$ system
   s" Bookmark deleted" type cr ;
 
 \ --- HTML Export ---
@@ -150,7 +150,7 @@ require ~/.fifth/lib/core.fs
 \ --- Main ---
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : usage ( -- )
   s" Bookmark Manager" type cr
@@ -143,7 +143,7 @@ variable gen-fid
 \ --- Main ---
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : generate-all ( name-addr name-u -- )
   s" Generating code for: " type 2dup type cr
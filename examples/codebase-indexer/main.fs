@@ -66,14 +66,14 @@ s" /tmp/fifth-index-query.txt" 2constant query-result
   s"   content_hash TEXT," str+
   s"   indexed_at TEXT DEFAULT CURRENT_TIMESTAMP" str+
   s" );\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : clear-db ( -- )
   \ Remove all indexed data
   str-reset
   s" sqlite3 " str+ db-path str+
   s"  \"DELETE FROM embeddings; DELETE FROM file_hashes;\"" str+
-  str$ system drop
+  str$ system
   s" Index cleared." type cr ;
 
 \ ============================================================================
@@ -110,13 +110,13 @@ variable skip-count
   until
   2drop
   s"  \\) 2>/dev/null > " str+ files-list str+
-  str$ system drop ;
+  str$ system ;
 
 : count-files ( -- n )
   \ Count lines in files-list
   str-reset
   s" wc -l < " str+ files-list str+ s"  | tr -d ' '" str+
-  str$ system drop
+  str$ system
   \ Read result - simplified, would need proper capture
   0 ;
 
@@ -132,7 +132,7 @@ variable skip-count
   s"  2>/dev/null || md5sum " str+
   \ Repeat path for fallback
   s"  | cut -d' ' -f1" str+
-  str$ system drop
+  str$ system
   s" [hash]" ;  \ Placeholder - need proper output capture
 
 : get-stored-hash ( path$ -- hash$ )
@@ -142,7 +142,7 @@ variable skip-count
   s"  \"SELECT content_hash FROM file_hashes WHERE file_path='" str+
   2swap str+
   s" '\" 2>/dev/null" str+
-  str$ system drop
+  str$ system
   s" " ;  \ Placeholder
 
 : store-hash ( path$ hash$ -- )
@@ -154,7 +154,7 @@ variable skip-count
   s" ', '" str+
   2swap str+
   s" ');\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : needs-reindex? ( path$ -- flag )
   \ Check if file has changed since last index
@@ -271,14 +271,14 @@ variable chunk-end-line
   embedding-model str+
   s" \"}' > " str+
   vector-file str+
-  str$ system drop ;
+  str$ system ;
 
 : extract-openai-vector ( -- vector$ )
   \ Extract embedding vector from OpenAI response using jq
   str-reset
   s" jq -c '.data[0].embedding' " str+ vector-file str+
   s"  2>/dev/null" str+
-  str$ system drop
+  str$ system
   \ Read from command output - simplified
   s" []" ;  \ Placeholder
 
@@ -298,12 +298,12 @@ variable chunk-end-line
   str+
   s" \"}' > " str+
   vector-file str+
-  str$ system drop ;
+  str$ system ;
 
 : extract-ollama-vector ( -- vector$ )
   str-reset
   s" jq -c '.embedding' " str+ vector-file str+
-  str$ system drop
+  str$ system
   s" []" ;
 
 \ ============================================================================
@@ -405,7 +405,7 @@ variable emb-end
   \ chunk_hash (MD5 of chunk text) - simplified
   s" hash-placeholder" str+
   s" ');\"" str+
-  str$ system drop
+  str$ system
   1 chunk-count +! ;
 
 \ ============================================================================
@@ -567,7 +567,7 @@ variable files-fid
   s" mag_b=math.sqrt(sum(x*x for x in b)); " str+
   s" sim=dot/(mag_a*mag_b) if mag_a*mag_b>0 else 0; " str+
   s" print(int(sim*100))\" 2>/dev/null" str+
-  str$ system drop
+  str$ system
   \ Would capture output - returning placeholder
   85 ;  \ Placeholder similarity
 
@@ -589,7 +589,7 @@ variable max-results
   s"  \"SELECT id, file_path, chunk_text, chunk_type, start_line, end_line, vector " str+
   s" FROM embeddings ORDER BY id LIMIT 1000\" > " str+
   query-result str+
-  str$ system drop
+  str$ system
 
   \ Note: In a real implementation, we would:
   \ 1. Load each vector
@@ -648,18 +648,18 @@ variable max-results
   str-reset
   s" sqlite3 " str+ db-path str+
   s"  \"SELECT COUNT(*) FROM embeddings\"" str+
-  str$ system drop
+  str$ system
   \ Would display count
 
   str-reset
   s" sqlite3 " str+ db-path str+
   s"  \"SELECT COUNT(DISTINCT file_path) FROM embeddings\"" str+
-  str$ system drop
+  str$ system
 
   str-reset
   s" sqlite3 " str+ db-path str+
   s"  \"SELECT chunk_type, COUNT(*) FROM embeddings GROUP BY chunk_type\"" str+
-  str$ system drop
+  str$ system
 
   s" " type cr
   s" Database: " type db-path type cr
@@ -121,7 +121,7 @@ variable config-fid
 \ --- Main ---
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : usage ( -- )
   s" Configuration Generator" type cr
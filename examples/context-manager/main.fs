@@ -81,7 +81,7 @@ variable current-task-len
   s" compression_ratio REAL," str+
   s" timestamp TEXT DEFAULT CURRENT_TIMESTAMP);" str+
   s" \"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ ============================================================
 \ Token Counting
@@ -105,7 +105,7 @@ variable current-task-len
   s"   print(len(enc.encode(sys.stdin.read())));" str+
   s" except: print(-1)\" > " str+
   token-output str+
-  str$ system drop
+  str$ system
   \ Read result
   token-output r/o open-file throw ctx-fid !
   line-buf line-max ctx-fid @ read-line throw drop
@@ -160,7 +160,7 @@ variable current-task-len
   s" , " str+
   2r> drop n>str str+       \ level
   s" );\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : ctx-add-user ( content-addr content-u -- )
   \ Add user message at working level
@@ -191,7 +191,7 @@ variable current-task-len
   n>str str+
   s" ;\" > " str+
   ctx-output str+
-  str$ system drop
+  str$ system
   ctx-output r/o open-file throw ctx-fid !
   line-buf line-max ctx-fid @ read-line throw drop
   ctx-fid @ close-file drop
@@ -206,7 +206,7 @@ variable current-task-len
   n>str str+
   s" ;\" > " str+
   ctx-output str+
-  str$ system drop
+  str$ system
   ctx-output r/o open-file throw ctx-fid !
   line-buf line-max ctx-fid @ read-line throw drop
   ctx-fid @ close-file drop
@@ -239,7 +239,7 @@ variable current-task-len
   n>str str+
   s" ;\" > " str+
   ctx-output str+
-  str$ system drop
+  str$ system
   ctx-output r/o open-file throw ctx-fid !
   line-buf line-max ctx-fid @ read-line throw drop
   ctx-fid @ close-file drop
@@ -260,7 +260,7 @@ variable current-task-len
   s"  WHERE id=" str+
   n>str str+
   s" ;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ ============================================================
 \ Summarization
@@ -280,7 +280,7 @@ variable current-task-len
   n>str str+
   s"  ORDER BY created_at ASC LIMIT 10;\" > " str+
   ctx-output str+
-  str$ system drop
+  str$ system
   \ Return file path for processing
   ctx-output ;
 
@@ -303,7 +303,7 @@ variable current-task-len
   s" \"}]" str+
   s" }' | jq -r '.content[0].text' > " str+
   summary-output str+
-  str$ system drop
+  str$ system
   \ Read summary result
   summary-output r/o open-file throw ctx-fid !
   str-reset
@@ -331,7 +331,7 @@ variable current-task-len
   s" , '" str+
   2r> str+  \ source_ids
   s" ');\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : ctx-delete-messages ( ids-addr ids-u -- )
   \ Delete messages by comma-separated IDs
@@ -341,7 +341,7 @@ variable current-task-len
   s"  \"DELETE FROM messages WHERE id IN (" str+
   str+
   s" );\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : ctx-compress-level ( level -- )
   \ Compress old messages at given level
@@ -410,7 +410,7 @@ variable current-task-len
   n>str str+
   s" ;\" > " str+
   ctx-output str+
-  str$ system drop ;
+  str$ system ;
 
 : ctx-get-summaries ( level -- )
   \ Get summaries at level
@@ -421,7 +421,7 @@ variable current-task-len
   n>str str+
   s"  ORDER BY created_at DESC;\" > " str+
   ctx-output str+
-  str$ system drop ;
+  str$ system ;
 
 : ctx-search-keyword ( keyword-addr keyword-u -- )
   \ Search for messages containing keyword
@@ -432,7 +432,7 @@ variable current-task-len
   str+
   s" %' ORDER BY created_at DESC LIMIT 5;\" > " str+
   ctx-output str+
-  str$ system drop ;
+  str$ system ;
 
 \ ============================================================
 \ Context Building
@@ -527,7 +527,7 @@ variable context-len
   ctx-db str+
   s"  \"SELECT COUNT(*) FROM messages;\" > " str+
   ctx-output str+
-  str$ system drop
+  str$ system
   ctx-output r/o open-file throw ctx-fid !
   line-buf line-max ctx-fid @ read-line throw drop
   ctx-fid @ close-file drop
@@ -539,7 +539,7 @@ variable context-len
   ctx-db str+
   s"  \"SELECT COUNT(*) FROM summaries;\" > " str+
   ctx-output str+
-  str$ system drop
+  str$ system
   ctx-output r/o open-file throw ctx-fid !
   line-buf line-max ctx-fid @ read-line throw drop
   ctx-fid @ close-file drop
@@ -551,7 +551,7 @@ variable context-len
   ctx-db str+
   s"  \"SELECT COALESCE(AVG(compression_ratio), 0) FROM metrics;\" > " str+
   ctx-output str+
-  str$ system drop
+  str$ system
   ctx-output r/o open-file throw ctx-fid !
   line-buf line-max ctx-fid @ read-line throw drop
   ctx-fid @ close-file drop
@@ -677,7 +677,7 @@ variable context-len
     s" sqlite3 " str+
     ctx-db str+
     s"  \"DELETE FROM messages; DELETE FROM summaries; DELETE FROM keywords;\"" str+
-    str$ system drop
+    str$ system
     0 total-tokens !
     0 compression-count !
     s" Context cleared." type cr
@@ -784,7 +784,7 @@ variable context-len
     s" sqlite3 " str+
     ctx-db str+
     s"  \"DELETE FROM messages; DELETE FROM summaries;\"" str+
-    str$ system drop
+    str$ system
     s" Cleared." type cr
     exit
   then
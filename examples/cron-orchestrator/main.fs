@@ -31,7 +31,7 @@ variable job-success
   s"   output TEXT," str+
   s"   run_at TEXT DEFAULT CURRENT_TIMESTAMP" str+
   s" );\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : record-run ( job-addr job-u status-addr status-u -- )
   str-reset
@@ -48,26 +48,26 @@ variable job-success
   s" ', run_count=run_count+1 WHERE name='" str+
   \ TODO: Add job name again
   s" ';\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Job Definitions ---
 
 : job-backup ( -- success )
   s" [backup] Creating database backup..." type cr
-  s" cp jobs.db jobs.db.bak 2>/dev/null || true" system drop
+  s" cp jobs.db jobs.db.bak 2>/dev/null || true" system
   s" [backup] Done" type cr
   true ;
 
 : job-cleanup ( -- success )
   s" [cleanup] Removing old temp files..." type cr
-  s" find /tmp -name '*.tmp' -mtime +1 -delete 2>/dev/null || true" system drop
+  s" find /tmp -name '*.tmp' -mtime +1 -delete 2>/dev/null || true" system
   s" [cleanup] Done" type cr
   true ;
 
 : job-report ( -- success )
   s" [report] Generating status report..." type cr
   \ Generate HTML report
-  s" mkdir -p output" system drop
+  s" mkdir -p output" system
   s" output/status.html" w/o create-file throw html>file
   s" Job Status" html-head html-body
   <h1> s" Cron Job Status" text </h1>
@@ -132,7 +132,7 @@ variable job-success
   s" sqlite3 -column -header " str+
   db-file str+
   s"  \"SELECT name, last_status, last_run, run_count FROM jobs;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : show-history ( -- )
   s" Recent Job History:" type cr
@@ -141,7 +141,7 @@ variable job-success
   s" sqlite3 -column -header " str+
   db-file str+
   s"  \"SELECT job_name, status, run_at FROM job_history ORDER BY id DESC LIMIT 20;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : list-jobs ( -- )
   s" Available Jobs:" type cr
@@ -42,7 +42,7 @@ require ~/.fifth/lib/core.fs
   str-reset
   s" curl -s " str+
   str+
-  str$ system drop
+  str$ system
   s" {}" ;  \ placeholder
 
 : query-metric ( sql-addr sql-u -- value-addr value-u )
@@ -16,7 +16,7 @@ require ~/.fifth/lib/core.fs
   s" sqlite3 " str+
   db-path str+
   s"  \"CREATE TABLE IF NOT EXISTS _migrations (id INTEGER PRIMARY KEY, name TEXT, applied_at TEXT);\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : record-migration ( name-addr name-u -- )
   \ Record that a migration was applied
@@ -26,7 +26,7 @@ require ~/.fifth/lib/core.fs
   s"  \"INSERT INTO _migrations (name, applied_at) VALUES ('" str+
   str+  \ migration name
   s" ', datetime('now'));\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : migration-applied? ( name-addr name-u -- flag )
   \ Check if migration was already applied
@@ -42,7 +42,7 @@ require ~/.fifth/lib/core.fs
   db-path str+
   s"  < " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : run-migration ( name-addr name-u -- )
   \ Run a single migration
@@ -68,7 +68,7 @@ require ~/.fifth/lib/core.fs
   s" sqlite3 " str+
   db-path str+
   s"  \"SELECT name, applied_at FROM _migrations ORDER BY id;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : list-pending ( -- )
   \ Show pending migrations
@@ -50,7 +50,7 @@ s" /tmp/claude-db-viewer.html" 2constant output-file
 : stat-card ( n label$ -- )
   2>r
   s" stat" <div.>
-    s" <b>" raw swap n>str raw s" </b>" raw
+    s" <b>" raw n>str raw s" </b>" raw
     s" <span>" raw 2r> text s" </span>" raw
   </div>nl ;
 
@@ -49,7 +49,7 @@ variable current-step
 
 : build-app ( -- flag )
   2 s" Building application" step
-  s" npm run build 2>&1" system drop
+  s" npm run build 2>&1" system
   \ TODO: Check exit code
   s" Build complete" success
   true ;
@@ -64,7 +64,7 @@ variable current-step
   deploy-user str+ s" @" str+
   str+  \ host
   s"  'cp -r " str+ app-dir str+ s"  " str+ app-dir str+ s" .bak'" str+
-  str$ system drop
+  str$ system
   s" Backup created" success
   true ;
 
@@ -78,7 +78,7 @@ variable current-step
   deploy-user str+ s" @" str+
   str+  \ host
   s" :" str+ app-dir str+ s" /" str+
-  str$ system drop
+  str$ system
   s" Files deployed" success
   true ;
 
@@ -109,7 +109,7 @@ variable current-step
   deploy-user str+ s" @" str+
   str+  \ host
   s"  'rm -rf " str+ app-dir str+ s"  && mv " str+ app-dir str+ s" .bak " str+ app-dir str+ s" '" str+
-  str$ system drop
+  str$ system
   s" Rollback complete" type cr ;
 
 \ --- Main Deploy Flow ---
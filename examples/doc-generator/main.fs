@@ -125,7 +125,7 @@ variable scan-fid
 \ --- Main ---
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : usage ( -- )
   s" Documentation Generator" type cr
@@ -38,7 +38,7 @@ require ~/.fifth/lib/core.fs
   s" sqlite3 " str+
   problems-db str+
   s"  'CREATE TABLE IF NOT EXISTS problems (id TEXT PRIMARY KEY, name TEXT NOT NULL, description TEXT NOT NULL, signature TEXT, test_code TEXT NOT NULL, difficulty TEXT, category TEXT)'" str+
-  str$ system drop ;
+  str$ system ;
 
 : init-results-db ( -- )
   \ Create runs and results tables in one command
@@ -46,7 +46,7 @@ require ~/.fifth/lib/core.fs
   s" sqlite3 " str+
   results-db str+
   s"  'CREATE TABLE IF NOT EXISTS runs (id INTEGER PRIMARY KEY AUTOINCREMENT, timestamp TEXT, model TEXT, prompt_variant TEXT); CREATE TABLE IF NOT EXISTS results (id INTEGER PRIMARY KEY AUTOINCREMENT, run_id INTEGER, problem_id TEXT, sample_num INTEGER, passed INTEGER)'" str+
-  str$ system drop ;
+  str$ system ;
 
 : init-dbs ( -- )
   \ Note: Fifth's system word may have issues with multiple calls
@@ -57,7 +57,7 @@ require ~/.fifth/lib/core.fs
   s"  'CREATE TABLE IF NOT EXISTS problems (id TEXT PRIMARY KEY, name TEXT, description TEXT, signature TEXT, test_code TEXT, difficulty TEXT, category TEXT)' && sqlite3 " str+
   results-db str+
   s"  'CREATE TABLE IF NOT EXISTS runs (id INTEGER PRIMARY KEY AUTOINCREMENT, timestamp TEXT, model TEXT, prompt_variant TEXT); CREATE TABLE IF NOT EXISTS results (id INTEGER PRIMARY KEY AUTOINCREMENT, run_id INTEGER, problem_id TEXT, sample_num INTEGER, passed INTEGER)'" str+
-  str$ system drop ;
+  str$ system ;
 
 \ ============================================================
 \ Sandbox Setup
@@ -68,7 +68,7 @@ require ~/.fifth/lib/core.fs
   str-reset
   s" mkdir -p " str+
   sandbox-dir str+
-  str$ system drop ;
+  str$ system ;
 
 : clear-sandbox ( -- )
   \ Clean sandbox between runs
@@ -80,7 +80,7 @@ require ~/.fifth/lib/core.fs
   s" /*.out " str+
   sandbox-dir str+
   s" /*.err" str+
-  str$ system drop ;
+  str$ system ;
 
 \ ============================================================
 \ Problem Management
@@ -256,7 +256,7 @@ variable current-tokens-out
   sandbox-dir str+
   s" /response.json 2>&1" str+
 
-  str$ system drop
+  str$ system
 
   \ Read response from file using slurp-file
   str-reset
@@ -285,7 +285,7 @@ variable current-tokens-out
   sandbox-dir str+
   s" /response.json 2>&1" str+
 
-  str$ system drop
+  str$ system
 
   \ Read response using slurp-file
   str-reset
@@ -315,7 +315,7 @@ variable current-tokens-out
   s" /response.json > " str+
   sandbox-dir str+
   s" /code.txt 2>/dev/null" str+
-  str$ system drop
+  str$ system
 
   \ Read extracted code using slurp-file
   str-reset
@@ -338,7 +338,7 @@ variable current-tokens-out
   s" /response.json > " str+
   sandbox-dir str+
   s" /code.txt 2>/dev/null" str+
-  str$ system drop
+  str$ system
 
   \ Read extracted code using slurp-file
   str-reset
@@ -363,7 +363,7 @@ variable exec-end-ms
   \ Get current time in milliseconds (via date)
   str-reset
   s" date +%s%3N" str+
-  str$ system drop
+  str$ system
   \ Would need to capture output properly
   0 ;  \ placeholder
 
@@ -451,7 +451,7 @@ variable current-run-id
   s" ', " str+
   0 <# #s #> str+  \ samples
   s\" ); SELECT last_insert_rowid();\"" str+
-  str$ system drop
+  str$ system
   \ Would need to capture the ID
   1 ;
 
@@ -495,7 +495,7 @@ variable current-run-id
   r> 0 <# #s #> str+
 
   s\" );\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ ============================================================
 \ Pass@k Calculation
@@ -641,7 +641,7 @@ variable total-samples
   s\" FROM results WHERE run_id=" str+
   0 <# #s #> str+
   s\" GROUP BY problem_id ORDER BY problem_id;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : report-latest ( -- )
   \ Report on most recent run
@@ -649,7 +649,7 @@ variable total-samples
   s\" sqlite3 " str+
   results-db str+
   s\" \" SELECT MAX(id) FROM runs;\"" str+
-  str$ system drop
+  str$ system
   \ Would capture and pass to report-run
   1 report-run ;
 
@@ -672,7 +672,7 @@ variable total-samples
   s\" AND r2.run_id=" str+
   0 <# #s #> str+
   s\" GROUP BY r1.problem_id;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : report-all-runs ( -- )
   \ List all runs with summary stats
@@ -689,7 +689,7 @@ variable total-samples
   s\" FROM runs r " str+
   s\" LEFT JOIN results res ON r.id = res.run_id " str+
   s\" GROUP BY r.id ORDER BY r.id DESC;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ ============================================================
 \ A/B Testing
@@ -725,7 +725,7 @@ variable total-samples
   s" 'variable test-result true test-result ! : check 5 my-dup 5 = swap 5 = and test-result @ and test-result ! ; check', " str+
   s" 'easy', " str+
   s\" 'stack');\"" str+
-  str$ system drop
+  str$ system
 
   \ Problem: double
   str-reset
@@ -739,7 +739,7 @@ variable total-samples
   s" 'variable test-result true test-result ! : check 5 my-double 10 = test-result @ and test-result ! 0 my-double 0= test-result @ and test-result ! ; check', " str+
   s" 'easy', " str+
   s\" 'math');\"" str+
-  str$ system drop
+  str$ system
 
   \ Problem: max
   str-reset
@@ -753,7 +753,7 @@ variable total-samples
   s" 'variable test-result true test-result ! : check 3 5 my-max 5 = test-result @ and test-result ! 7 2 my-max 7 = test-result @ and test-result ! ; check', " str+
   s" 'easy', " str+
   s\" 'math');\"" str+
-  str$ system drop
+  str$ system
 
   \ Problem: factorial
   str-reset
@@ -767,7 +767,7 @@ variable total-samples
   s" 'variable test-result true test-result ! : check 0 my-factorial 1 = test-result @ and test-result ! 5 my-factorial 120 = test-result @ and test-result ! ; check', " str+
   s" 'medium', " str+
   s\" 'math');\"" str+
-  str$ system drop
+  str$ system
 
   \ Problem: abs
   str-reset
@@ -781,7 +781,7 @@ variable total-samples
   s" 'variable test-result true test-result ! : check 5 my-abs 5 = test-result @ and test-result ! -3 my-abs 3 = test-result @ and test-result ! 0 my-abs 0= test-result @ and test-result ! ; check', " str+
   s" 'easy', " str+
   s\" 'math');\"" str+
-  str$ system drop
+  str$ system
 
   s" Sample problems added." type cr ;
 
@@ -91,7 +91,7 @@ require ~/.fifth/lib/core.fs
   2swap str+
   s"  " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Main ---
 
@@ -123,7 +123,7 @@ require ~/.fifth/lib/core.fs
   ;
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : main ( -- )
   ensure-output
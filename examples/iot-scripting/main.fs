@@ -20,7 +20,7 @@ variable alert-state
   s" sqlite3 " str+
   db-file str+
   s"  \"CREATE TABLE IF NOT EXISTS readings (id INTEGER PRIMARY KEY, sensor TEXT, value REAL, timestamp TEXT DEFAULT CURRENT_TIMESTAMP);\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : log-reading ( sensor-addr sensor-u value -- )
   str-reset
@@ -31,7 +31,7 @@ variable alert-state
   s" ', " str+
   0 <# #s #> str+
   s" );\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Sensor Reading ---
 
@@ -52,7 +52,7 @@ variable alert-state
   s" cat /sys/class/gpio/gpio" str+
   0 <# #s #> str+
   s" /value 2>/dev/null || echo 0" str+
-  str$ system drop
+  str$ system
   0 ;  \ placeholder
 
 : read-all-sensors ( -- )
@@ -69,7 +69,7 @@ variable alert-state
   s"  > /sys/class/gpio/gpio" str+
   swap 0 <# #s #> str+
   s" /value 2>/dev/null" str+
-  str$ system drop ;
+  str$ system ;
 
 : fan-on ( -- )
   s" Fan ON" type cr
@@ -157,7 +157,7 @@ variable alert-state
   s" sqlite3 -column -header " str+
   db-file str+
   s"  \"SELECT sensor, value, timestamp FROM readings ORDER BY id DESC LIMIT 10;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Main ---
 
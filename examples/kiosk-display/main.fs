@@ -137,7 +137,7 @@ require ~/.fifth/lib/core.fs
   s" chromium --kiosk --noerrdialogs --disable-infobars file://" str+
   s" output/display.html" str+
   s"  &" str+
-  str$ system drop
+  str$ system
   s" Launched Chromium in kiosk mode" type cr ;
 
 : launch-firefox ( -- )
@@ -145,13 +145,13 @@ require ~/.fifth/lib/core.fs
   s" firefox --kiosk file://" str+
   s" output/display.html" str+
   s"  &" str+
-  str$ system drop
+  str$ system
   s" Launched Firefox in kiosk mode" type cr ;
 
 \ --- Main ---
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : usage ( -- )
   s" Kiosk Display System" type cr
@@ -27,7 +27,7 @@ variable project-template-len
   str-reset
   s" mkdir -p " str+
   str+
-  str$ system drop ;
+  str$ system ;
 
 : create-file-from ( content-addr content-u path-addr path-u -- )
   w/o create-file throw >r
@@ -114,7 +114,7 @@ variable project-template-len
 \ --- Main ---
 
 : ensure-dirs ( -- )
-  s" mkdir -p templates output" system drop ;
+  s" mkdir -p templates output" system ;
 
 : list-templates ( -- )
   s" Available templates:" type cr
@@ -124,7 +124,7 @@ variable total-count
   s" sqlite3 " str+
   db-file str+
   s"  \"CREATE TABLE IF NOT EXISTS results (id INTEGER PRIMARY KEY, quiz TEXT, score INTEGER, date TEXT);\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : save-result ( quiz-addr quiz-u score -- )
   str-reset
@@ -135,7 +135,7 @@ variable total-count
   s" ', " str+
   0 <# #s #> str+
   s" , datetime('now'));\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Reports ---
 
@@ -146,12 +146,12 @@ variable total-count
   s" sqlite3 " str+
   db-file str+
   s"  \"SELECT quiz, score, date FROM results ORDER BY date DESC LIMIT 10;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Main ---
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : usage ( -- )
   s" Quiz System" type cr
@@ -17,7 +17,7 @@ require ~/.fifth/lib/core.fs
   s" CREATE TABLE IF NOT EXISTS ingredients (id INTEGER PRIMARY KEY, recipe_id INTEGER, name TEXT, amount REAL, unit TEXT);" str+
   s" CREATE TABLE IF NOT EXISTS inventory (id INTEGER PRIMARY KEY, name TEXT, quantity REAL, unit TEXT);" str+
   s" \"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Recipe Operations ---
 
@@ -30,7 +30,7 @@ require ~/.fifth/lib/core.fs
   s" ', " str+
   0 <# #s #> str+
   s" );\"" str+
-  str$ system drop
+  str$ system
   s" Recipe added" type cr ;
 
 : list-recipes ( -- )
@@ -40,7 +40,7 @@ require ~/.fifth/lib/core.fs
   s" sqlite3 -column -header " str+
   db-file str+
   s"  \"SELECT id, name, servings FROM recipes;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : view-recipe ( name-addr name-u -- )
   s" Recipe: " type 2dup type cr
@@ -51,7 +51,7 @@ require ~/.fifth/lib/core.fs
   s"  \"SELECT * FROM recipes WHERE name='" str+
   str+
   s" ';\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- Ingredient Scaling ---
 
@@ -128,7 +128,7 @@ require ~/.fifth/lib/core.fs
 \ --- Main ---
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : usage ( -- )
   s" Recipe Manager" type cr
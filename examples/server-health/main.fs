@@ -23,22 +23,22 @@ create uptime-str metric-len allot
 
 : collect-disk ( -- )
   \ Get disk usage percentage for root
-  s" df -h / | tail -1 | awk '{print $5}'" system drop
+  s" df -h / | tail -1 | awk '{print $5}'" system
   s" 45%" disk-usage swap move ;
 
 : collect-memory ( -- )
   \ Get memory usage
-  s" free -m | awk 'NR==2{printf \"%d/%dMB (%.1f%%)\", $3,$2,$3*100/$2}'" system drop
+  s" free -m | awk 'NR==2{printf \"%d/%dMB (%.1f%%)\", $3,$2,$3*100/$2}'" system
   s" 4096/8192MB (50%)" mem-usage swap move ;
 
 : collect-load ( -- )
   \ Get load average
-  s" uptime | awk -F'load average:' '{print $2}'" system drop
+  s" uptime | awk -F'load average:' '{print $2}'" system
   s" 0.52, 0.58, 0.59" load-avg swap move ;
 
 : collect-uptime ( -- )
   \ Get system uptime
-  s" uptime | awk -F'up ' '{print $2}' | awk -F',' '{print $1}'" system drop
+  s" uptime | awk -F'up ' '{print $2}' | awk -F',' '{print $1}'" system
   s" 15 days" uptime-str swap move ;
 
 : collect-all ( -- )
@@ -103,7 +103,7 @@ create uptime-str metric-len allot
 \ --- Main ---
 
 : ensure-output ( -- )
-  s" mkdir -p output" system drop ;
+  s" mkdir -p output" system ;
 
 : main ( -- )
   ensure-output
@@ -40,7 +40,7 @@ require ~/.fifth/lib/core.fs
   2swap str+  \ source file
   s"  > " str+
   str+        \ dest file
-  str$ system drop ;
+  str$ system ;
 
 : process-post ( filename-addr filename-u -- )
   \ Convert single post: posts/foo.md -> dist/foo.html
@@ -87,7 +87,7 @@ require ~/.fifth/lib/core.fs
 \ --- Main ---
 
 : ensure-dist ( -- )
-  s" mkdir -p dist" system drop ;
+  s" mkdir -p dist" system ;
 
 : build-site ( -- )
   s" Building static site..." type cr
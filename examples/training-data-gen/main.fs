@@ -439,7 +439,7 @@ variable brace-depth
   str-reset
   str+
   s"  > /tmp/fifth_shell_out.txt 2>&1" str+
-  str$ system drop
+  str$ system
   s" /tmp/fifth_shell_out.txt" r/o open-file throw
   dup line-buf line-max rot read-line throw drop
   swap close-file throw
@@ -453,7 +453,7 @@ variable brace-depth
   s"  && git log --format='%H|%s' -" str+
   n>str str+
   s"  --no-merges 2>/dev/null" str+
-  str$ system drop ;
+  str$ system ;
 
 : git-show-diff ( hash$ -- diff$ )
   \ Get diff for a commit
@@ -603,7 +603,7 @@ variable brace-depth
   s" /tmp/fifth_files.txt" r/o open-file throw >r
   line-buf line-max r@ read-line throw drop  \ read the find command
   r> close-file throw
-  str$ system drop
+  str$ system
 
   \ Now read the actual find output from execution
   str-reset
@@ -613,7 +613,7 @@ variable brace-depth
   s" -not -path '*/node_modules/*' -not -path '*/.git/*' " str+
   s" -not -path '*/venv/*' -not -path '*/__pycache__/*' " str+
   s" > /tmp/fifth_found.txt 2>/dev/null" str+
-  str$ system drop
+  str$ system
 
   s" /tmp/fifth_found.txt" r/o open-file if drop exit then
   scan-fid !
@@ -25,7 +25,7 @@ variable payload-len
   s"   status TEXT DEFAULT 'pending'," str+
   s"   created_at TEXT DEFAULT CURRENT_TIMESTAMP" str+
   s" );\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : store-event ( type-addr type-u payload-addr payload-u -- id )
   str-reset
@@ -37,7 +37,7 @@ variable payload-len
   \ TODO: Escape payload for SQL
   str+        \ payload (simplified - needs escaping)
   s" '); SELECT last_insert_rowid();\"" str+
-  str$ system drop
+  str$ system
   0 ;  \ placeholder ID
 
 : update-status ( id status-addr status-u -- )
@@ -49,7 +49,7 @@ variable payload-len
   s" ' WHERE id=" str+
   swap 0 <# #s #> str+
   s" ;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 \ --- JSON Processing (via jq) ---
 
@@ -132,7 +132,7 @@ variable payload-len
   s" sqlite3 -column -header " str+
   db-file str+
   s"  \"SELECT id, event_type, status, created_at FROM events ORDER BY id DESC LIMIT 20;\"" str+
-  str$ system drop ;
+  str$ system ;
 
 : replay-failed ( -- )
   s" Replaying failed events..." type cr
@@ -140,7 +140,7 @@ variable payload-len
   s" sqlite3 " str+
   db-file str+
   s"  \"SELECT id, payload FROM events WHERE status='failed' ORDER BY id;\"" str+
-  str$ system drop
+  str$ system
   \ TODO: Parse output and reprocess each
   s" Replay complete" type cr ;
 
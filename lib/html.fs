@@ -14,7 +14,11 @@ variable html-fid  \ File descriptor for HTML output
 
 : h>> ( addr u -- )
   \ Write to HTML output
-  html-fid @ write-file throw ;
+  html-fid @ write-file throw ; coalescing
+
+\ coalescing lets the compiler join h>> calls on adjacent literals:
+\ s" <p" h>> >t compiles as s" <p>" h>>. Tag words that are just
+\ s" ..." h>> join with their neighbours the same way.
 
 : h>>nl ( -- )
   \ Write newline
@@ -28,28 +32,21 @@ variable html-fid  \ File descriptor for HTML output
 \ HTML Escaping
 \ ============================================================
 
-: html-escape ( addr u -- addr' u' )
-  \ Escape HTML special characters: < > & ' "
-  str2-reset
-  0 ?do
-    dup i + c@
-    case
-      [char] < of s" &lt;"   str2+ endof
-      [char] > of s" &gt;"   str2+ endof
-      [char] & of s" &amp;"  str2+ endof
-      [char] ' of s" &#39;"  str2+ endof
-      [char] " of s" &quot;" str2+ endof
-      dup str2-char
-    endcase
-  loop
-  drop str2$ ;
+\ html-escape ( addr u -- addr' u' ) is an engine primitive: it escapes
+\ < > & ' " in bulk, with no length limit. The result is temporary,
+\ like slurp-file's. html-escape-file writes the escaped text out
+\ directly, without the intermediate copy.
+
+: h>>esc ( addr u -- )
+  \ Write escaped text to HTML output
+  html-fid @ html-escape-file throw ;
 
 \ ============================================================
 \ Core Output Words
 \ ============================================================
 
-: raw ( addr u -- ) h>> ;           \ Output raw HTML
-: text ( addr u -- ) html-escape h>> ;  \ Output escaped text
+: raw ( addr u -- ) h>> ; coalescing  \ Output raw HTML
+: text ( addr u -- ) h>>esc ;       \ Output escaped text
 : nl ( -- ) h>>nl ;                 \ Newline
 : rawln ( addr u -- ) h>>line ;     \ Raw with newline
 
@@ -93,163 +90,163 @@ variable html-fid  \ File descriptor for HTML output
 \ ============================================================
 
 \ Document structure
-: <!doctype> ( -- ) s" <!DOCTYPE html>" rawln ;
-: <html> s" html" <tag>nl ;
-: </html> s" html" </tag>nl ;
-: <head> s" head" <tag>nl ;
-: </head> s" head" </tag>nl ;
-: <body> s" body" <tag>nl ;
-: </body> s" body" </tag>nl ;
-: <title> s" title" <tag> ;
-: </title> s" title" </tag>nl ;
+: <!doctype> ( -- ) s\" <!DOCTYPE html>\n" h>> ;
+: <html> s\" <html>\n" h>> ;
+: </html> s\" </html>\n" h>> ;
+: <head> s\" <head>\n" h>> ;
+: </head> s\" </head>\n" h>> ;
+: <body> s\" <body>\n" h>> ;
+: </body> s\" </body>\n" h>> ;
+: <title> s" <title>" h>> ;
+: </title> s\" </title>\n" h>> ;
 : <meta ( -- ) s" <meta " h>> ;
 : meta> ( -- ) s" >" h>> ;
 : <link ( -- ) s" <link " h>> ;
 
 \ Headings
-: <h1> s" h1" <tag> ;
-: </h1> s" h1" </tag>nl ;
-: <h2> s" h2" <tag> ;
-: </h2> s" h2" </tag>nl ;
-: <h3> s" h3" <tag> ;
-: </h3> s" h3" </tag>nl ;
-: <h4> s" h4" <tag> ;
-: </h4> s" h4" </tag>nl ;
+: <h1> s" <h1>" h>> ;
+: </h1> s\" </h1>\n" h>> ;
+: <h2> s" <h2>" h>> ;
+: </h2> s\" </h2>\n" h>> ;
+: <h3> s" <h3>" h>> ;
+: </h3> s\" </h3>\n" h>> ;
+: <h4> s" <h4>" h>> ;
+: </h4> s\" </h4>\n" h>> ;
 
 \ Containers
-: <div> s" div" <tag> ;
+: <div> s" <div>" h>> ;
 : <div.> ( class$ -- ) s" div" <tag.> ;
 : <div.>nl ( class$ -- ) s" div" <tag.>nl ;
 : <div#> ( id$ -- ) s" div" <tag#> ;
 : <div#.> ( id$ class$ -- ) s" div" <tag#.> ;
-: </div> s" div" </tag> ;
-: </div>nl s" div" </tag>nl ;
+: </div> s" </div>" h>> ;
+: </div>nl s\" </div>\n" h>> ;
 
-: <span> s" span" <tag> ;
+: <span> s" <span>" h>> ;
 : <span.> ( class$ -- ) s" span" <tag.> ;
-: </span> s" span" </tag> ;
+: </span> s" </span>" h>> ;
 
-: <section> s" section" <tag>nl ;
+: <section> s\" <section>\n" h>> ;
 : <section.> ( class$ -- ) s" section" <tag.>nl ;
-: </section> s" section" </tag>nl ;
+: </section> s\" </section>\n" h>> ;
 
-: <article> s" article" <tag>nl ;
-: </article> s" article" </tag>nl ;
+: <article> s\" <article>\n" h>> ;
+: </article> s\" </article>\n" h>> ;
 
-: <header> s" header" <tag>nl ;
+: <header> s\" <header>\n" h>> ;
 : <header.> ( class$ -- ) s" header" <tag.>nl ;
-: </header> s" header" </tag>nl ;
+: </header> s\" </header>\n" h>> ;
 
-: <footer> s" footer" <tag>nl ;
-: </footer> s" footer" </tag>nl ;
+: <footer> s\" <footer>\n" h>> ;
+: </footer> s\" </footer>\n" h>> ;
 
-: <nav> s" nav" <tag>nl ;
-: </nav> s" nav" </tag>nl ;
+: <nav> s\" <nav>\n" h>> ;
+: </nav> s\" </nav>\n" h>> ;
 
-: <main> s" main" <tag>nl ;
+: <main> s\" <main>\n" h>> ;
 : <main.> ( class$ -- ) s" main" <tag.>nl ;
-: </main> s" main" </tag>nl ;
+: </main> s\" </main>\n" h>> ;
 
-: <aside> s" aside" <tag>nl ;
+: <aside> s\" <aside>\n" h>> ;
 : <aside.> ( class$ -- ) s" aside" <tag.>nl ;
-: </aside> s" aside" </tag>nl ;
+: </aside> s\" </aside>\n" h>> ;
 
 \ Text elements
-: <p> s" p" <tag> ;
+: <p> s" <p>" h>> ;
 : <p.> ( class$ -- ) s" p" <tag.> ;
-: </p> s" p" </tag> ;
-: </p>nl s" p" </tag>nl ;
+: </p> s" </p>" h>> ;
+: </p>nl s\" </p>\n" h>> ;
 
-: <strong> s" strong" <tag> ;
-: </strong> s" strong" </tag> ;
+: <strong> s" <strong>" h>> ;
+: </strong> s" </strong>" h>> ;
 
-: <em> s" em" <tag> ;
-: </em> s" em" </tag> ;
+: <em> s" <em>" h>> ;
+: </em> s" </em>" h>> ;
 
-: <code> s" code" <tag> ;
-: </code> s" code" </tag> ;
+: <code> s" <code>" h>> ;
+: </code> s" </code>" h>> ;
 
-: <pre> s" pre" <tag> ;
-: </pre> s" pre" </tag> ;
+: <pre> s" <pre>" h>> ;
+: </pre> s" </pre>" h>> ;
 
-: <blockquote> s" blockquote" <tag>nl ;
-: </blockquote> s" blockquote" </tag>nl ;
+: <blockquote> s\" <blockquote>\n" h>> ;
+: </blockquote> s\" </blockquote>\n" h>> ;
 
 : <br/> s" br" tag/ ;
 
 \ Lists
-: <ul> s" ul" <tag>nl ;
+: <ul> s\" <ul>\n" h>> ;
 : <ul.> ( class$ -- ) s" ul" <tag.>nl ;
-: </ul> s" ul" </tag>nl ;
+: </ul> s\" </ul>\n" h>> ;
 
-: <ol> s" ol" <tag>nl ;
-: </ol> s" ol" </tag>nl ;
+: <ol> s\" <ol>\n" h>> ;
+: </ol> s\" </ol>\n" h>> ;
 
-: <li> s" li" <tag> ;
+: <li> s" <li>" h>> ;
 : <li.> ( class$ -- ) s" li" <tag.> ;
-: </li> s" li" </tag> ;
-: </li>nl s" li" </tag>nl ;
+: </li> s" </li>" h>> ;
+: </li>nl s\" </li>\n" h>> ;
 
 \ Tables
-: <table> s" table" <tag>nl ;
+: <table> s\" <table>\n" h>> ;
 : <table.> ( class$ -- ) s" table" <tag.>nl ;
-: </table> s" table" </tag>nl ;
+: </table> s\" </table>\n" h>> ;
 
-: <thead> s" thead" <tag>nl ;
-: </thead> s" thead" </tag>nl ;
+: <thead> s\" <thead>\n" h>> ;
+: </thead> s\" </thead>\n" h>> ;
 
-: <tbody> s" tbody" <tag>nl ;
-: </tbody> s" tbody" </tag>nl ;
+: <tbody> s\" <tbody>\n" h>> ;
+: </tbody> s\" </tbody>\n" h>> ;
 
-: <tr> s" tr" <tag> ;
+: <tr> s" <tr>" h>> ;
 : <tr.> ( class$ -- ) s" tr" <tag.> ;
-: </tr> s" tr" </tag>nl ;
+: </tr> s\" </tr>\n" h>> ;
 
-: <th> s" th" <tag> ;
-: </th> s" th" </tag> ;
+: <th> s" <th>" h>> ;
+: </th> s" </th>" h>> ;
 
-: <td> s" td" <tag> ;
+: <td> s" <td>" h>> ;
 : <td.> ( class$ -- ) s" td" <tag.> ;
-: </td> s" td" </tag> ;
+: </td> s" </td>" h>> ;
 
 \ Forms
-: <form> s" form" <tag>nl ;
-: </form> s" form" </tag>nl ;
+: <form> s\" <form>\n" h>> ;
+: </form> s\" </form>\n" h>> ;
 
 : <input ( -- ) s" <input " h>> ;
 : input> ( -- ) s" >" h>> ;
 
 : <button ( -- ) s" <button" h>> ;  \ Open for attributes
-: <button> s" button" <tag> ;
+: <button> s" <button>" h>> ;
 : <button.> ( class$ -- ) s" button" <tag.> ;
-: </button> s" button" </tag> ;
+: </button> s" </button>" h>> ;
 
-: <label> s" label" <tag> ;
-: </label> s" label" </tag> ;
+: <label> s" <label>" h>> ;
+: </label> s" </label>" h>> ;
 
-: <textarea> s" textarea" <tag> ;
-: </textarea> s" textarea" </tag> ;
+: <textarea> s" <textarea>" h>> ;
+: </textarea> s" </textarea>" h>> ;
 
-: <select> s" select" <tag>nl ;
-: </select> s" select" </tag>nl ;
+: <select> s\" <select>\n" h>> ;
+: </select> s\" </select>\n" h>> ;
 
-: <option> s" option" <tag> ;
-: </option> s" option" </tag>nl ;
+: <option> s" <option>" h>> ;
+: </option> s\" </option>\n" h>> ;
 
 \ Links and media
 : <a ( -- ) s" <a " h>> ;
 : a> ( -- ) s" >" h>> ;
-: </a> s" a" </tag> ;
+: </a> s" </a>" h>> ;
 
 : <img ( -- ) s" <img " h>> ;
 : img> ( -- ) s" >" h>> ;
 
 \ Style and script
-: <style> s" style" <tag>nl ;
-: </style> s" style" </tag>nl ;
+: <style> s\" <style>\n" h>> ;
+: </style> s\" </style>\n" h>> ;
 
-: <script> s" script" <tag> ;
-: </script> s" script" </tag>nl ;
+: <script> s" <script>" h>> ;
+: </script> s\" </script>\n" h>> ;
 
 \ ============================================================
 \ Attribute Helpers
@@ -261,7 +258,7 @@ variable html-fid  \ File descriptor for HTML output
 
 : attr-text= ( name$ value$ -- )
   \ Output: name='escaped-value'
-  2swap h>> s" ='" h>> html-escape h>> s" '" h>> ;
+  2swap h>> s" ='" h>> h>>esc s" '" h>> ;
 
 : href= ( url$ -- ) s" href" 2swap attr= ;
 : src= ( url$ -- ) s" src" 2swap attr= ;
@@ -294,7 +291,7 @@ variable html-fid  \ File descriptor for HTML output
 
 \ Image
 : img. ( alt$ src$ -- )
-  <img src= s"  alt='" h>> html-escape h>> s" '" h>> img> ;
+  <img src= s"  alt='" h>> h>>esc s" '" h>> img> ;
 
 \ ============================================================
 \ Common Patterns
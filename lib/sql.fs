@@ -1,5 +1,7 @@
-\ fifth/lib/sql.fs - SQLite Shell Interface
-\ Execute queries via sqlite3 CLI, parse results
+\ fifth/lib/sql.fs - SQLite Interface
+\ Queries run in-process when the engine has SQLite linked in
+\ (sql-native?), otherwise via the sqlite3 CLI. Rows look the same
+\ either way: fields joined with |.
 
 require ~/fifth/lib/str.fs
 
@@ -8,10 +10,9 @@ require ~/fifth/lib/str.fs
 \ ============================================================
 
 s" /tmp/fifth-query.txt" 2constant sql-output
-s" /tmp/fifth-count.txt" 2constant sql-count-output
 
 variable sql-fid      \ File descriptor for query results
-variable sql-count-fid
+variable sql-stmt     \ Native statement behind sql-exec / sql-row?
 
 \ ============================================================
 \ Command Building
@@ -27,31 +28,34 @@ variable sql-count-fid
   s" ' > " str+
   sql-output str+ ;
 
-: sql-cmd-count ( db$ sql$ -- )
-  \ Build: sqlite3 db 'sql' > count-output
-  str-reset
-  s" sqlite3 " str+
-  2swap str+
-  s"  '" str+
-  str+
-  s" ' > " str+
-  sql-count-output str+ ;
-
 \ ============================================================
 \ Query Execution
 \ ============================================================
 
+: sql-query ( db$ sql$ -- stmt | -1 )
+  \ Open (cached) and prepare (cached) natively
+  2swap sql-open-db if drop 2drop -1 exit then
+  sql-prepare if drop -1 then ;
+
 : sql-exec ( db$ sql$ -- )
-  \ Execute query, results go to sql-output file
+  \ Execute query, results go to sql-output file (or stay in SQLite)
+  sql-native? if sql-query sql-stmt ! exit then
   sql-cmd-query str$ system ;
 
 : sql-count ( db$ sql$ -- n )
   \ Execute COUNT query, return number
-  sql-cmd-count str$ system
-  sql-count-output r/o open-file throw sql-count-fid !
-  line-buf line-max sql-count-fid @ read-line throw drop
-  sql-count-fid @ close-file drop
-  line-buf swap s>number? if drop else 0 then ;
+  sql-native? if
+    sql-query dup 0< if drop 0 exit then
+    dup sql-step if
+      dup 0 swap sql-column s>number? if drop else 2drop 0 then
+      swap begin dup sql-step 0= until drop
+    else drop 0 then exit
+  then
+  \ sqlite3 db sql, no shell: quotes in sql need no escaping
+  2>r 2>r s" sqlite3" 2r> 2r> 3 run-argv
+  if 2drop 0 exit then
+  dup if 1- then                     \ The newline
+  s>number? if drop else 0 then ;
 
 \ ============================================================
 \ Result Processing
@@ -59,14 +63,20 @@ variable sql-count-fid
 
 : sql-open ( -- )
   \ Open query results for reading
+  sql-native? if exit then
   sql-output r/o open-file throw sql-fid ! ;
 
 : sql-close ( -- )
   \ Close query results
+  sql-native? if -1 sql-stmt ! exit then
   sql-fid @ close-file throw ;
 
 : sql-row? ( -- addr u flag )
   \ Read next row, return string and flag (true if data)
+  sql-native? if
+    sql-stmt @ dup 0< if drop 0 0 false exit then
+    dup sql-step if sql-row true else drop -1 sql-stmt ! 0 0 false then exit
+  then
   line-buf line-max sql-fid @ read-line throw
   line-buf -rot ;
 
@@ -118,6 +128,12 @@ variable sql-count-fid
 \ Execute xt for each row
 \ xt signature: ( addr u -- ) where addr u is the row string
 : sql-each ( db$ sql$ xt -- )
+  sql-native? if
+    >r sql-query dup 0< if drop r> drop exit then
+    begin dup sql-step while
+      dup sql-row dup 0> if r@ execute else 2drop then
+    repeat drop r> drop exit
+  then
   >r sql-exec sql-open
   begin sql-row? while
     dup 0> if
@@ -134,6 +150,12 @@ variable sql-count-fid
 
 : sql-dump ( db$ sql$ -- )
   \ Execute and print results to stdout
+  sql-native? if
+    sql-query dup 0< if drop exit then
+    begin dup sql-step while
+      dup sql-row dup 0> if type cr else 2drop then
+    repeat drop exit
+  then
   sql-exec sql-open
   begin sql-row? while
     dup 0> if type cr else 2drop then
@@ -146,10 +168,10 @@ variable sql-count-fid
 
 : .sql-fields ( addr u n -- )
   \ Print first n fields, tab separated
-  0 ?do
+  >r s" |" split-row r> 0 ?do
     i 0> if 9 emit then
-    2dup i sql-field type
-  loop 2drop ;
+    i over < if i field@ type then
+  loop drop ;
 
 \ ============================================================
 \ Dynamic SQL (str2-buf safe)
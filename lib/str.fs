@@ -77,6 +77,15 @@ variable str2-overflow
   \ Query overflow state
   str2-overflow @ ;
 
+\ ============================================================
+\ Keeping Strings
+\ ============================================================
+
+: >scratch ( addr u -- addr' u' )
+  \ Copy into the engine's scratch arena, safe from the next str-reset
+  \ until scratch-reset
+  dup scratch arena-alloc swap 2dup 2>r move 2r> ;
+
 \ ============================================================
 \ Line Buffer (for file I/O)
 \ ============================================================
@@ -97,14 +106,8 @@ create line-buf line-max allot
 \ ============================================================
 
 : str= ( addr1 u1 addr2 u2 -- flag )
-  \ Compare two strings for equality
-  rot over <> if 2drop drop false exit then
-  0 ?do
-    over i + c@ over i + c@ <> if
-      2drop false unloop exit
-    then
-  loop
-  2drop true ;
+  \ Compare two strings for equality (COMPARE runs in C)
+  compare 0= ;
 
 \ ============================================================
 \ String Search
@@ -112,45 +115,25 @@ create line-buf line-max allot
 
 : str-find-char ( addr u c -- addr' u' | 0 0 )
   \ Find character in string, return position or 0 0 if not found
-  >r
-  begin
-    dup 0> while
-    over c@ r@ = if r> drop exit then
-    1 /string
-  repeat
-  r> drop ;
+  scan-char dup 0= if 2drop 0 0 then ;
 
 \ ============================================================
 \ Field Parsing (for delimited data)
 \ ============================================================
 
 : skip-to-delim ( addr u delim -- addr' u' )
-  \ Skip to nth occurrence of delimiter
-  >r
-  begin
-    dup 0> while
-    over c@ r@ = if 1 /string r> drop exit then
-    1 /string
-  repeat
-  r> drop ;
+  \ Skip past the next delimiter
+  scan-char 1 /string ;
 
 : field-length ( addr u delim -- len )
   \ Length until delimiter or end
-  >r 0 -rot
-  0 ?do
-    dup i + c@ r@ = if drop r> drop unloop exit then
-    swap 1+ swap
-  loop
-  drop r> drop ;
+  >r over swap r> scan-char drop swap - ;
 
 : parse-delim ( addr u n delim -- addr u field-addr field-u )
   \ Parse nth field (0-based) with given delimiter
-  >r >r 2dup r>
-  0 ?do
-    r@ skip-to-delim
-    dup 0> if 1 /string then
-  loop
-  2dup r> field-length >r drop r> ;
+  >r >r 2dup r> r> swap
+  0 ?do dup >r skip-to-delim r> loop
+  >r over swap r> field-length ;
 
 : parse-pipe ( addr u n -- addr u field-addr field-u )
   \ Parse pipe-delimited field
@@ -163,3 +146,15 @@ create line-buf line-max allot
 : parse-comma ( addr u n -- addr u field-addr field-u )
   \ Parse comma-delimited field
   [char] , parse-delim ;
+
+\ Whole-row split: one pass, then fields by index
+32 constant max-fields
+create field-buf max-fields 2 * cells allot
+
+: split-row ( addr u delims$ -- n )
+  \ Split at any delimiter byte, remember up to max-fields fields
+  field-buf max-fields split-fields ;
+
+: field@ ( i -- addr u )
+  \ Field i from the last split-row
+  2 * cells field-buf + dup @ swap cell+ @ ;
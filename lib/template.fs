@@ -20,22 +20,25 @@ require ~/fifth/lib/html.fs
 \ Content Blocks (capture HTML to string)
 \ ============================================================
 
-\ For capturing output to a variable instead of file
+\ For capturing output to a string instead of a file
 \ (Useful for reordering content or conditional output)
+\ HTML goes to stdout while capturing, which the engine's
+\ capture-begin / capture-end collect in memory. Captures nest.
+\ Everything else written to stdout in between (type, ., cr)
+\ lands in the capture too; stderr does not.
 
-variable capture-mode
-variable capture-fid
-s" /tmp/fifth-capture.html" 2constant capture-file
+variable capture-mode   \ html-fid outside the outermost capture
+variable capture-depth
 
 : begin-capture ( -- )
-  capture-file w/o create-file throw capture-fid !
-  html-fid @ >r capture-fid @ html>file
-  r> capture-mode ! ;
+  capture-depth @ 0= if html-fid @ capture-mode ! then
+  1 capture-depth +!
+  html>stdout capture-begin ;
 
 : end-capture ( -- addr u )
-  capture-fid @ close-file throw
-  capture-mode @ html>file
-  capture-file slurp-file ;
+  capture-end
+  -1 capture-depth +!
+  capture-depth @ 0= if capture-mode @ html>file then ;
 
 \ ============================================================
 \ Conditional Rendering